@@ -2,6 +2,69 @@
 #include "SDL3/SDL.h"
 #include "ui.h"
 
+typedef enum UISDL3DrawMode {
+    UISDL3DrawMode_geometry,  // The whole list in a single SDL_RenderGeometry call with the glyph atlas
+    UISDL3DrawMode_fillRects, // One SDL_RenderFillRects call for each run of the same color
+    UISDL3DrawMode_rects      // One SDL_RenderFillRect call for each command
+} UISDL3DrawMode;
+
+// The fonts of the backend are the 8 by 8 pixel font of SDL_RenderDebugText
+// scaled by the font number, 0 is the same as 1
+#define UISDL3_DEBUG_FONT_FIRST ' '
+#define UISDL3_DEBUG_FONT_COUNT 95
+
+#ifdef UI_THREADS
+
+typedef struct UISDL3Backend UISDL3Backend;
+
+typedef struct UISDL3Worker {
+    SDL_AtomicU32 range; // Tasks left to the worker, the first in the low 16 bits and the end in the high ones
+    SDL_Thread *thread; // NULL for the thread that calls UI_RunTasks
+    UISDL3Backend *backend;
+    uint32_t index;
+} UISDL3Worker;
+
+#endif // !UI_THREADS
+
+// The `userData` of a context using the SDL3 backend
+typedef struct UISDL3Backend {
+    SDL_Renderer *renderer;
+    UISDL3DrawMode drawMode;
+    uint32_t drawCalls; // Render calls issued by the last UI_DrawList
+    SDL_Vertex *vertices;
+    int *indices;
+    SDL_FRect *rects;
+    uint32_t cap; // Number of commands the buffers above can hold
+    SDL_Texture *atlas; // Copy of the glyph atlas of the context, white with the coverage as alpha
+    uint8_t *atlasUpload; // Pixels of the atlas converted for the texture
+    uint8_t *debugFont; // Coverage of the glyphs of the debug font side by side, read on first use
+    SDL_Texture *target; // Backbuffer of partial draw lists as large as the window, copied to it after each list
+    SDL_FRect damageRects[UI_DAMAGE_RECTS];
+#ifdef UI_THREADS
+    UISDL3Worker *workers;
+    uint32_t workerCount; // Including the thread that calls UI_RunTasks
+    SDL_Semaphore *wake;
+    SDL_AtomicInt busyWorkers;
+    bool quit;
+    void (*task)(void *data, uint32_t index);
+    void *taskData;
+    uint32_t taskBase;
+#endif
+} UISDL3Backend;
+
+void UISDL3Backend_Init(UISDL3Backend *backend, SDL_Renderer *renderer);
+void UISDL3Backend_Destroy(UISDL3Backend *backend);
+bool UISDL3Backend_LoadDebugFont(UISDL3Backend *backend);
+bool UISDL3Backend_BeginPartial(UISDL3Backend *backend, UIContext *ctx, const UIDrawList *list);
+bool UISDL3Backend_EndPartial(UISDL3Backend *backend);
+bool UISDL3Backend_DrawCommands(UISDL3Backend *backend, UIContext *ctx, const UIDrawList *list);
+#ifdef UI_THREADS
+// Start the threads that run the layout tasks, `threadCount` does not include
+// the thread that draws the context
+bool UISDL3Backend_StartWorkers(UISDL3Backend *backend, uint32_t threadCount);
+void UISDL3Backend_StopWorkers(UISDL3Backend *backend);
+#endif
+
 void *UI_MemAlloc(uint32_t size) {
     return malloc(size);
 }
@@ -19,17 +82,586 @@ void UI_MemFree(void *block) {
     free(block);
 }
 
-bool UI_DrawRect(UIContext *ctx, UIRect rect, UIColor color) {
-    SDL_Renderer *renderer = (SDL_Renderer *)ctx->userData;
-    if (!SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a))
+void UISDL3Backend_Init(UISDL3Backend *backend, SDL_Renderer *renderer) {
+    backend->renderer = renderer;
+    backend->drawMode = UISDL3DrawMode_geometry;
+    backend->drawCalls = 0;
+    backend->vertices = NULL;
+    backend->indices = NULL;
+    backend->rects = NULL;
+    backend->cap = 0;
+    backend->atlas = NULL;
+    backend->atlasUpload = NULL;
+    backend->debugFont = NULL;
+    backend->target = NULL;
+#ifdef UI_THREADS
+    backend->workers = NULL;
+    backend->workerCount = 0;
+    backend->wake = NULL;
+#endif
+}
+
+void UISDL3Backend_Destroy(UISDL3Backend *backend) {
+#ifdef UI_THREADS
+    UISDL3Backend_StopWorkers(backend);
+#endif
+    free(backend->vertices);
+    free(backend->indices);
+    free(backend->rects);
+    backend->vertices = NULL;
+    backend->indices = NULL;
+    backend->rects = NULL;
+    backend->cap = 0;
+    if (backend->atlas != NULL)
+        SDL_DestroyTexture(backend->atlas);
+    free(backend->atlasUpload);
+    free(backend->debugFont);
+    backend->atlas = NULL;
+    backend->atlasUpload = NULL;
+    backend->debugFont = NULL;
+    if (backend->target != NULL)
+        SDL_DestroyTexture(backend->target);
+    backend->target = NULL;
+}
+
+bool UISDL3Backend_Reserve(UISDL3Backend *backend, uint32_t count) {
+    if (count <= backend->cap)
+        return true;
+    uint32_t newCap = backend->cap == 0 ? 64 : backend->cap;
+    while (newCap < count)
+        newCap *= 2;
+
+    SDL_Vertex *vertices = realloc(backend->vertices, sizeof(SDL_Vertex) * 4 * newCap);
+    if (vertices == NULL)
+        return false;
+    backend->vertices = vertices;
+    int *indices = realloc(backend->indices, sizeof(int) * 6 * newCap);
+    if (indices == NULL)
+        return false;
+    backend->indices = indices;
+    SDL_FRect *rects = realloc(backend->rects, sizeof(SDL_FRect) * newCap);
+    if (rects == NULL)
         return false;
-    SDL_FRect sdlRect = {
-        .x = rect.x,
-        .y = rect.y,
-        .w = rect.w,
-        .h = rect.h,
+    backend->rects = rects;
+
+    // The indices only depend on the position of the rectangle in the list
+    for (uint32_t i = backend->cap; i < newCap; i++) {
+        int v = (int)i * 4;
+        int *idx = indices + i * 6;
+        idx[0] = v;
+        idx[1] = v + 1;
+        idx[2] = v + 2;
+        idx[3] = v;
+        idx[4] = v + 2;
+        idx[5] = v + 3;
+    }
+    backend->cap = newCap;
+    return true;
+}
+
+// The visible part of the rectangle of `command`, the batched modes clip on the CPU
+UIRect UISDL3_ClipRect(const UIDrawCommand *command) {
+    UIRect rect = command->rect;
+    UIRect clip = command->clip;
+    float x0 = rect.x > clip.x ? rect.x : clip.x;
+    float y0 = rect.y > clip.y ? rect.y : clip.y;
+    float x1 = rect.x + rect.w < clip.x + clip.w ? rect.x + rect.w : clip.x + clip.w;
+    float y1 = rect.y + rect.h < clip.y + clip.h ? rect.y + rect.h : clip.y + clip.h;
+    return (UIRect) { x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0 };
+}
+
+// The part of the `src` of `command` drawn to `clipped`, the result of UISDL3_ClipRect
+UIRect UISDL3_ClipSrc(const UIDrawCommand *command, UIRect clipped) {
+    UIRect rect = command->rect;
+    UIRect src = command->src;
+    float scaleX = src.w / rect.w;
+    float scaleY = src.h / rect.h;
+    return (UIRect) {
+        src.x + (clipped.x - rect.x) * scaleX,
+        src.y + (clipped.y - rect.y) * scaleY,
+        clipped.w * scaleX,
+        clipped.h * scaleY
     };
-    if (!SDL_RenderFillRect(renderer, &sdlRect))
+}
+
+// Copy the pixels of the atlas changed since the last draw list to the texture
+bool UISDL3Backend_UploadAtlas(UISDL3Backend *backend, UIGlyphAtlas *atlas) {
+    if (atlas->pixels == NULL || atlas->dirty.w == 0)
+        return true;
+    if (backend->atlas == NULL) {
+        backend->atlas = SDL_CreateTexture(
+            backend->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, UI_ATLAS_SIZE, UI_ATLAS_SIZE);
+        if (backend->atlas == NULL)
+            return false;
+        if (!SDL_SetTextureBlendMode(backend->atlas, SDL_BLENDMODE_BLEND))
+            return false;
+        if (!SDL_SetTextureScaleMode(backend->atlas, SDL_SCALEMODE_NEAREST))
+            return false;
+        backend->atlasUpload = malloc(UI_ATLAS_SIZE * UI_ATLAS_SIZE * 4);
+        if (backend->atlasUpload == NULL)
+            return false;
+    }
+
+    SDL_Rect rect = {
+        .x = (int)atlas->dirty.x,
+        .y = (int)atlas->dirty.y,
+        .w = (int)atlas->dirty.w,
+        .h = (int)atlas->dirty.h
+    };
+    for (int y = 0; y < rect.h; y++) {
+        const uint8_t *coverage = atlas->pixels + (rect.y + y) * UI_ATLAS_SIZE + rect.x;
+        uint8_t *pixel = backend->atlasUpload + y * rect.w * 4;
+        for (int x = 0; x < rect.w; x++, pixel += 4) {
+            pixel[0] = 255;
+            pixel[1] = 255;
+            pixel[2] = 255;
+            pixel[3] = coverage[x];
+        }
+    }
+    backend->drawCalls++;
+    if (!SDL_UpdateTexture(backend->atlas, &rect, backend->atlasUpload, rect.w * 4))
         return false;
+    atlas->dirty = (UIRect) { 0, 0, 0, 0 };
     return true;
 }
+
+// Draw a glyph with its own call, for the modes that do not batch
+bool UISDL3Backend_DrawGlyph(UISDL3Backend *backend, const UIDrawCommand *command) {
+    UIRect rect = UISDL3_ClipRect(command);
+    if (rect.w == 0 || rect.h == 0)
+        return true;
+    UIRect src = UISDL3_ClipSrc(command, rect);
+    UIColor color = command->color;
+    SDL_FRect sdlSrc = { .x = src.x, .y = src.y, .w = src.w, .h = src.h };
+    SDL_FRect sdlRect = { .x = rect.x, .y = rect.y, .w = rect.w, .h = rect.h };
+    backend->drawCalls += 3;
+    return SDL_SetTextureColorMod(backend->atlas, color.r, color.g, color.b)
+        && SDL_SetTextureAlphaMod(backend->atlas, color.a)
+        && SDL_RenderTexture(backend->renderer, backend->atlas, &sdlSrc, &sdlRect);
+}
+
+bool UISDL3Backend_DrawGeometry(UISDL3Backend *backend, const UIDrawList *list, const UIGlyphAtlas *atlas) {
+    // Solid rectangles use the covered pixels of the atlas, its texture is
+    // missing until a glyph is drawn
+    float white[2] = {
+        (atlas->white.x + atlas->white.w / 2) / UI_ATLAS_SIZE,
+        (atlas->white.y + atlas->white.h / 2) / UI_ATLAS_SIZE
+    };
+    SDL_Vertex *v = backend->vertices;
+    for (uint32_t i = 0; i < list->len; i++, v += 4) {
+        const UIDrawCommand *command = &list->data[i];
+        UIRect rect = UISDL3_ClipRect(command);
+        UIColor color = command->color;
+        SDL_FColor fColor = {
+            .r = color.r / 255.0f,
+            .g = color.g / 255.0f,
+            .b = color.b / 255.0f,
+            .a = color.a / 255.0f
+        };
+        float u0 = white[0], v0 = white[1], u1 = white[0], v1 = white[1];
+        if (command->src.w != 0) {
+            UIRect src = UISDL3_ClipSrc(command, rect);
+            u0 = src.x / UI_ATLAS_SIZE;
+            v0 = src.y / UI_ATLAS_SIZE;
+            u1 = (src.x + src.w) / UI_ATLAS_SIZE;
+            v1 = (src.y + src.h) / UI_ATLAS_SIZE;
+        }
+        v[0] = (SDL_Vertex) { { rect.x, rect.y }, fColor, { u0, v0 } };
+        v[1] = (SDL_Vertex) { { rect.x + rect.w, rect.y }, fColor, { u1, v0 } };
+        v[2] = (SDL_Vertex) { { rect.x + rect.w, rect.y + rect.h }, fColor, { u1, v1 } };
+        v[3] = (SDL_Vertex) { { rect.x, rect.y + rect.h }, fColor, { u0, v1 } };
+    }
+    backend->drawCalls++;
+    return SDL_RenderGeometry(
+        backend->renderer, backend->atlas,
+        backend->vertices, (int)list->len * 4,
+        backend->indices, (int)list->len * 6);
+}
+
+bool UISDL3Backend_DrawFillRects(UISDL3Backend *backend, const UIDrawList *list) {
+    SDL_Renderer *renderer = backend->renderer;
+    uint32_t runStart = 0;
+    // Rectangles cannot be reordered, only consecutive ones of the same color
+    // are grouped. Glyphs end a run.
+    for (uint32_t i = 0; i <= list->len; i++) {
+        UIColor color = list->data[runStart < list->len ? runStart : 0].color;
+        bool glyph = i < list->len && list->data[i].src.w != 0;
+        bool flush = i == list->len || glyph;
+        if (!flush && i != runStart) {
+            UIColor next = list->data[i].color;
+            flush = color.r != next.r || color.g != next.g || color.b != next.b || color.a != next.a;
+        }
+        if (flush && i != runStart) {
+            if (!SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a))
+                return false;
+            if (!SDL_RenderFillRects(renderer, backend->rects + runStart, (int)(i - runStart)))
+                return false;
+            backend->drawCalls += 2;
+        }
+        if (flush)
+            runStart = glyph ? i + 1 : i;
+        if (i == list->len)
+            break;
+        if (glyph) {
+            if (!UISDL3Backend_DrawGlyph(backend, &list->data[i]))
+                return false;
+            continue;
+        }
+        UIRect rect = UISDL3_ClipRect(&list->data[i]);
+        backend->rects[i] = (SDL_FRect) { .x = rect.x, .y = rect.y, .w = rect.w, .h = rect.h };
+    }
+    return true;
+}
+
+bool UISDL3Backend_DrawRects(UISDL3Backend *backend, const UIDrawList *list) {
+    SDL_Renderer *renderer = backend->renderer;
+    UIRect lastClip = { 0, 0, -1, -1 };
+    for (uint32_t i = 0; i < list->len; i++) {
+        UIRect rect = list->data[i].rect;
+        UIRect clip = list->data[i].clip;
+        UIColor color = list->data[i].color;
+        // The renderer clips to whole pixels, covering every pixel the clip touches
+        if (clip.x != lastClip.x || clip.y != lastClip.y || clip.w != lastClip.w || clip.h != lastClip.h) {
+            int x = (int)SDL_floorf(clip.x);
+            int y = (int)SDL_floorf(clip.y);
+            SDL_Rect sdlClip = {
+                .x = x,
+                .y = y,
+                .w = (int)SDL_ceilf(clip.x + clip.w) - x,
+                .h = (int)SDL_ceilf(clip.y + clip.h) - y
+            };
+            if (!SDL_SetRenderClipRect(renderer, &sdlClip))
+                return false;
+            backend->drawCalls++;
+            lastClip = clip;
+        }
+        if (list->data[i].src.w != 0) {
+            if (!UISDL3Backend_DrawGlyph(backend, &list->data[i]))
+                return false;
+            continue;
+        }
+        if (!SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a))
+            return false;
+        SDL_FRect sdlRect = {
+            .x = rect.x,
+            .y = rect.y,
+            .w = rect.w,
+            .h = rect.h,
+        };
+        if (!SDL_RenderFillRect(renderer, &sdlRect))
+            return false;
+        backend->drawCalls += 2;
+    }
+    backend->drawCalls++;
+    return SDL_SetRenderClipRect(renderer, NULL);
+}
+
+// Draw to the backbuffer and clear the damage of `list`
+bool UISDL3Backend_BeginPartial(UISDL3Backend *backend, UIContext *ctx, const UIDrawList *list) {
+    SDL_Renderer *renderer = backend->renderer;
+    int w = (int)ctx->window.w;
+    int h = (int)ctx->window.h;
+    float targetW, targetH;
+    // The whole window is damaged when its size changes, the new texture is
+    // drawn entirely
+    if (backend->target != NULL && SDL_GetTextureSize(backend->target, &targetW, &targetH)
+        && ((int)targetW != w || (int)targetH != h))
+    {
+        SDL_DestroyTexture(backend->target);
+        backend->target = NULL;
+    }
+    if (backend->target == NULL) {
+        backend->target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, w, h);
+        if (backend->target == NULL)
+            return false;
+        if (!SDL_SetTextureBlendMode(backend->target, SDL_BLENDMODE_NONE))
+            return false;
+        if (!SDL_SetTextureScaleMode(backend->target, SDL_SCALEMODE_NEAREST))
+            return false;
+    }
+
+    if (!SDL_SetRenderTarget(renderer, backend->target))
+        return false;
+    backend->drawCalls++;
+    if (list->damageCount == 0)
+        return true;
+    for (uint32_t k = 0; k < list->damageCount; k++) {
+        UIRect damage = list->damage[k];
+        backend->damageRects[k] = (SDL_FRect) { .x = damage.x, .y = damage.y, .w = damage.w, .h = damage.h };
+    }
+    backend->drawCalls += 2;
+    return SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_TRANSPARENT)
+        && SDL_RenderFillRects(renderer, backend->damageRects, (int)list->damageCount);
+}
+
+// Copy the backbuffer to the window
+bool UISDL3Backend_EndPartial(UISDL3Backend *backend) {
+    backend->drawCalls += 2;
+    return SDL_SetRenderTarget(backend->renderer, NULL)
+        && SDL_RenderTexture(backend->renderer, backend->target, NULL, NULL);
+}
+
+bool UI_DrawList(UIContext *ctx, const UIDrawList *list) {
+    UISDL3Backend *backend = (UISDL3Backend *)ctx->userData;
+    backend->drawCalls = 0;
+    if (list->partial && (ctx->window.w == 0 || ctx->window.h == 0))
+        return true;
+    if (list->partial && !UISDL3Backend_BeginPartial(backend, ctx, list)) {
+        SDL_SetRenderTarget(backend->renderer, NULL);
+        return false;
+    }
+    bool drawn = UISDL3Backend_DrawCommands(backend, ctx, list);
+    if (list->partial && !UISDL3Backend_EndPartial(backend))
+        drawn = false;
+#ifdef UI_STATS
+    UIContext_StatsAddDrawCalls(ctx, backend->drawCalls);
+#endif
+    return drawn;
+}
+
+bool UISDL3Backend_DrawCommands(UISDL3Backend *backend, UIContext *ctx, const UIDrawList *list) {
+    if (list->len == 0)
+        return true;
+    if (!UISDL3Backend_UploadAtlas(backend, &ctx->atlas))
+        return false;
+
+    bool drawn = false;
+    switch (backend->drawMode) {
+    case UISDL3DrawMode_geometry:
+        if (!UISDL3Backend_Reserve(backend, list->len))
+            return false;
+        drawn = UISDL3Backend_DrawGeometry(backend, list, &ctx->atlas);
+        break;
+    case UISDL3DrawMode_fillRects:
+        if (!UISDL3Backend_Reserve(backend, list->len))
+            return false;
+        drawn = UISDL3Backend_DrawFillRects(backend, list);
+        break;
+    case UISDL3DrawMode_rects:
+        drawn = UISDL3Backend_DrawRects(backend, list);
+        break;
+    }
+    return drawn;
+}
+
+bool UI_FontMetrics(UIContext *ctx, uint32_t font, UIFontMetrics *metrics) {
+    (void)ctx;
+    float scale = font == 0 ? 1.0f : (float)font;
+    *metrics = (UIFontMetrics) { .ascent = 9.0f * scale, .lineHeight = 10.0f * scale };
+    return true;
+}
+
+bool UI_GlyphMetrics(UIContext *ctx, uint32_t font, uint32_t codepoint, UIGlyphMetrics *metrics) {
+    (void)ctx;
+    uint32_t scale = font == 0 ? 1 : font;
+    uint32_t size = codepoint == ' ' ? 0 : SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE * scale;
+    *metrics = (UIGlyphMetrics) {
+        .advance = (float)(SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE * scale),
+        .x = 0,
+        .y = -(float)size,
+        .w = size,
+        .h = size
+    };
+    return true;
+}
+
+bool UI_GlyphRasterize(UIContext *ctx, uint32_t font, uint32_t codepoint, uint8_t *pixels, uint32_t pitch) {
+    UISDL3Backend *backend = (UISDL3Backend *)ctx->userData;
+    if (backend->debugFont == NULL && !UISDL3Backend_LoadDebugFont(backend))
+        return false;
+    // Characters missing from the font are drawn as question marks
+    uint32_t glyph = codepoint - UISDL3_DEBUG_FONT_FIRST;
+    if (glyph >= UISDL3_DEBUG_FONT_COUNT)
+        glyph = '?' - UISDL3_DEBUG_FONT_FIRST;
+
+    uint32_t scale = font == 0 ? 1 : font;
+    uint32_t size = SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE;
+    uint32_t fontPitch = size * UISDL3_DEBUG_FONT_COUNT;
+    for (uint32_t y = 0; y < size * scale; y++) {
+        const uint8_t *row = backend->debugFont + y / scale * fontPitch + glyph * size;
+        for (uint32_t x = 0; x < size * scale; x++)
+            pixels[y * pitch + x] = row[x / scale];
+    }
+    return true;
+}
+
+// Draw the debug font white on black to a texture and read it back
+bool UISDL3Backend_LoadDebugFont(UISDL3Backend *backend) {
+    SDL_Renderer *renderer = backend->renderer;
+    int size = SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE;
+    char text[UISDL3_DEBUG_FONT_COUNT + 1];
+    for (int i = 0; i < UISDL3_DEBUG_FONT_COUNT; i++)
+        text[i] = (char)(UISDL3_DEBUG_FONT_FIRST + i);
+    text[UISDL3_DEBUG_FONT_COUNT] = '\0';
+
+    SDL_Texture *target = SDL_CreateTexture(
+        renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, size * UISDL3_DEBUG_FONT_COUNT, size);
+    if (target == NULL)
+        return false;
+    SDL_Texture *previous = SDL_GetRenderTarget(renderer);
+    SDL_Surface *surface = NULL;
+    if (SDL_SetRenderTarget(renderer, target)
+        && SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE)
+        && SDL_RenderClear(renderer)
+        && SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE)
+        && SDL_RenderDebugText(renderer, 0, 0, text))
+    {
+        surface = SDL_RenderReadPixels(renderer, NULL);
+    }
+    SDL_SetRenderTarget(renderer, previous);
+    SDL_DestroyTexture(target);
+    if (surface == NULL)
+        return false;
+
+    backend->debugFont = malloc((size_t)(size * UISDL3_DEBUG_FONT_COUNT * size));
+    bool read = backend->debugFont != NULL;
+    for (int y = 0; read && y < size; y++) {
+        for (int x = 0; read && x < size * UISDL3_DEBUG_FONT_COUNT; x++) {
+            Uint8 r, g, b, a;
+            read = SDL_ReadSurfacePixel(surface, x, y, &r, &g, &b, &a);
+            backend->debugFont[y * size * UISDL3_DEBUG_FONT_COUNT + x] = r;
+        }
+    }
+    SDL_DestroySurface(surface);
+    if (!read) {
+        free(backend->debugFont);
+        backend->debugFont = NULL;
+    }
+    return read;
+}
+
+#ifdef UI_STATS
+
+uint64_t UI_TimeNs(void) {
+    return SDL_GetTicksNS();
+}
+
+#endif // !UI_STATS
+
+#ifdef UI_THREADS
+
+bool UISDL3Worker_TakeTask(UISDL3Worker *worker, bool fromEnd, uint32_t *task) {
+    while (true) {
+        Uint32 range = SDL_GetAtomicU32(&worker->range);
+        Uint32 begin = range & 0xffff;
+        Uint32 end = range >> 16;
+        if (begin >= end)
+            return false;
+        Uint32 newRange = fromEnd ? begin | (end - 1) << 16 : (begin + 1) | end << 16;
+        if (SDL_CompareAndSwapAtomicU32(&worker->range, range, newRange)) {
+            *task = fromEnd ? end - 1 : begin;
+            return true;
+        }
+    }
+}
+
+// Run the tasks of the worker from the front, then steal from the back of the others
+void UISDL3Worker_Work(UISDL3Worker *worker) {
+    UISDL3Backend *backend = worker->backend;
+    uint32_t task;
+    while (true) {
+        if (UISDL3Worker_TakeTask(worker, false, &task)) {
+            backend->task(backend->taskData, backend->taskBase + task);
+            continue;
+        }
+        bool stolen = false;
+        for (uint32_t i = 1; i < backend->workerCount && !stolen; i++) {
+            UISDL3Worker *victim = &backend->workers[(worker->index + i) % backend->workerCount];
+            stolen = UISDL3Worker_TakeTask(victim, true, &task);
+        }
+        if (!stolen)
+            return;
+        backend->task(backend->taskData, backend->taskBase + task);
+    }
+}
+
+int UISDL3Worker_Main(void *data) {
+    UISDL3Worker *worker = (UISDL3Worker *)data;
+    UISDL3Backend *backend = worker->backend;
+    while (true) {
+        SDL_WaitSemaphore(backend->wake);
+        if (backend->quit)
+            return 0;
+        UISDL3Worker_Work(worker);
+        SDL_AddAtomicInt(&backend->busyWorkers, -1);
+    }
+}
+
+bool UISDL3Backend_StartWorkers(UISDL3Backend *backend, uint32_t threadCount) {
+    UISDL3Backend_StopWorkers(backend);
+    if (threadCount == 0)
+        return true;
+
+    backend->workers = calloc(threadCount + 1, sizeof(UISDL3Worker));
+    backend->wake = SDL_CreateSemaphore(0);
+    if (backend->workers == NULL || backend->wake == NULL) {
+        UISDL3Backend_StopWorkers(backend);
+        return false;
+    }
+    backend->quit = false;
+    SDL_SetAtomicInt(&backend->busyWorkers, 0);
+    backend->workerCount = 1;
+    backend->workers[0].backend = backend;
+    backend->workers[0].index = 0;
+    for (uint32_t i = 1; i <= threadCount; i++) {
+        UISDL3Worker *worker = &backend->workers[i];
+        worker->backend = backend;
+        worker->index = i;
+        worker->thread = SDL_CreateThread(UISDL3Worker_Main, "UI layout", worker);
+        if (worker->thread == NULL) {
+            UISDL3Backend_StopWorkers(backend);
+            return false;
+        }
+        backend->workerCount++;
+    }
+    return true;
+}
+
+void UISDL3Backend_StopWorkers(UISDL3Backend *backend) {
+    if (backend->workers != NULL) {
+        backend->quit = true;
+        for (uint32_t i = 1; i < backend->workerCount; i++)
+            SDL_SignalSemaphore(backend->wake);
+        for (uint32_t i = 1; i < backend->workerCount; i++)
+            SDL_WaitThread(backend->workers[i].thread, NULL);
+        free(backend->workers);
+    }
+    if (backend->wake != NULL)
+        SDL_DestroySemaphore(backend->wake);
+    backend->workers = NULL;
+    backend->workerCount = 0;
+    backend->wake = NULL;
+}
+
+void UI_RunTasks(UIContext *ctx, void (*task)(void *data, uint32_t index), void *data, uint32_t count) {
+    UISDL3Backend *backend = (UISDL3Backend *)ctx->userData;
+    if (backend->workerCount < 2) {
+        for (uint32_t i = 0; i < count; i++)
+            task(data, i);
+        return;
+    }
+
+    backend->task = task;
+    backend->taskData = data;
+    uint32_t workerCount = backend->workerCount;
+    // A range holds at most 65535 tasks
+    for (uint32_t base = 0; base < count; base += 0xffff) {
+        uint32_t n = count - base < 0xffff ? count - base : 0xffff;
+        backend->taskBase = base;
+        for (uint32_t i = 0; i < workerCount; i++) {
+            Uint32 begin = n * i / workerCount;
+            Uint32 end = n * (i + 1) / workerCount;
+            SDL_SetAtomicU32(&backend->workers[i].range, begin | end << 16);
+        }
+
+        SDL_SetAtomicInt(&backend->busyWorkers, (int)workerCount - 1);
+        for (uint32_t i = 1; i < workerCount; i++)
+            SDL_SignalSemaphore(backend->wake);
+        UISDL3Worker_Work(&backend->workers[0]);
+        // The other workers may still be running the tasks they took
+        while (SDL_GetAtomicInt(&backend->busyWorkers) != 0)
+            SDL_CPUPauseInstruction();
+    }
+}
+
+#endif // !UI_THREADS
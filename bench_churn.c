@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Adds and destroys items of two feeds for `cycles` cycles and checks that the
+// memory stays flat. Each cycle adds an item with a title and a body at the
+// end of a feed and destroys the oldest one when the feed has `live` items.
+// Some cycles move an item to the top of its feed or to the other feed, and a
+// frame is drawn every `cycles / frames` cycles.
+// Usage: bench_churn [cycles] [live] [frames]
+// The live allocations, the elements of the pool and its slabs are measured
+// after the first 10% of the cycles and must not grow afterwards.
+// A pool of a million items is then emptied but for one item and trimmed,
+// only the slab of that item must be left. An item freed after a reset of the
+// pool, before anything is allocated or trimmed, must be ignored.
+// Last, the children of a row of 10000 are destroyed from the first, from the
+// last and in a scattered order, which take about the same time as the
+// siblings keep their slots.
+
+typedef struct Memory {
+    uint64_t blocks; // Allocated and not freed
+    uint32_t elements;
+    uint32_t slabs;
+} Memory;
+
+bool addItem(UIElement *feed, uint32_t cycle);
+Memory measureMemory(UIContext *ctx);
+bool trimPool(uint32_t itemCount, double *trimTime);
+bool destroyChildren(uint32_t childCount, uint32_t position, double *time);
+double timeNow(void);
+
+const char *titles[] = { "Build passed", "New message", "Disk almost full", "Deploy finished" };
+const char *bodies[] = {
+    "The nightly build of the main branch passed every test.",
+    "Someone replied to the thread about the release notes.",
+    "Only 2 GB are left on the volume that holds the logs.",
+    "Version 2.4 is live in every region."
+};
+
+int main(int argc, char **argv) {
+    uint32_t cycles = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    uint32_t live = argc > 2 ? (uint32_t)atoi(argv[2]) : 200;
+    uint32_t frames = argc > 3 ? (uint32_t)atoi(argv[3]) : 10000;
+    uint32_t frameEvery = frames == 0 || cycles / frames == 0 ? 1 : cycles / frames;
+
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&context, 0);
+    UIContext_UpdateWindow(&context, 1280, 720);
+    UI_LayoutDirection(context.root, UILayoutDirection_leftToRight);
+
+    UIElement *feeds[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        feeds[i] = UIElement_New(context.root);
+        if (feeds[i] == NULL)
+            return 1;
+        UI_FillWidth(feeds[i], 1.0f);
+        UI_FillHeight(feeds[i], 1.0f);
+        UI_ClipChildren(feeds[i], true);
+        UI_ChildGap(feeds[i], 4.0f);
+    }
+
+    Memory warm = { 0, 0, 0 };
+    Memory peak = { 0, 0, 0 };
+    double start = timeNow();
+    for (uint32_t c = 0; c < cycles; c++) {
+        UIElement *feed = feeds[c % 2];
+        if (!addItem(feed, c)) {
+            fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+            return 1;
+        }
+        uint32_t count = UIElement_ChildCount(feed);
+        if (count > live)
+            UIElement_Destroy(UIElement_Child(feed, 0));
+        count = UIElement_ChildCount(feed);
+        if (c % 7 == 0)
+            UIElement_SetIndex(UIElement_Child(feed, count - 1), 0);
+        if (c % 11 == 0 && !UIElement_SetParent(UIElement_Child(feed, count / 2), feeds[(c + 1) % 2]))
+            return 1;
+
+        if (c % frameEvery == 0 && !UIContext_Draw(&context))
+            return 1;
+        Memory memory = measureMemory(&context);
+        if (c < cycles / 10) {
+            warm = memory;
+            continue;
+        }
+        if (memory.blocks > peak.blocks)
+            peak.blocks = memory.blocks;
+        if (memory.elements > peak.elements)
+            peak.elements = memory.elements;
+        if (memory.slabs > peak.slabs)
+            peak.slabs = memory.slabs;
+    }
+    double time = timeNow() - start;
+
+    bool flat = peak.blocks <= warm.blocks && peak.elements <= warm.elements && peak.slabs <= warm.slabs;
+    printf(
+        "%u cycles  %.0f ns/cycle  %u items in the feeds\n"
+        "after 10%%: %llu blocks  %u elements  %u slabs\n"
+        "peak after: %llu blocks  %u elements  %u slabs  (%s)\n",
+        cycles, time * 1e9 / cycles, UIElement_ChildCount(feeds[0]) + UIElement_ChildCount(feeds[1]),
+        (unsigned long long)warm.blocks, warm.elements, warm.slabs,
+        (unsigned long long)peak.blocks, peak.elements, peak.slabs, flat ? "flat" : "GROWING");
+
+    double trimTime;
+    bool trimmed = trimPool(1000000, &trimTime);
+    printf("trim of a million items  %.3f ms  (%s)\n", trimTime * 1e3, trimmed ? "ok" : "WRONG");
+
+    double firstTime, lastTime, scatteredTime;
+    bool destroyed = destroyChildren(10000, 0, &firstTime) && destroyChildren(10000, 1, &lastTime)
+        && destroyChildren(10000, 2, &scatteredTime);
+    printf(
+        "destroy one of 10000 children  first %.0f ns  last %.0f ns  scattered %.0f ns  (%s)\n",
+        firstTime * 1e9 / 10000, lastTime * 1e9 / 10000, scatteredTime * 1e9 / 10000, destroyed ? "ok" : "WRONG");
+
+    UIContext_Destroy(&context);
+    return flat && trimmed && destroyed ? 0 : 1;
+}
+
+bool addItem(UIElement *feed, uint32_t cycle) {
+    UIElement *item = UIElement_New(feed);
+    UIElement *title = item == NULL ? NULL : UIElement_New(item);
+    UIElement *body = title == NULL ? NULL : UIElement_New(item);
+    if (body == NULL)
+        return false;
+    UI_FillWidth(item, 1.0f);
+    UI_Padding(item, 4.0f);
+    UI_BackgroundColor(item, cycle % 2 == 0 ? UI_WHITE : UI_BLUE);
+    UI_Text(title, titles[cycle % 4], 1, UI_BLACK);
+    UI_FillWidth(body, 1.0f);
+    UI_Text(body, bodies[cycle % 4], 1, UI_BLACK);
+    UI_TextWrap(body, true);
+    return true;
+}
+
+Memory measureMemory(UIContext *ctx) {
+    Memory memory;
+    memory.blocks = UINull_memStats.allocs - UINull_memStats.frees;
+    memory.elements = ctx->_elementAllocator.bucketCount;
+    memory.slabs = 0;
+    for (UI__PoolSlab *slab = ctx->_elementAllocator.firstSlab; slab != NULL; slab = slab->next)
+        memory.slabs++;
+    return memory;
+}
+
+// Free all the items but the last one and trim the pool, then free an item
+// allocated before a reset, while its slab still holds it
+bool trimPool(uint32_t itemCount, double *trimTime) {
+    UIPoolAllocator pool;
+    UIPoolAllocatorInit(&pool, 32, 0);
+    void **items = (void **)malloc(sizeof(void *) * itemCount);
+    if (items == NULL)
+        return false;
+    for (uint32_t i = 0; i < itemCount; i++) {
+        items[i] = UIPoolAllocatorAlloc(&pool);
+        if (items[i] == NULL)
+            return false;
+    }
+    for (uint32_t i = 0; i + 1 < itemCount; i++)
+        UIPoolAllocatorFree(&pool, items[i]);
+    double start = timeNow();
+    UIPoolAllocatorTrim(&pool);
+    *trimTime = timeNow() - start;
+
+    uint32_t slabs = 0;
+    for (UI__PoolSlab *slab = pool.firstSlab; slab != NULL; slab = slab->next)
+        slabs++;
+    bool ok = slabs == 1 && pool.bucketCount == 1 && UIPoolAllocatorAlloc(&pool) != NULL;
+    UIPoolAllocatorReset(&pool);
+    UIPoolAllocatorFree(&pool, items[itemCount - 1]);
+    ok &= pool.bucketCount == 0;
+
+    UIPoolAllocatorDestroy(&pool);
+    free(items);
+    return ok;
+}
+
+// Destroy the children of a row one by one, from the first (0), from the last
+// (1) or scattered (2). Half of them are then made and destroyed again, and the
+// ones left must be laid out in order and know their slot.
+bool destroyChildren(uint32_t childCount, uint32_t order, double *time) {
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return false;
+    UIContext_SetMaxElements(&context, 0);
+    UIContext_UpdateWindow(&context, 1280, 720);
+    UIElement *row = UIElement_New(context.root);
+    UIElement **children = (UIElement **)malloc(sizeof(UIElement *) * childCount);
+    bool ok = row != NULL && children != NULL && UIElement_ReserveChildren(row, childCount);
+    if (ok)
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+    for (uint32_t i = 0; i < childCount && ok; i++) {
+        children[i] = UIElement_New(row);
+        ok = children[i] != NULL;
+        if (ok)
+            UI_FixedWidth(children[i], 1.0f);
+    }
+    if (!ok) {
+        free(children);
+        UIContext_Destroy(&context);
+        return false;
+    }
+
+    // 7919 is prime, so the scattered order passes every child once
+    double start = timeNow();
+    for (uint32_t i = 0; i < childCount; i++) {
+        uint32_t index = order == 0 ? i : order == 1 ? childCount - 1 - i : (uint32_t)((uint64_t)i * 7919 % childCount);
+        UIElement_Destroy(children[index]);
+    }
+    *time = timeNow() - start;
+    ok = UIElement_ChildCount(row) == 0 && row->children.len == 0;
+
+    for (uint32_t i = 0; i < childCount && ok; i++) {
+        children[i] = UIElement_New(row);
+        ok = children[i] != NULL;
+        if (ok)
+            UI_FixedWidth(children[i], 1.0f);
+    }
+    for (uint32_t i = 0; i < childCount / 2 && ok; i++) {
+        uint32_t index = order == 0 ? i : order == 1 ? childCount - 1 - i : (uint32_t)((uint64_t)i * 7919 % childCount);
+        UIElement_Destroy(children[index]);
+        children[index] = NULL;
+    }
+    ok = ok && UIContext_Draw(&context) && UIElement_ChildCount(row) == childCount - childCount / 2;
+    uint32_t left = 0;
+    for (uint32_t i = 0; i < childCount && ok; i++) {
+        if (children[i] == NULL)
+            continue;
+        ok = UIElement_Child(row, left) == children[i] && row->children.data[children[i]->_index] == children[i]
+            && UIElement_Box(children[i]).x == (float)left;
+        left++;
+    }
+    free(children);
+    UIContext_Destroy(&context);
+    return ok;
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
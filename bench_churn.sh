@@ -0,0 +1,9 @@
+#! /usr/bin/sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_churn.c $FLAGS -o build/bench_churn && ./build/bench_churn "$@"
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "cpu_impl.c"
+
+// Draws a grid of `rows * cols` elements with the CPU backend on the calling
+// thread and with 1, 2, 4 and 8 more threads, and fails if the pixels differ.
+// Usage: bench_cpu [rows] [cols] [frames]
+// Compare the megapixels per second with the software renderer of bench_draw.
+
+#define WIDTH 1280
+#define HEIGHT 720
+
+bool generateGrid(UIElement *root, uint32_t rows, uint32_t cols);
+uint64_t hashPixels(const uint8_t *pixels, size_t size);
+double timeNow(void);
+
+int main(int argc, char **argv) {
+    uint32_t rows = argc > 1 ? (uint32_t)atoi(argv[1]) : 60;
+    uint32_t cols = argc > 2 ? (uint32_t)atoi(argv[2]) : 60;
+    uint32_t frames = argc > 3 ? (uint32_t)atoi(argv[3]) : 200;
+
+    uint8_t *pixels = malloc(WIDTH * HEIGHT * 4);
+    if (pixels == NULL)
+        return 1;
+    UICPUBackend backend;
+    UICPUBackend_Init(&backend, pixels, WIDTH, HEIGHT, WIDTH * 4);
+
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&context, 0);
+    if (!generateGrid(context.root, rows, cols)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        return 1;
+    }
+    UIContext_UpdateWindow(&context, WIDTH, HEIGHT);
+
+    printf("%u elements, %u frames\n", rows * cols + 2 * rows + 1, frames);
+    uint32_t threadCounts[] = { 0, 1, 2, 4, 8 };
+    uint64_t expected = 0;
+    bool matches = true;
+    for (uint32_t i = 0; i < sizeof(threadCounts) / sizeof(*threadCounts); i++) {
+        if (!UICPUBackend_StartWorkers(&backend, threadCounts[i])) {
+            fprintf(stderr, "Could not start %u threads\n", threadCounts[i]);
+            return 1;
+        }
+        double time = 0;
+        uint64_t pixelsDrawn = 0;
+        for (uint32_t f = 0; f < frames; f++) {
+            memset(pixels, 0, WIDTH * HEIGHT * 4);
+            double start = timeNow();
+            UIContext_ForceRedraw(&context);
+            if (!UIContext_Draw(&context)) {
+                fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+                return 1;
+            }
+            time += timeNow() - start;
+            pixelsDrawn += backend.pixelsDrawn;
+        }
+
+        uint64_t hash = hashPixels(pixels, WIDTH * HEIGHT * 4);
+        if (i == 0)
+            expected = hash;
+        matches &= hash == expected;
+        printf(
+            "%u threads %10.3f ms/frame %10.1f MP/s   %016llx%s\n",
+            threadCounts[i] + 1,
+            time * 1e3 / frames,
+            pixelsDrawn / 1e6 / time,
+            (unsigned long long)hash,
+            hash == expected ? "" : " (differs)");
+    }
+
+    UIContext_Destroy(&context);
+    UICPUBackend_Destroy(&backend);
+    free(pixels);
+    return matches ? 0 : 1;
+}
+
+bool generateGrid(UIElement *root, uint32_t rows, uint32_t cols) {
+    UIColor colors[] = {
+        UI_RED, UI_GREEN, UI_BLUE, UI_WHITE,
+        { 255, 128, 0, 128 }, { 0, 128, 255, 64 }
+    };
+    UI_BackgroundColor(root, UI_BLACK);
+    UI_Padding(root, 2);
+    UI_ChildGap(root, 1);
+
+    for (uint32_t r = 0; r < rows; r++) {
+        UIElement *row = UIElement_New(root);
+        if (row == NULL)
+            return false;
+        UI_BackgroundColor(row, UI_BLACK);
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+        UI_FillWidth(row, 1.0f);
+        UI_FillHeight(row, 1.0f);
+        UI_ChildGap(row, 1);
+
+        // A label on every row, to draw glyphs from the atlas
+        UIElement *label = UIElement_New(row);
+        if (label == NULL)
+            return false;
+        UI_Text(label, "Row", 1, (UIColor) { 255, 255, 0, 192 });
+        for (uint32_t c = 0; c < cols; c++) {
+            UIElement *cell = UIElement_New(row);
+            if (cell == NULL)
+                return false;
+            // Runs of two cells share the same color
+            UI_BackgroundColor(cell, colors[(c / 2 + r) % 6]);
+            UI_FillWidth(cell, 1.0f);
+            UI_FillHeight(cell, 1.0f);
+        }
+    }
+    return true;
+}
+
+// FNV-1a over the bytes
+uint64_t hashPixels(const uint8_t *pixels, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ pixels[i]) * 1099511628211ull;
+    return hash;
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
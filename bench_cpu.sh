@@ -0,0 +1,9 @@
+#! /usr/bin/sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_cpu.c $FLAGS -lm -lpthread -o build/bench_cpu && ./build/bench_cpu "$@"
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "SDL3/SDL.h"
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "SDL3_impl.c"
+
+// Compares the SDL3 draw modes on a grid of `rows * cols` elements, drawing
+// the whole grid and then changing the color of a single cell every frame
+// with partial redraw.
+// Usage: bench_draw [rows] [cols] [frames] [window]
+// Without `window` the frames are drawn by the software renderer on a surface.
+// The megapixels per second can be compared with the CPU backend of bench_cpu.
+
+bool generateGrid(UIElement *root, uint32_t rows, uint32_t cols);
+uint64_t countPixels(const UIDrawList *list);
+void logErrorAndExit(void);
+
+int main(int argc, char **argv) {
+    uint32_t rows = argc > 1 ? (uint32_t)atoi(argv[1]) : 60;
+    uint32_t cols = argc > 2 ? (uint32_t)atoi(argv[2]) : 60;
+    uint32_t frames = argc > 3 ? (uint32_t)atoi(argv[3]) : 200;
+    bool useWindow = argc > 4 && strcmp(argv[4], "window") == 0;
+
+    if (!SDL_Init(useWindow ? SDL_INIT_VIDEO : 0))
+        logErrorAndExit();
+
+    SDL_Window *window = NULL;
+    SDL_Surface *surface = NULL;
+    SDL_Renderer *renderer = NULL;
+    if (useWindow) {
+        window = SDL_CreateWindow("C UI bench", 1280, 720, SDL_WINDOW_HIDDEN);
+        if (window == NULL) logErrorAndExit();
+        renderer = SDL_CreateRenderer(window, NULL);
+    } else {
+        surface = SDL_CreateSurface(1280, 720, SDL_PIXELFORMAT_RGBA32);
+        if (surface == NULL) logErrorAndExit();
+        renderer = SDL_CreateSoftwareRenderer(surface);
+    }
+    if (renderer == NULL) logErrorAndExit();
+
+    UISDL3Backend backend;
+    UISDL3Backend_Init(&backend, renderer);
+
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&context, 0);
+    if (!generateGrid(context.root, rows, cols)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        return 1;
+    }
+    UIContext_UpdateWindow(&context, 1280, 720);
+
+    const char *modeNames[] = {
+        [UISDL3DrawMode_geometry] = "geometry",
+        [UISDL3DrawMode_fillRects] = "fillRects",
+        [UISDL3DrawMode_rects] = "rects (one call per element)"
+    };
+    UISDL3DrawMode modes[] = { UISDL3DrawMode_rects, UISDL3DrawMode_fillRects, UISDL3DrawMode_geometry };
+
+    printf("%u elements, %u frames\n", rows * cols + rows + 1, frames);
+    printf("Whole grid\n");
+    for (uint32_t m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+        backend.drawMode = modes[m];
+        Uint64 drawTime = 0;
+        Uint64 totalTime = 0;
+        uint64_t pixels = 0;
+        for (uint32_t f = 0; f < frames; f++) {
+            Uint64 start = SDL_GetTicksNS();
+            if (!SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE))
+                logErrorAndExit();
+            if (!SDL_RenderClear(renderer))
+                logErrorAndExit();
+            UIContext_ForceRedraw(&context);
+            if (!UIContext_Draw(&context))
+                logErrorAndExit();
+            Uint64 drawEnd = SDL_GetTicksNS();
+            if (!SDL_FlushRenderer(renderer))
+                logErrorAndExit();
+            Uint64 end = SDL_GetTicksNS();
+            drawTime += drawEnd - start;
+            totalTime += end - start;
+            pixels += countPixels(&context.drawList);
+        }
+        printf(
+            "%-30s %8u calls/frame %10.3f ms/frame submit %10.3f ms/frame total %8.1f MP/s\n",
+            modeNames[modes[m]],
+            backend.drawCalls,
+            drawTime / 1e6 / frames,
+            totalTime / 1e6 / frames,
+            pixels * 1e3 / totalTime);
+    }
+
+    // Only the cell that changed is drawn to the backbuffer, which is then
+    // copied to the renderer
+    UIContext_SetPartialRedraw(&context, true);
+    printf("One cell changed with partial redraw\n");
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    for (uint32_t m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+        backend.drawMode = modes[m];
+        UIContext_ForceRedraw(&context);
+        if (!UIContext_Draw(&context))
+            logErrorAndExit();
+        Uint64 drawTime = 0;
+        Uint64 totalTime = 0;
+        uint64_t pixels = 0;
+        for (uint32_t f = 0; f < frames; f++) {
+            UIElement *row = context.root->children.data[f % rows];
+            UI_BackgroundColor(row->children.data[f / rows % cols], colors[f % 4]);
+            Uint64 start = SDL_GetTicksNS();
+            if (!UIContext_Draw(&context))
+                logErrorAndExit();
+            Uint64 drawEnd = SDL_GetTicksNS();
+            if (!SDL_FlushRenderer(renderer))
+                logErrorAndExit();
+            Uint64 end = SDL_GetTicksNS();
+            drawTime += drawEnd - start;
+            totalTime += end - start;
+            pixels += countPixels(&context.drawList);
+        }
+        printf(
+            "%-30s %8u calls/frame %10.3f ms/frame submit %10.3f ms/frame total %8.1f MP/s\n",
+            modeNames[modes[m]],
+            backend.drawCalls,
+            drawTime / 1e6 / frames,
+            totalTime / 1e6 / frames,
+            pixels * 1e3 / totalTime);
+    }
+
+    UIContext_Destroy(&context);
+    UISDL3Backend_Destroy(&backend);
+    SDL_DestroyRenderer(renderer);
+    if (surface != NULL)
+        SDL_DestroySurface(surface);
+    if (window != NULL)
+        SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return 0;
+}
+
+void logErrorAndExit(void)  {
+    fprintf(stderr, "SDL Error: %s\n", SDL_GetError());
+    exit(1);
+}
+
+// Pixels whose center is inside the visible part of each command, the same
+// count as the CPU backend
+uint64_t countPixels(const UIDrawList *list) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < list->len; i++) {
+        UIRect rect = list->data[i].rect;
+        UIRect clip = list->data[i].clip;
+        float x0 = ceilf(fmaxf(fmaxf(rect.x, clip.x), 0) - 0.5f);
+        float y0 = ceilf(fmaxf(fmaxf(rect.y, clip.y), 0) - 0.5f);
+        float x1 = ceilf(fminf(fminf(rect.x + rect.w, clip.x + clip.w), 1280) - 0.5f);
+        float y1 = ceilf(fminf(fminf(rect.y + rect.h, clip.y + clip.h), 720) - 0.5f);
+        if (list->data[i].color.a != 0 && x1 > x0 && y1 > y0)
+            count += (uint64_t)(x1 - x0) * (uint64_t)(y1 - y0);
+    }
+    return count;
+}
+
+bool generateGrid(UIElement *root, uint32_t rows, uint32_t cols) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UI_BackgroundColor(root, UI_BLACK);
+    UI_Padding(root, 2);
+    UI_ChildGap(root, 1);
+
+    for (uint32_t r = 0; r < rows; r++) {
+        UIElement *row = UIElement_New(root);
+        if (row == NULL)
+            return false;
+        UI_BackgroundColor(row, UI_BLACK);
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+        UI_FillWidth(row, 1.0f);
+        UI_FillHeight(row, 1.0f);
+        UI_ChildGap(row, 1);
+
+        for (uint32_t c = 0; c < cols; c++) {
+            UIElement *cell = UIElement_New(row);
+            if (cell == NULL)
+                return false;
+            // Runs of two cells share the same color
+            UI_BackgroundColor(cell, colors[(c / 2 + r) % 4]);
+            UI_FillWidth(cell, 1.0f);
+            UI_FillHeight(cell, 1.0f);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,14 @@
+#! /usr/bin/sh
+
+sh SDL3/buildSDL.sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+SDL_PATH="$(SDL3/SDLpath.sh)"
+INCLUDE=${SDL_PATH}/include
+LIB=${SDL_PATH}/lib
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_draw.c -I$INCLUDE -L$LIB -lSDL3 $FLAGS -lm -o build/bench_draw && export LD_LIBRARY_PATH=$LIB && ./build/bench_draw "$@"
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Measures the fill pass on a row of fill children with minimums and maximums
+// and compares it with the loop it had before the solver, which clamps every
+// child whose share of what is left breaks its minimum or its maximum, in
+// rounds until one clamps none. The pass runs the same loop and leaves the
+// containers still clamping children after `UI__FILL_MAX_ROUNDS` rounds to the
+// solver, which shares what is left in one pass over the sorted limits.
+// Usage: bench_fill [children] [repetitions]
+// - `mixed` gives random weights, minimums and maximums to the children
+// - `cascade` gives the children growing minimums, so that each round of the
+//   loop only clamps the few children whose minimum is above the last share
+// - `chain` ends the row with 100 children whose weights double, each one with
+//   a maximum its share only breaks once the heavier ones are clamped. At 12
+//   pixels per child the loop clamps one of them per round and passes the
+//   whole row each time. The weights are beyond the precision of their float
+//   sum, at the other widths the row can end up smaller or larger than the
+//   window, in the loop and in the pass alike.
+// The row is filled for several widths of the window, from one where most
+// children stay at their minimum to one where most reach their maximum.
+// The pass must give the sizes of the loop within a relative error of
+// `children * FLT_EPSILON`, 1.2e-3 for 10000 children: the solver shares a
+// space that is a sum of float sizes over the row, rounded once per child.
+
+typedef struct Shape {
+    const char *name;
+    bool (*generate)(UIElement *row, uint32_t count);
+} Shape;
+
+bool generateMixed(UIElement *row, uint32_t count);
+bool generateCascade(UIElement *row, uint32_t count);
+bool generateChain(UIElement *row, uint32_t count);
+bool benchShape(const Shape *shape, uint32_t count, uint32_t repetitions);
+uint32_t fillBaseline(UI__Tree *tree, uint32_t handle, UIRect *boxes, uint32_t *fillChildren);
+double timeNow(void);
+float randomFloat(float max);
+
+int main(int argc, char **argv) {
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    uint32_t repetitions = argc > 2 ? (uint32_t)atoi(argv[2]) : 20;
+
+    const Shape shapes[] = {
+        { "mixed", generateMixed },
+        { "cascade", generateCascade },
+        { "chain", generateChain }
+    };
+    bool matches = true;
+    for (uint32_t i = 0; i < sizeof(shapes) / sizeof(*shapes); i++)
+        matches &= benchShape(&shapes[i], count, repetitions);
+    return matches ? 0 : 1;
+}
+
+bool benchShape(const Shape *shape, uint32_t count, uint32_t repetitions) {
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        exit(1);
+    UIContext_SetMaxElements(&context, 0);
+
+    UIElement *row = UIElement_New(context.root);
+    if (row == NULL || !UIElement_ReserveChildren(row, count) || !shape->generate(row, count)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        exit(1);
+    }
+    UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+    UI_FillWidth(row, 1.0f);
+    UI_FillHeight(row, 1.0f);
+
+    UIRect *boxes = (UIRect *)malloc(sizeof(UIRect) * (count + 2));
+    uint32_t *fillChildren = (uint32_t *)malloc(sizeof(uint32_t) * count);
+    if (boxes == NULL || fillChildren == NULL)
+        exit(1);
+    double tolerance = count * FLT_EPSILON;
+
+    bool matches = true;
+    const uint32_t pixelsPerChild[] = { 4, 8, 12, 16, 24 };
+    for (uint32_t w = 0; w < sizeof(pixelsPerChild) / sizeof(*pixelsPerChild); w++) {
+        UIContext_UpdateWindow(&context, count * pixelsPerChild[w], 720);
+        if (!UIContext_Draw(&context))
+            exit(1);
+        UI__Tree *tree = &context._tree;
+        uint32_t handle = row->_handle;
+        UI__Links links = tree->links[handle];
+
+        uint32_t iterations = 0;
+        double start = timeNow();
+        for (uint32_t r = 0; r < repetitions; r++)
+            iterations = UI__TreeFillWidth(tree, handle);
+        double passTime = (timeNow() - start) / repetitions;
+
+        uint32_t rounds = 0;
+        start = timeNow();
+        for (uint32_t r = 0; r < repetitions; r++)
+            rounds = fillBaseline(tree, handle, boxes, fillChildren);
+        double loopTime = (timeNow() - start) / repetitions;
+
+        // Children left unclamped by a row too small keep the size of the fit
+        // pass, their minimum, which the repetitions changed
+        for (uint32_t i = 0; i < links.childCount; i++)
+            UI__TreeFitWidth(tree, links.firstChild + i);
+        UI__TreeFillWidth(tree, handle);
+        double maxError = 0;
+        double total = 0;
+        for (uint32_t i = 0; i < links.childCount; i++) {
+            uint32_t child = links.firstChild + i;
+            float size = tree->boxes[child].w;
+            float loopSize = boxes[child].w;
+            maxError = fmax(maxError, fabs((double)size - loopSize) / fmax(1.0, fabs((double)loopSize)));
+            total += size;
+        }
+        bool match = maxError <= tolerance;
+        matches &= match;
+        printf(
+            "%-7s %6u children %3u px each  pass %9.3f ms (%5u rounds and events)  loop %9.3f ms (%5u rounds)  %7.2fx  "
+            "used %.0f of %u px  error %.1e (%s)\n",
+            shape->name, links.childCount, pixelsPerChild[w],
+            passTime * 1e3, iterations, loopTime * 1e3, rounds, loopTime / passTime,
+            total, count * pixelsPerChild[w], maxError, match ? "same" : "DIFFERENT");
+    }
+    printf("%-7s tolerance %.1e\n", shape->name, tolerance);
+
+    free(boxes);
+    free(fillChildren);
+    UIContext_Destroy(&context);
+    return matches;
+}
+
+bool generateMixed(UIElement *row, uint32_t count) {
+    srand(1);
+    for (uint32_t i = 0; i < count; i++) {
+        UIElement *element = UIElement_New(row);
+        if (element == NULL)
+            return false;
+        UI_FillWidth(element, 1 + randomFloat(4));
+        UI_FillHeight(element, 1.0f);
+        float min = rand() % 2 == 0 ? randomFloat(20) : 0;
+        UI_MinWidth(element, min);
+        if (rand() % 2 == 0)
+            UI_MaxWidth(element, min + 2 + randomFloat(20));
+    }
+    return true;
+}
+
+bool generateCascade(UIElement *row, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        UIElement *element = UIElement_New(row);
+        if (element == NULL)
+            return false;
+        UI_FillWidth(element, 1.0f);
+        UI_FillHeight(element, 1.0f);
+        UI_MinWidth(element, 2 + 20.0f * i / count);
+    }
+    return true;
+}
+
+// Children of weight 1 and no limits, then children whose weights double. The
+// heaviest one is just above its share of 12 pixels per child, and each other
+// one is at the share of one unit of weight before the next heavier one is
+// clamped, so it is clamped by the round after it.
+bool generateChain(UIElement *row, uint32_t count) {
+    // The children of the chain are in the reverse order of the rounds that
+    // clamp them and their weights double, the remaining weight the loop
+    // subtracts stays exact. The rounds of the loop are played in float at 12
+    // pixels per child, a child gets the largest of its shares in the rounds
+    // before its own as its maximum, which its share in its own round breaks.
+    uint32_t chainCount = count < 200 ? count / 2 : 100;
+    uint32_t first = count - chainCount;
+    float *spaces = (float *)malloc(sizeof(float) * chainCount * 2);
+    if (spaces == NULL)
+        return false;
+    float *totalWeights = spaces + chainCount;
+    float totalWeight = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        UIElement *element = UIElement_New(row);
+        if (element == NULL) {
+            free(spaces);
+            return false;
+        }
+        float weight = i < first ? 1.0f : ldexpf(1.0f, (int)(i - first) + 1);
+        UI_FillWidth(element, weight);
+        UI_FillHeight(element, 1.0f);
+        totalWeight += weight;
+    }
+    float space = 12.0f * count;
+    for (uint32_t k = 0; k < chainCount; k++) {
+        float weight = ldexpf(1.0f, (int)(chainCount - k));
+        float share = space * weight / totalWeight;
+        float max = share / 2;
+        for (uint32_t r = 0; r < k; r++) {
+            float earlier = spaces[r] * weight / totalWeights[r];
+            max = r == 0 || earlier > max ? earlier : max;
+        }
+        if (!(max < share))
+            break;
+        UI_MaxWidth(UIElement_Child(row, count - 1 - k), max);
+        spaces[k] = space;
+        totalWeights[k] = totalWeight;
+        space -= max;
+        totalWeight -= weight;
+    }
+    free(spaces);
+    return true;
+}
+
+// The loop of the fill pass before the solver: clamp every child whose share
+// of what is left breaks its minimum or its maximum, in order, and take its
+// size out of the space, until a round clamps none. The widths are written to
+// `boxes`, rows like the boxes of the tree. Return the rounds of the loop.
+uint32_t fillBaseline(UI__Tree *tree, uint32_t handle, UIRect *boxes, uint32_t *fillChildren) {
+    UI__Links links = tree->links[handle];
+    float childWidth = tree->childExtent[handle];
+    float totalWeight = 0;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < links.childCount; i++) {
+        uint32_t child = links.firstChild + i;
+        UI__Sizing *sizing = &tree->sizing[child];
+        boxes[child].w = sizing->w_min;
+        if (sizing->w_weight <= 0)
+            continue;
+        fillChildren[n++] = child;
+        totalWeight += sizing->w_weight;
+        childWidth -= sizing->w_min;
+    }
+    float spaceRemaining = tree->boxes[handle].w - childWidth;
+    if (spaceRemaining < 0 || totalWeight == 0)
+        return 0;
+
+    uint32_t rounds = 0;
+    float prevSpaceRemaining;
+    do {
+        rounds++;
+        prevSpaceRemaining = spaceRemaining;
+        for (uint32_t i = 0; i < n; i++) {
+            UI__Sizing *sizing = &tree->sizing[fillChildren[i]];
+            float size = spaceRemaining * sizing->w_weight / totalWeight;
+            if (size >= sizing->w_min && (size <= sizing->w_max || sizing->w_max == 0))
+                continue;
+            if (size < sizing->w_min)
+                size = sizing->w_min;
+            else if (size > sizing->w_max)
+                size = sizing->w_max;
+            totalWeight -= sizing->w_weight;
+            spaceRemaining -= size;
+            boxes[fillChildren[i]].w = size;
+            fillChildren[i--] = fillChildren[--n];
+        }
+    } while (prevSpaceRemaining != spaceRemaining && spaceRemaining >= 0);
+
+    if (spaceRemaining < 0)
+        return rounds;
+    for (uint32_t i = 0; i < n; i++)
+        boxes[fillChildren[i]].w = spaceRemaining * tree->sizing[fillChildren[i]].w_weight / totalWeight;
+    return rounds;
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+float randomFloat(float max) {
+    return (float)rand() / (float)RAND_MAX * max;
+}
@@ -0,0 +1,9 @@
+#! /usr/bin/sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_fill.c $FLAGS -lm -o build/bench_fill && ./build/bench_fill "$@"
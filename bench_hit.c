@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Compares `UI_HitTest` and `UI_QueryRect` with a walk of every element on a
+// dashboard of `panels` panels of `rows * cols` cells, half of them in clipped
+// panels that are scrolled, and checks that the results match. A clipped panel
+// is then scrolled every frame, which moves its rows in the grid, and the first
+// query after each frame is timed. Half of the panels are then destroyed and a
+// snapshot is taken, which rebuilds the tree outside of a frame, and the
+// results must still match after each change.
+// Usage: bench_hit [panels] [rows] [cols] [queries]
+
+bool generateDashboard(UIElement *root, uint32_t panels, uint32_t rows, uint32_t cols);
+UIElement *bruteHitTest(UIContext *ctx, float x, float y);
+uint32_t bruteQueryRect(UIContext *ctx, UIRect rect);
+uint32_t countMismatches(UIContext *ctx, const float *points, uint32_t count);
+float randomCoord(float max);
+double timeNow(void);
+
+int main(int argc, char **argv) {
+    uint32_t panels = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+    uint32_t rows = argc > 2 ? (uint32_t)atoi(argv[2]) : 50;
+    uint32_t cols = argc > 3 ? (uint32_t)atoi(argv[3]) : 50;
+    uint32_t queries = argc > 4 ? (uint32_t)atoi(argv[4]) : 100000;
+
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&context, 0);
+    if (!generateDashboard(context.root, panels, rows, cols)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        return 1;
+    }
+    UIContext_UpdateWindow(&context, 1280, 720);
+    if (!UIContext_Draw(&context))
+        return 1;
+
+    float *points = malloc(sizeof(float) * 2 * queries);
+    if (points == NULL)
+        return 1;
+    srand(1);
+    for (uint32_t i = 0; i < queries; i++) {
+        points[2 * i] = randomCoord(1280);
+        points[2 * i + 1] = randomCoord(720);
+    }
+
+    // The first query builds the grid
+    double start = timeNow();
+    UI_HitTest(&context, 0, 0);
+    double buildTime = timeNow() - start;
+
+    start = timeNow();
+    uintptr_t checksum = 0;
+    for (uint32_t i = 0; i < queries; i++)
+        checksum += (uintptr_t)UI_HitTest(&context, points[2 * i], points[2 * i + 1]);
+    double gridTime = timeNow() - start;
+
+    // The walk is much slower, it answers fewer queries
+    uint32_t bruteQueries = queries / 100 + 1;
+    start = timeNow();
+    for (uint32_t i = 0; i < bruteQueries; i++)
+        checksum += (uintptr_t)bruteHitTest(&context, points[2 * i], points[2 * i + 1]);
+    double bruteTime = timeNow() - start;
+
+    uint32_t mismatches = countMismatches(&context, points, bruteQueries);
+    printf("%u elements, grid built in %.3f ms (checksum %u)\n", context._tree.len, buildTime * 1e3, (unsigned)(checksum & 0xff));
+    printf("grid   %12.0f queries/s\n", queries / gridTime);
+    printf("walk   %12.0f queries/s\n", bruteQueries / bruteTime);
+    printf("%u mismatches\n", mismatches);
+
+    // Only the rows of the scrolled panel move to other cells
+    UIElement *panel = UIElement_Child(context.root, panels > 1 ? 1 : 0);
+    const uint32_t frames = 20;
+    double frameTime = 0;
+    double queryTime = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+        UI_Scroll(panel, 0.0f, (float)(rows * 20) / 2.0f + (float)(f % 4) * 7.0f);
+        start = timeNow();
+        if (!UIContext_Draw(&context))
+            return 1;
+        double drawEnd = timeNow();
+        checksum += (uintptr_t)UI_HitTest(&context, points[2 * f], points[2 * f + 1]);
+        frameTime += drawEnd - start;
+        queryTime += timeNow() - drawEnd;
+    }
+    uint32_t scrollMismatches = countMismatches(&context, points, bruteQueries);
+    printf(
+        "scrolled panel  frame %.3f ms  first query %.3f ms  %u mismatches\n",
+        frameTime / frames * 1e3, queryTime / frames * 1e3, scrollMismatches);
+    mismatches += scrollMismatches;
+
+    // The rows of the rebuilt tree are fewer than the entries of the grid
+    while (context.root->children.len > panels - panels / 2)
+        UIElement_Destroy(context.root->children.data[context.root->children.len - 1]);
+    if (UIContext_SnapshotSize(&context, false) == 0)
+        return 1;
+    UI_HitTest(&context, 0, 0);
+    uint32_t snapshotMismatches = countMismatches(&context, points, bruteQueries);
+    printf("%u mismatches after a snapshot of %u elements\n", snapshotMismatches, context._tree.len);
+    mismatches += snapshotMismatches;
+
+    free(points);
+    UIContext_Destroy(&context);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// The last element drawn whose box contains the point inside its clip
+UIElement *bruteHitTest(UIContext *ctx, float x, float y) {
+    UI__Tree *tree = &ctx->_tree;
+    UIElement *hit = NULL;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        uint32_t handle = tree->drawOrder[i];
+        UIRect rect = UI__RectIntersect(tree->boxes[handle], tree->clips[handle]);
+        if (x >= rect.x && x < rect.x + rect.w && y >= rect.y && y < rect.y + rect.h)
+            hit = tree->elements[handle];
+    }
+    return hit;
+}
+
+// Compare the grid with the walk on `count` points and rectangles around them,
+// the grid must be built before the walk reads the clips
+uint32_t countMismatches(UIContext *ctx, const float *points, uint32_t count) {
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        float x = points[2 * i], y = points[2 * i + 1];
+        if (UI_HitTest(ctx, x, y) != bruteHitTest(ctx, x, y))
+            mismatches++;
+        UIRect rect = { x - 20, y - 20, 40, 40 };
+        if (UI_QueryRect(ctx, rect, NULL, 0) != bruteQueryRect(ctx, rect))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+uint32_t bruteQueryRect(UIContext *ctx, UIRect rect) {
+    UI__Tree *tree = &ctx->_tree;
+    uint32_t count = 0;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UIRect visible = UI__RectIntersect(tree->boxes[i], tree->clips[i]);
+        count += visible.w > 0 && visible.h > 0 && UI__RectOverlaps(visible, rect);
+    }
+    return count;
+}
+
+float randomCoord(float max) {
+    return (float)rand() / (float)RAND_MAX * max;
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+bool generateDashboard(UIElement *root, uint32_t panels, uint32_t rows, uint32_t cols) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UI_LayoutDirection(root, UILayoutDirection_leftToRight);
+    UI_ChildGap(root, 2.0f);
+    for (uint32_t p = 0; p < panels; p++) {
+        UIElement *panel = UIElement_New(root);
+        if (panel == NULL)
+            return false;
+        UI_FillWidth(panel, (float)(1 + p % 3));
+        UI_FillHeight(panel, 1.0f);
+        UI_Padding(panel, 2.0f);
+        // Odd panels show the middle of rows taller than the window
+        if (p % 2 == 1) {
+            UI_ClipChildren(panel, true);
+            UI_Scroll(panel, 0.0f, (float)(rows * 20) / 2.0f);
+        }
+        for (uint32_t r = 0; r < rows; r++) {
+            UIElement *row = UIElement_New(panel);
+            if (row == NULL)
+                return false;
+            UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+            UI_FillWidth(row, 1.0f);
+            if (p % 2 == 1)
+                UI_FixedHeight(row, 20.0f);
+            else
+                UI_FillHeight(row, 1.0f);
+            UI_ChildGap(row, 1.0f);
+            UI_BackgroundColor(row, (UIColor) { 0, 0, 0, 0 });
+            for (uint32_t c = 0; c < cols; c++) {
+                UIElement *cell = UIElement_New(row);
+                if (cell == NULL)
+                    return false;
+                UI_BackgroundColor(cell, colors[(r + c) % 4]);
+                UI_FillWidth(cell, (float)(1 + c % 2));
+                UI_FillHeight(cell, 1.0f);
+                UI_MaxWidth(cell, 40.0f);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,9 @@
+#! /usr/bin/sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_hit.c $FLAGS -o build/bench_hit && ./build/bench_hit "$@"
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Measures the layout and the draw list of the library with the null backend.
+// Usage: bench_layout [elements] [frames] [csv]
+// Every shape has about `elements` elements:
+// - `deep` nests the elements inside each other
+// - `wide` lays out siblings in rows of 20000
+// - `fill` fills rows of 100 cells, most of them clamped by a minimum or a maximum
+// - `mixed` is a tree of four children per element with every direction,
+//   alignment and sizing
+// - `list` is a clipped panel with rows 20 pixels high, most of them outside the window
+// - `virtual` is the same list as a virtual list, only the rows in the window exist
+// - `text` is two columns of wrapped paragraphs, one of a fixed width and one
+//   filling the window, only the second one is wrapped again on resize
+// With `csv` the results are printed as comma separated values, one shape per line.
+// Rows of wrapped paragraphs of different widths are then checked to be as
+// tall as their tallest paragraph, before and after the tree is rebuilt and a
+// paragraph is changed, centered children are checked to be in the middle
+// of their parent for every direction, and the lines of a few hundred
+// paragraphs are checked to be kept by the context after they are drawn.
+
+typedef struct Shape {
+    const char *name;
+    bool (*generate)(UIElement *root, uint32_t count);
+} Shape;
+
+typedef struct ShapeResult {
+    uint32_t elements;
+    double buildTime;
+    double firstTime;
+    double changeTime;
+    double resizeTime;
+    double redrawTime;
+    double passTimes[4]; // Fit, fill, position and clipping with the draw list of a full layout, per element
+    uint64_t allocs;
+    uint64_t bytes;
+} ShapeResult;
+
+bool generateDeep(UIElement *root, uint32_t count);
+bool generateWide(UIElement *root, uint32_t count);
+bool generateFill(UIElement *root, uint32_t count);
+bool generateMixed(UIElement *root, uint32_t count);
+bool generateList(UIElement *root, uint32_t count);
+bool generateVirtual(UIElement *root, uint32_t count);
+bool generateText(UIElement *root, uint32_t count);
+void fillVirtualRow(UIElement *row, uint32_t index, void *userData);
+bool checkWrappedRows(void);
+bool checkCentered(void);
+bool checkTextCache(void);
+uint32_t countShortRows(UIContext *ctx, uint32_t rowCount);
+ShapeResult benchShape(const Shape *shape, uint32_t count, uint32_t frames);
+void benchPasses(UIContext *context, uint32_t frames, ShapeResult *result);
+double timeNow(void);
+
+int main(int argc, char **argv) {
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    uint32_t frames = argc > 2 ? (uint32_t)atoi(argv[2]) : 50;
+    bool csv = argc > 3 && strcmp(argv[3], "csv") == 0;
+
+    const Shape shapes[] = {
+        { "deep", generateDeep },
+        { "wide", generateWide },
+        { "fill", generateFill },
+        { "mixed", generateMixed },
+        { "list", generateList },
+        { "virtual", generateVirtual },
+        { "text", generateText }
+    };
+    if (csv) {
+        printf(
+            "shape,elements,build_ms,first_frame_ms,leaf_change_ms,resize_ms,redraw_ms,"
+            "fit_ns,fill_ns,position_ns,draw_ns,allocs,alloc_bytes\n");
+    }
+    for (uint32_t i = 0; i < sizeof(shapes) / sizeof(*shapes); i++) {
+        ShapeResult r = benchShape(&shapes[i], count, frames);
+        if (csv) {
+            printf(
+                "%s,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.3f,%llu,%llu\n",
+                shapes[i].name, r.elements,
+                r.buildTime * 1e3, r.firstTime * 1e3, r.changeTime * 1e3, r.resizeTime * 1e3, r.redrawTime * 1e3,
+                r.passTimes[0] * 1e9, r.passTimes[1] * 1e9, r.passTimes[2] * 1e9, r.passTimes[3] * 1e9,
+                (unsigned long long)r.allocs, (unsigned long long)r.bytes);
+            continue;
+        }
+        printf(
+            "%-5s %8u elements  build %9.3f ms  first frame %9.3f ms  leaf change %9.3f ms  resize %9.3f ms  redraw %9.3f ms\n",
+            shapes[i].name, r.elements,
+            r.buildTime * 1e3, r.firstTime * 1e3, r.changeTime * 1e3, r.resizeTime * 1e3, r.redrawTime * 1e3);
+        printf(
+            "      ns/element  fit %7.2f  fill %7.2f  position %7.2f  draw %7.2f    %llu allocations, %llu bytes\n",
+            r.passTimes[0] * 1e9, r.passTimes[1] * 1e9, r.passTimes[2] * 1e9, r.passTimes[3] * 1e9,
+            (unsigned long long)r.allocs, (unsigned long long)r.bytes);
+    }
+    bool wrapped = checkWrappedRows();
+    bool centered = checkCentered();
+    bool cached = checkTextCache();
+    return wrapped && centered && cached ? 0 : 1;
+}
+
+ShapeResult benchShape(const Shape *shape, uint32_t count, uint32_t frames) {
+    ShapeResult result;
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    UINullMemStats memStart = UINull_memStats;
+    if (!UIContext_Init(&context, (void *)&backend))
+        exit(1);
+    UIContext_SetMaxElements(&context, 0);
+
+    double start = timeNow();
+    if (!shape->generate(context.root, count)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        exit(1);
+    }
+    result.buildTime = timeNow() - start;
+
+    // The first frame numbers the tree and lays out every element
+    UIContext_UpdateWindow(&context, 1280, 720);
+    start = timeNow();
+    if (!UIContext_Draw(&context))
+        exit(1);
+    result.firstTime = timeNow() - start;
+    result.elements = context._tree.len;
+    result.allocs = UINull_memStats.allocs + UINull_memStats.expands - memStart.allocs - memStart.expands;
+    result.bytes = UINull_memStats.bytes - memStart.bytes;
+
+    // Changing the deepest or last element lays out only its ancestors
+    UIElement *leaf = context.root;
+    while (leaf->children.len != 0)
+        leaf = leaf->children.data[leaf->children.len - 1];
+    start = timeNow();
+    for (uint32_t f = 0; f < frames; f++) {
+        UI_Padding(leaf, (float)(f % 2));
+        if (!UIContext_Draw(&context))
+            exit(1);
+    }
+    result.changeTime = (timeNow() - start) / frames;
+
+    // The window size changes the box of every element
+    start = timeNow();
+    for (uint32_t f = 0; f < frames; f++) {
+        UIContext_UpdateWindow(&context, 1280 + f % 2, 720);
+        if (!UIContext_Draw(&context))
+            exit(1);
+    }
+    result.resizeTime = (timeNow() - start) / frames;
+
+    // Only the draw list is built again
+    start = timeNow();
+    for (uint32_t f = 0; f < frames; f++) {
+        UIContext_ForceRedraw(&context);
+        if (!UIContext_Draw(&context))
+            exit(1);
+    }
+    result.redrawTime = (timeNow() - start) / frames;
+
+    benchPasses(&context, frames, &result);
+    UIContext_Destroy(&context);
+    return result;
+}
+
+// Time each pass over the whole tree, as if every element had changed
+void benchPasses(UIContext *context, uint32_t frames, ShapeResult *result) {
+    UI__Tree *tree = &context->_tree;
+    double times[4] = { 0, 0, 0, 0 };
+    for (uint32_t f = 0; f < frames; f++) {
+        memset(tree->dirty, true, tree->len);
+        double start = timeNow();
+        UI__TreeFitWidths(tree);
+        double fitEnd = timeNow();
+        UI__TreeFillWidths(tree);
+        double fillEnd = timeNow();
+        // Breaking the lines of wrapped text counts as fitting
+        if (context->_hasWrappedText && !UI__ContextWrapText(context))
+            exit(1);
+        UI__TreeFitHeights(tree);
+        double fitHeightEnd = timeNow();
+        UI__TreeFillHeights(tree);
+        double fillHeightEnd = timeNow();
+        UI__TreePosition(tree);
+        double positionEnd = timeNow();
+        UIRect window = { 0, 0, (float)context->window.w, (float)context->window.h };
+        UI__TreeClip(tree, window);
+        context->drawList.len = 0;
+        if (!UI__TreeDraw(context))
+            exit(1);
+        double drawEnd = timeNow();
+        times[0] += fitEnd - start + fitHeightEnd - fillEnd;
+        times[1] += fillEnd - fitEnd + fillHeightEnd - fitHeightEnd;
+        times[2] += positionEnd - fillHeightEnd;
+        times[3] += drawEnd - positionEnd;
+    }
+    for (uint32_t i = 0; i < 4; i++)
+        result->passTimes[i] = times[i] / frames / tree->len;
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+bool generateDeep(UIElement *root, uint32_t count) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UIElement *parent = root;
+    for (uint32_t i = 0; i < count; i++) {
+        UIElement *element = UIElement_New(parent);
+        if (element == NULL)
+            return false;
+        UI_BackgroundColor(element, colors[i % 4]);
+        UI_FillWidth(element, 1.0f);
+        UI_FillHeight(element, 1.0f);
+        UI_Padding(element, (float)(i % 2));
+        parent = element;
+    }
+    return true;
+}
+
+bool generateWide(UIElement *root, uint32_t count) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    // An element cannot hold more than 32768 children, the elements are split in rows
+    const uint32_t rowLength = 20000;
+    UIElement *row = NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % rowLength == 0) {
+            row = UIElement_New(root);
+            if (row == NULL)
+                return false;
+            UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+            UI_FillWidth(row, 1.0f);
+            UI_FillHeight(row, 1.0f);
+        }
+        UIElement *element = UIElement_New(row);
+        if (element == NULL)
+            return false;
+        UI_BackgroundColor(element, colors[i % 4]);
+        UI_FillWidth(element, 1.0f);
+        UI_FillHeight(element, 1.0f);
+    }
+    return true;
+}
+
+bool generateFill(UIElement *root, uint32_t count) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    const uint32_t rowLength = 100;
+    UIElement *row = NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % rowLength == 0) {
+            row = UIElement_New(root);
+            if (row == NULL)
+                return false;
+            UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+            UI_FillWidth(row, 1.0f);
+            UI_FillHeight(row, 1.0f);
+            UI_ChildGap(row, 1.0f);
+        }
+        UIElement *element = UIElement_New(row);
+        if (element == NULL)
+            return false;
+        UI_BackgroundColor(element, colors[i % 4]);
+        // A row is about 12 pixels per cell, the weights push some cells
+        // below their minimum and others above their maximum
+        UI_FillWidth(element, (float)(1 + i % 5));
+        UI_FillHeight(element, 1.0f);
+        if (i % 3 == 0)
+            UI_MinWidth(element, (float)(6 + i % 7));
+        if (i % 4 == 1)
+            UI_MaxWidth(element, (float)(4 + i % 9));
+        UI_MaxHeight(element, (float)(20 + i % 30));
+    }
+    return true;
+}
+
+bool generateMixed(UIElement *root, uint32_t count) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UIAlignX alignX[] = { UIAlignX_left, UIAlignX_center, UIAlignX_right };
+    UIAlignY alignY[] = { UIAlignY_top, UIAlignY_center, UIAlignY_bottom };
+    // Element `i` is a child of element `(i - 1) / 4`, the root is element 0
+    UIElement **elements = malloc(sizeof(UIElement *) * (count + 1));
+    if (elements == NULL)
+        return false;
+    elements[0] = root;
+    for (uint32_t i = 1; i <= count; i++) {
+        UIElement *element = UIElement_New(elements[(i - 1) / 4]);
+        if (element == NULL) {
+            free(elements);
+            return false;
+        }
+        elements[i] = element;
+        UI_BackgroundColor(element, colors[i % 4]);
+        UI_LayoutDirection(element, i % 2 == 0 ? UILayoutDirection_leftToRight : UILayoutDirection_topToBottom);
+        UI_AlignX(element, alignX[i % 3]);
+        UI_AlignY(element, alignY[i / 3 % 3]);
+        UI_Padding(element, 1.0f);
+        UI_ChildGap(element, (float)(i % 3));
+        switch (i % 3) {
+        case 0:
+            UI_FixedWidth(element, 8.0f);
+            UI_FixedHeight(element, 6.0f);
+            break;
+        case 1:
+            UI_FitWidth(element);
+            UI_FitHeight(element);
+            break;
+        default:
+            UI_FillWidth(element, 1.0f);
+            UI_FillHeight(element, 1.0f);
+            UI_MinWidth(element, 2.0f);
+            break;
+        }
+    }
+    free(elements);
+    return true;
+}
+
+bool generateList(UIElement *root, uint32_t count) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UIElement *panel = UIElement_New(root);
+    if (panel == NULL)
+        return false;
+    UI_FillWidth(panel, 1.0f);
+    UI_FillHeight(panel, 1.0f);
+    UI_Padding(panel, 4.0f);
+    UI_ClipChildren(panel, true);
+    // Groups of rows are skipped as a whole when they are outside the panel
+    const uint32_t groupLength = 100;
+    UIElement *group = NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % groupLength == 0) {
+            group = UIElement_New(panel);
+            if (group == NULL)
+                return false;
+            UI_FillWidth(group, 1.0f);
+            UI_FitHeight(group);
+            UI_BackgroundColor(group, (UIColor) { 0, 0, 0, 0 });
+        }
+        UIElement *row = UIElement_New(group);
+        if (row == NULL)
+            return false;
+        UI_BackgroundColor(row, colors[i % 4]);
+        UI_FillWidth(row, 1.0f);
+        UI_FixedHeight(row, 20.0f);
+    }
+    return true;
+}
+
+bool generateVirtual(UIElement *root, uint32_t count) {
+    UIElement *panel = UIElement_New(root);
+    if (panel == NULL)
+        return false;
+    UI_FillWidth(panel, 1.0f);
+    UI_FillHeight(panel, 1.0f);
+    UI_Padding(panel, 4.0f);
+    return UI_VirtualList(panel, count, 20.0f, fillVirtualRow, NULL);
+}
+
+bool generateText(UIElement *root, uint32_t count) {
+    const char *paragraphs[] = {
+        "A single-header UI library written in C, with a layout made of a fit pass, a fill pass and a position pass.",
+        "Short paragraph.",
+        "Wrapped text is broken at spaces to fit the width of its element, and words wider than a line are broken anywhere.",
+        "The lines of a text are kept for each width, so a window that goes back to a previous size finds them again.",
+        "Every paragraph of the fixed column keeps its width when the window is resized, so its lines are never broken again."
+    };
+    UI_LayoutDirection(root, UILayoutDirection_leftToRight);
+    UIElement *columns[2];
+    for (uint32_t c = 0; c < 2; c++) {
+        columns[c] = UIElement_New(root);
+        if (columns[c] == NULL)
+            return false;
+        UI_ChildGap(columns[c], 4.0f);
+        UI_Padding(columns[c], 4.0f);
+    }
+    UI_FixedWidth(columns[0], 300.0f);
+    UI_FillWidth(columns[1], 1.0f);
+    for (uint32_t i = 0; i < count; i++) {
+        UIElement *paragraph = UIElement_New(columns[i % 2]);
+        if (paragraph == NULL)
+            return false;
+        UI_FillWidth(paragraph, 1.0f);
+        UI_TextWrap(paragraph, true);
+        UI_Text(paragraph, paragraphs[i / 2 % 5], 0, UI_BLACK);
+    }
+    return true;
+}
+
+// The height of a row comes from the heights of its paragraphs, which come
+// from their widths
+bool checkWrappedRows(void) {
+    const char *paragraphs[] = {
+        "A paragraph long enough to be broken into several lines in a narrow column.",
+        "Short.",
+        "The heights of a row and of its paragraphs do not depend on their widths."
+    };
+    const float widths[] = { 120.0f, 200.0f, 64.0f };
+    const uint32_t rowCount = 100;
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return false;
+    UIContext_UpdateWindow(&context, 1280, 720);
+    for (uint32_t r = 0; r < rowCount; r++) {
+        UIElement *row = UIElement_New(context.root);
+        if (row == NULL)
+            return false;
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+        UI_Padding(row, 4.0f);
+        for (uint32_t i = 0; i < 3; i++) {
+            UIElement *paragraph = UIElement_New(row);
+            if (paragraph == NULL)
+                return false;
+            UI_FixedWidth(paragraph, widths[(r + i) % 3]);
+            UI_TextWrap(paragraph, true);
+            UI_Text(paragraph, paragraphs[i], 0, UI_BLACK);
+        }
+    }
+    if (!UIContext_Draw(&context))
+        return false;
+    uint32_t shortRows = countShortRows(&context, rowCount);
+
+    // The rebuilt rows and the changed paragraph keep the height of their lines
+    UIElement *first = context.root->children.data[0]->children.data[0];
+    UIRect box = UIElement_Box(first);
+    if (UIElement_New(context.root) == NULL)
+        return false;
+    UI_ChildGap(first, 2.0f);
+    if (!UIContext_Draw(&context))
+        return false;
+    UIRect rebuiltBox = UIElement_Box(first);
+    shortRows += countShortRows(&context, rowCount);
+    bool same = box.h == rebuiltBox.h;
+    printf("wrapped rows  %u too short  %s after a rebuild\n", shortRows, same ? "same" : "DIFFERENT");
+    UIContext_Destroy(&context);
+    return shortRows == 0 && same;
+}
+
+// Two children and their gap are centered inside the padding of a parent
+// bigger than them
+bool checkCentered(void) {
+    const UILayoutDirection directions[] = {
+        UILayoutDirection_leftToRight, UILayoutDirection_rightToLeft,
+        UILayoutDirection_topToBottom, UILayoutDirection_bottomToTop
+    };
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return false;
+    UIContext_UpdateWindow(&context, 1280, 720);
+    UIElement *parents[4];
+    for (uint32_t d = 0; d < 4; d++) {
+        UIElement *parent = UIElement_New(context.root);
+        if (parent == NULL)
+            return false;
+        UI_LayoutDirection(parent, directions[d]);
+        UI_FixedWidth(parent, 300.0f);
+        UI_FixedHeight(parent, 200.0f);
+        UI_Padding(parent, 10.0f);
+        UI_ChildGap(parent, 10.0f);
+        UI_AlignX(parent, UIAlignX_center);
+        UI_AlignY(parent, UIAlignY_center);
+        for (uint32_t i = 0; i < 2; i++) {
+            UIElement *child = UIElement_New(parent);
+            if (child == NULL)
+                return false;
+            UI_FixedWidth(child, 40.0f);
+            UI_FixedHeight(child, 30.0f);
+        }
+        parents[d] = parent;
+    }
+    if (!UIContext_Draw(&context))
+        return false;
+
+    uint32_t offCenter = 0;
+    for (uint32_t d = 0; d < 4; d++) {
+        UIRect box = UIElement_Box(parents[d]);
+        UIRect a = UIElement_Box(parents[d]->children.data[0]);
+        UIRect b = UIElement_Box(parents[d]->children.data[1]);
+        float left = UI_fmin2(a.x, b.x);
+        float right = UI_fmax2(a.x + a.w, b.x + b.w);
+        float top = UI_fmin2(a.y, b.y);
+        float bottom = UI_fmax2(a.y + a.h, b.y + b.h);
+        offCenter += left - box.x != box.x + box.w - right || top - box.y != box.y + box.h - bottom;
+    }
+    printf("centered      %u of 4 directions off center\n", offCenter);
+    UIContext_Destroy(&context);
+    return offCenter == 0;
+}
+
+// Fewer paragraphs than the cache holds are not broken again when they are
+// drawn, whatever their hashes
+bool checkTextCache(void) {
+    enum { paragraphCount = UI_TEXT_CACHE_SIZE * 2 / 5 };
+    static char paragraphs[paragraphCount][48];
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return false;
+    UIContext_UpdateWindow(&context, 1280, 720);
+    for (uint32_t i = 0; i < paragraphCount; i++) {
+        UIElement *paragraph = UIElement_New(context.root);
+        if (paragraph == NULL)
+            return false;
+        snprintf(paragraphs[i], sizeof(paragraphs[i]), "Paragraph %u of the text cache check", i);
+        UI_FixedWidth(paragraph, 60.0f + (float)(i % 7) * 10.0f);
+        UI_TextWrap(paragraph, true);
+        UI_Text(paragraph, paragraphs[i], 0, UI_BLACK);
+    }
+    if (!UIContext_Draw(&context))
+        return false;
+    UIContext_ForceRedraw(&context);
+    if (!UIContext_Draw(&context))
+        return false;
+
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < paragraphCount; i++) {
+        bool found = false;
+        for (uint32_t j = 0; j < UI_TEXT_CACHE_SIZE && !found; j++)
+            found = context._textCache.layouts[j].str == paragraphs[i];
+        missing += !found;
+    }
+    printf("text cache    %u of %u paragraphs not kept after a draw\n", missing, (uint32_t)paragraphCount);
+    UIContext_Destroy(&context);
+    return missing == 0;
+}
+
+uint32_t countShortRows(UIContext *ctx, uint32_t rowCount) {
+    uint32_t shortRows = 0;
+    for (uint32_t r = 0; r < rowCount; r++) {
+        UIElement *row = ctx->root->children.data[r];
+        float h = 0;
+        for (uint32_t i = 0; i < row->children.len; i++)
+            h = UI_fmax2(h, UIElement_Box(row->children.data[i]).h);
+        shortRows += UIElement_Box(row).h != h + 8.0f;
+    }
+    return shortRows;
+}
+
+void fillVirtualRow(UIElement *row, uint32_t index, void *userData) {
+    (void)userData;
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UI_BackgroundColor(row, colors[index % 4]);
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "SDL3/SDL.h"
+
+#define UI_THREADS
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "SDL3_impl.c"
+
+// Compares the serial layout with the parallel one on a dashboard of `panels`
+// panels, each with `rows * cols` cells, and checks that the boxes match.
+// Usage: bench_parallel [panels] [rows] [cols] [frames]
+// The draw list goes to the software renderer on a surface and is never flushed.
+
+bool generateDashboard(UIElement *root, uint32_t panels, uint32_t rows, uint32_t cols);
+double benchLayout(UIContext *context, uint32_t frames);
+void logErrorAndExit(void);
+
+int main(int argc, char **argv) {
+    uint32_t panels = argc > 1 ? (uint32_t)atoi(argv[1]) : 40;
+    uint32_t rows = argc > 2 ? (uint32_t)atoi(argv[2]) : 50;
+    uint32_t cols = argc > 3 ? (uint32_t)atoi(argv[3]) : 100;
+    uint32_t frames = argc > 4 ? (uint32_t)atoi(argv[4]) : 50;
+
+    if (!SDL_Init(0))
+        logErrorAndExit();
+    SDL_Surface *surface = SDL_CreateSurface(1280, 720, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) logErrorAndExit();
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+    if (renderer == NULL) logErrorAndExit();
+
+    UISDL3Backend backend;
+    UISDL3Backend_Init(&backend, renderer);
+
+    UIContext context;
+    if (!UIContext_Init(&context, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&context, 0);
+    if (!generateDashboard(context.root, panels, rows, cols)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+        return 1;
+    }
+    UIContext_UpdateWindow(&context, 1280, 720);
+    if (!UIContext_Draw(&context))
+        logErrorAndExit();
+
+    uint32_t len = context._tree.len;
+    double serialTime = benchLayout(&context, frames);
+    UIRect *serialBoxes = malloc(sizeof(UIRect) * len);
+    if (serialBoxes == NULL)
+        return 1;
+    memcpy(serialBoxes, context._tree.boxes, sizeof(UIRect) * len);
+
+    printf("%u elements, %u frames, %d logical cores\n", len, frames, SDL_GetNumLogicalCPUCores());
+    printf("serial              %9.3f ms\n", serialTime * 1e3);
+
+    // Each panel is a task, the rows of the dashboard are split as well
+    UIContext_SetParallelLayout(&context, cols + 1);
+    uint32_t threadCounts[] = { 1, 2, 4, 8 };
+    bool matches = true;
+    for (uint32_t t = 0; t < sizeof(threadCounts) / sizeof(*threadCounts); t++) {
+        if (!UISDL3Backend_StartWorkers(&backend, threadCounts[t] - 1))
+            logErrorAndExit();
+        double time = benchLayout(&context, frames);
+        bool same = memcmp(serialBoxes, context._tree.boxes, sizeof(UIRect) * len) == 0;
+        matches &= same;
+        printf(
+            "%u thread%s           %9.3f ms  %5.2fx  (%s)\n",
+            threadCounts[t], threadCounts[t] == 1 ? " " : "s",
+            time * 1e3,
+            serialTime / time,
+            same ? "same boxes" : "DIFFERENT BOXES");
+    }
+
+    free(serialBoxes);
+    UIContext_Destroy(&context);
+    UISDL3Backend_Destroy(&backend);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroySurface(surface);
+    SDL_Quit();
+    return matches ? 0 : 1;
+}
+
+// Average time of a frame where the window size changes the box of every
+// element, the last frame uses a width of 1280
+double benchLayout(UIContext *context, uint32_t frames) {
+    Uint64 start = SDL_GetTicksNS();
+    for (uint32_t f = 0; f < frames; f++) {
+        UIContext_UpdateWindow(context, 1280 + (frames - f - 1) % 2, 720);
+        if (!UIContext_Draw(context))
+            logErrorAndExit();
+    }
+    return (double)(SDL_GetTicksNS() - start) / 1e9 / frames;
+}
+
+bool generateDashboard(UIElement *root, uint32_t panels, uint32_t rows, uint32_t cols) {
+    UIColor colors[] = { UI_RED, UI_GREEN, UI_BLUE, UI_WHITE };
+    UI_LayoutDirection(root, UILayoutDirection_leftToRight);
+    UI_ChildGap(root, 2.0f);
+    for (uint32_t p = 0; p < panels; p++) {
+        UIElement *panel = UIElement_New(root);
+        if (panel == NULL)
+            return false;
+        UI_FillWidth(panel, (float)(1 + p % 3));
+        UI_FillHeight(panel, 1.0f);
+        UI_Padding(panel, 2.0f);
+        for (uint32_t r = 0; r < rows; r++) {
+            UIElement *row = UIElement_New(panel);
+            if (row == NULL)
+                return false;
+            UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+            UI_FillWidth(row, 1.0f);
+            UI_FillHeight(row, 1.0f);
+            UI_ChildGap(row, 1.0f);
+            for (uint32_t c = 0; c < cols; c++) {
+                UIElement *cell = UIElement_New(row);
+                if (cell == NULL)
+                    return false;
+                UI_BackgroundColor(cell, colors[(r + c) % 4]);
+                UI_FillWidth(cell, (float)(1 + c % 2));
+                UI_FillHeight(cell, 1.0f);
+                UI_MaxWidth(cell, 40.0f);
+            }
+        }
+    }
+    return true;
+}
+
+void logErrorAndExit(void) {
+    fprintf(stderr, "SDL Error: %s\n", SDL_GetError());
+    exit(1);
+}
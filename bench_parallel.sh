@@ -0,0 +1,14 @@
+#! /usr/bin/sh
+
+sh SDL3/buildSDL.sh
+
+if [ ! -d build ]; then
+    mkdir build
+fi
+
+SDL_PATH="$(SDL3/SDLpath.sh)"
+INCLUDE=${SDL_PATH}/include
+LIB=${SDL_PATH}/lib
+FLAGS="-O2 -Wall -Wextra -Wpedantic"
+
+cc bench_parallel.c -I$INCLUDE -L$LIB -lSDL3 $FLAGS -o build/bench_parallel && export LD_LIBRARY_PATH=$LIB && ./build/bench_parallel "$@"
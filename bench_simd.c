@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+
+// Compares the SSE2 layout kernels with the scalar ones on a container with
+// 1000 to 100000 children and checks that the results match.
+// Usage: bench_simd [repetitions]
+// Each kernel goes `repetitions` times over 100000 children in total.
+
+#define TOLERANCE 1e-5
+
+void fillTree(UI__Tree *tree, uint32_t childCount);
+bool benchChildren(uint32_t childCount, uint32_t repetitions);
+double timeNow(void);
+float randomFloat(float max);
+
+void *UI_MemAlloc(uint32_t size) {
+    return malloc(size);
+}
+
+void *UI_MemExpand(void *block, uint32_t size) {
+    return realloc(block, size);
+}
+
+void *UI_MemShrink(void *block, uint32_t size) {
+    void *new_block = realloc(block, size);
+    return new_block == NULL ? block : new_block;
+}
+
+void UI_MemFree(void *block) {
+    free(block);
+}
+
+bool UI_DrawList(UIContext *ctx, const UIDrawList *list) {
+    (void)ctx;
+    (void)list;
+    return true;
+}
+
+bool UI_FontMetrics(UIContext *ctx, uint32_t font, UIFontMetrics *metrics) {
+    (void)ctx;
+    (void)font;
+    *metrics = (UIFontMetrics) { .ascent = 12.0f, .lineHeight = 16.0f };
+    return true;
+}
+
+bool UI_GlyphMetrics(UIContext *ctx, uint32_t font, uint32_t codepoint, UIGlyphMetrics *metrics) {
+    (void)ctx;
+    (void)font;
+    (void)codepoint;
+    *metrics = (UIGlyphMetrics) { .advance = 8.0f, .x = 0.0f, .y = 0.0f, .w = 0, .h = 0 };
+    return true;
+}
+
+bool UI_GlyphRasterize(UIContext *ctx, uint32_t font, uint32_t codepoint, uint8_t *pixels, uint32_t pitch) {
+    (void)ctx;
+    (void)font;
+    (void)codepoint;
+    (void)pixels;
+    (void)pitch;
+    return true;
+}
+
+#ifdef UI_STATS
+
+uint64_t UI_TimeNs(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+#endif // !UI_STATS
+
+int main(int argc, char **argv) {
+    uint32_t repetitions = argc > 1 ? (uint32_t)atoi(argv[1]) : 200;
+
+#ifndef UI__SSE2
+    printf("The SSE2 kernels are not available for this target\n");
+    (void)repetitions;
+    return 0;
+#else
+    uint32_t childCounts[] = { 1000, 10000, 100000 };
+    bool matches = true;
+    for (uint32_t i = 0; i < sizeof(childCounts) / sizeof(*childCounts); i++)
+        matches &= benchChildren(childCounts[i], repetitions);
+    return matches ? 0 : 1;
+#endif
+}
+
+#ifdef UI__SSE2
+
+bool benchChildren(uint32_t childCount, uint32_t repetitions) {
+    UI__Tree tree = { .len = 0, .cap = 0, .elements = NULL };
+    if (!UI__TreeReserve(&tree, childCount + 1))
+        exit(1);
+    fillTree(&tree, childCount);
+    UI__AxisColumns columns = UI__TreeColumnsX(&tree, 0);
+    repetitions = repetitions * (100000 / childCount);
+    // The results are summed so that the calls are not removed
+    volatile float sink = 0;
+
+    double start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        sink += UI__ColumnsSumScalar(&columns, 2.0f, 3.0f, 1.5f);
+    double sumScalar = timeNow() - start;
+    start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        sink += UI__ColumnsSumSSE2(&columns, 2.0f, 3.0f, 1.5f);
+    double sumSSE2 = timeNow() - start;
+
+    start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        sink += UI__ColumnsMaxScalar(&columns, 2.0f, 3.0f);
+    double maxScalar = timeNow() - start;
+    start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        sink += UI__ColumnsMaxSSE2(&columns, 2.0f, 3.0f);
+    double maxSSE2 = timeNow() - start;
+
+    // Every child is a fill child
+    for (uint32_t i = 0; i < childCount; i++)
+        tree.scratch[i] = i + 1;
+    float *w = &tree.boxes[0].w;
+    float *weight = &tree.sizing[0].w_weight;
+    float *min = &tree.sizing[0].w_min;
+    float *max = &tree.sizing[0].w_max;
+    float space = childCount * 20.0f;
+
+    start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        UI__FillExpandScalar(w, weight, min, max, tree.scratch, childCount, space, childCount * 2.0f);
+    double fillScalar = timeNow() - start;
+    for (uint32_t i = 1; i <= childCount; i++)
+        tree.lastBoxes[i].w = tree.boxes[i].w;
+    start = timeNow();
+    for (uint32_t r = 0; r < repetitions; r++)
+        UI__FillExpandSSE2(w, weight, min, max, tree.scratch, childCount, space, childCount * 2.0f);
+    double fillSSE2 = timeNow() - start;
+    (void)sink;
+
+    float sumA = UI__ColumnsSumScalar(&columns, 2.0f, 3.0f, 1.5f);
+    float sumB = UI__ColumnsSumSSE2(&columns, 2.0f, 3.0f, 1.5f);
+    double sumError = fabs((double)sumA - sumB) / fabs((double)sumA);
+    bool maxExact = UI__ColumnsMaxScalar(&columns, 2.0f, 3.0f) == UI__ColumnsMaxSSE2(&columns, 2.0f, 3.0f);
+    bool fillExact = true;
+    for (uint32_t i = 1; i <= childCount; i++)
+        fillExact &= tree.lastBoxes[i].w == tree.boxes[i].w;
+
+    printf(
+        "%6u children  sum %6.2fx (error %.1e)  max %6.2fx (%s)  fill %6.2fx (%s)\n",
+        childCount,
+        sumScalar / sumSSE2, sumError,
+        maxScalar / maxSSE2, maxExact ? "exact" : "DIFFERENT",
+        fillScalar / fillSSE2, fillExact ? "exact" : "DIFFERENT");
+    UI_MemFree(tree.elements);
+    return sumError <= TOLERANCE && maxExact && fillExact;
+}
+
+#endif // !UI__SSE2
+
+// A root with `childCount` children with random sizes and margins
+void fillTree(UI__Tree *tree, uint32_t childCount) {
+    tree->len = childCount + 1;
+    tree->links[0] = (UI__Links) { .parent = UI__NO_HANDLE, .firstChild = 1, .childCount = childCount };
+    for (uint32_t i = 1; i <= childCount; i++) {
+        bool fill = rand() % 4 == 0;
+        tree->boxes[i] = (UIRect) { 0, 0, randomFloat(100), randomFloat(100) };
+        tree->sizing[i] = (UI__Sizing) {
+            .w_min = randomFloat(10),
+            .w_max = rand() % 2 == 0 ? 0 : 10 + randomFloat(30),
+            .w_weight = 1 + randomFloat(3),
+            .h_min = randomFloat(10),
+            .h_max = 0,
+            .h_weight = 1,
+            .w_sizing = fill ? UISizing_fill : UISizing_fixed,
+            .h_sizing = UISizing_fixed
+        };
+        tree->spacing[i] = (UI__Spacing) {
+            .padding = { 0, 0, 0, 0 },
+            .margin = { randomFloat(4), randomFloat(4), randomFloat(4), randomFloat(4) },
+            .childGap = 0
+        };
+        tree->links[i] = (UI__Links) { .parent = 0, .firstChild = childCount + 1, .childCount = 0 };
+    }
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+float randomFloat(float max) {
+    return (float)rand() / (float)RAND_MAX * max;
+}
@@ -0,0 +1,13 @@
+Set-Location $PSScriptRoot
+
+if (!(Test-Path build)) {
+    New-Item "build" -ItemType Directory
+}
+
+$Flags = @('-O2', '-Wall', '-Wextra', '-Wpedantic')
+
+clang.exe bench_simd.c $Flags -o build/bench_simd.exe
+
+if ($LASTEXITCODE -eq 0) {
+    .\build\bench_simd.exe @args
+}
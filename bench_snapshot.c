@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Builds a screen of rows with an icon, a title and a wrapped body, saves its
+// snapshot to `path` and loads it back into new contexts, mapping the file.
+// The first frame of each loaded context must draw the same commands as the
+// screen it was saved from.
+// Usage: bench_snapshot [elements] [path]
+// The path is build/bench_snapshot.bin by default.
+// - `boxes` loads the snapshot with the boxes of the layout, its first frame
+//   only draws
+// - `layout` loads a snapshot without boxes, its first frame lays out the tree
+// - `resize` resizes the window of the first loaded context and back, to check
+//   the layout of a tree whose boxes came from the snapshot
+// - `corrupt` gives a style of the snapshot an enum out of range, loading it
+//   must fail
+
+#define DEFAULT_PATH "build/bench_snapshot.bin"
+#define WINDOW_W 1280
+#define WINDOW_H 720
+
+typedef struct Mapping {
+    const void *data;
+    uint32_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int file;
+#endif
+} Mapping;
+
+bool buildScreen(UIContext *ctx, uint32_t rowCount);
+bool saveSnapshot(UIContext *ctx, const char *path);
+bool mapFile(Mapping *mapping, const char *path);
+void unmapFile(Mapping *mapping);
+bool loadContext(UIContext *ctx, UINullBackend *backend, const void *data, uint32_t size, double *loadTime, double *drawTime);
+bool sameCommands(const UIDrawCommand *commands, uint32_t count, const UIDrawList *list);
+uint32_t loadCorruptStyles(UINullBackend *backend, const void *data, uint32_t size);
+double timeNow(void);
+
+const char *titles[] = { "Inbox", "Builds", "Alerts", "Deploys", "Reviews" };
+const char *bodies[] = {
+    "The nightly build of the main branch passed every test on every platform.",
+    "Two reviewers asked for changes to the parser before it can be merged.",
+    "The disk of the log volume is almost full, old archives should be removed.",
+    "Version 2.4 is live in every region, the rollout took twelve minutes."
+};
+
+int main(int argc, char **argv) {
+    uint32_t elementCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    uint32_t rowCount = elementCount / 4;
+    const char *path = argc > 2 ? argv[2] : DEFAULT_PATH;
+
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    UIContext screen;
+    if (!UIContext_Init(&screen, (void *)&backend))
+        return 1;
+    UIContext_SetMaxElements(&screen, 0);
+    UIContext_UpdateWindow(&screen, WINDOW_W, WINDOW_H);
+
+    double start = timeNow();
+    if (!buildScreen(&screen, rowCount)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&screen));
+        return 1;
+    }
+    double buildTime = timeNow() - start;
+    start = timeNow();
+    if (!UIContext_Draw(&screen))
+        return 1;
+    double drawTime = timeNow() - start;
+    uint32_t commandCount = screen.drawList.len;
+    UIDrawCommand *commands = (UIDrawCommand *)malloc(sizeof(UIDrawCommand) * commandCount);
+    if (commands == NULL)
+        return 1;
+    memcpy(commands, screen.drawList.data, sizeof(UIDrawCommand) * commandCount);
+
+    start = timeNow();
+    if (!saveSnapshot(&screen, path))
+        return 1;
+    double saveTime = timeNow() - start;
+    uint32_t layoutSize = UIContext_SnapshotSize(&screen, false);
+    void *layoutSnapshot = malloc(layoutSize);
+    if (layoutSnapshot == NULL || !UIContext_WriteSnapshot(&screen, layoutSnapshot, layoutSize, false))
+        return 1;
+    printf(
+        "%u elements  build %8.3f ms  first frame %8.3f ms  save %8.3f ms  %u bytes\n",
+        screen._tree.len, buildTime * 1e3, drawTime * 1e3, saveTime * 1e3, UIContext_SnapshotSize(&screen, true));
+
+    start = timeNow();
+    Mapping mapping;
+    if (!mapFile(&mapping, path)) {
+        fprintf(stderr, "Cannot map %s\n", path);
+        return 1;
+    }
+    double mapTime = timeNow() - start;
+
+    bool same = true;
+    UIContext loaded;
+    double loadTime;
+    if (!loadContext(&loaded, &backend, mapping.data, mapping.size, &loadTime, &drawTime))
+        return 1;
+    bool match = sameCommands(commands, commandCount, &loaded.drawList);
+    same &= match;
+    printf(
+        "boxes   map %8.3f ms  load %8.3f ms  first frame %8.3f ms  (%s)\n",
+        mapTime * 1e3, loadTime * 1e3, drawTime * 1e3, match ? "same" : "DIFFERENT");
+
+    UIContext relaid;
+    if (!loadContext(&relaid, &backend, layoutSnapshot, layoutSize, &loadTime, &drawTime))
+        return 1;
+    match = sameCommands(commands, commandCount, &relaid.drawList);
+    same &= match;
+    printf("layout                load %8.3f ms  first frame %8.3f ms  (%s)\n", loadTime * 1e3, drawTime * 1e3, match ? "same" : "DIFFERENT");
+
+    UIContext_UpdateWindow(&loaded, WINDOW_W / 2, WINDOW_H);
+    UIContext_UpdateWindow(&screen, WINDOW_W / 2, WINDOW_H);
+    if (!UIContext_Draw(&loaded) || !UIContext_Draw(&screen))
+        return 1;
+    UIContext_UpdateWindow(&loaded, WINDOW_W, WINDOW_H);
+    UIContext_UpdateWindow(&screen, WINDOW_W, WINDOW_H);
+    if (!UIContext_Draw(&loaded) || !UIContext_Draw(&screen))
+        return 1;
+    match = sameCommands(screen.drawList.data, screen.drawList.len, &loaded.drawList);
+    same &= match;
+    printf("resize  %s\n", match ? "same" : "DIFFERENT");
+
+    uint32_t loadedCorrupt = loadCorruptStyles(&backend, layoutSnapshot, layoutSize);
+    same &= loadedCorrupt == 0;
+    printf("corrupt %u loaded\n", loadedCorrupt);
+
+    UIContext_Destroy(&loaded);
+    UIContext_Destroy(&relaid);
+    unmapFile(&mapping);
+    UIContext_Destroy(&screen);
+    free(layoutSnapshot);
+    free(commands);
+    return same ? 0 : 1;
+}
+
+bool buildScreen(UIContext *ctx, uint32_t rowCount) {
+    UIElement *list = UIElement_New(ctx->root);
+    if (list == NULL || !UIElement_ReserveChildren(list, rowCount))
+        return false;
+    UI_FillWidth(list, 1.0f);
+    UI_FillHeight(list, 1.0f);
+    UI_ClipChildren(list, true);
+    UI_ChildGap(list, 2.0f);
+    for (uint32_t i = 0; i < rowCount; i++) {
+        UIElement *row = UIElement_New(list);
+        UIElement *icon = row == NULL ? NULL : UIElement_New(row);
+        UIElement *title = icon == NULL ? NULL : UIElement_New(row);
+        UIElement *body = title == NULL ? NULL : UIElement_New(row);
+        if (body == NULL)
+            return false;
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+        UI_FillWidth(row, 1.0f);
+        UI_Padding(row, 4.0f);
+        UI_ChildGap(row, 8.0f);
+        UI_BackgroundColor(row, i % 2 == 0 ? UI_WHITE : (UIColor) { 230, 230, 240, 255 });
+        UI_FixedWidth(icon, 16.0f);
+        UI_FixedHeight(icon, 16.0f);
+        UI_BackgroundColor(icon, i % 3 == 0 ? UI_RED : UI_GREEN);
+        UI_FixedWidth(title, 80.0f);
+        UI_Text(title, titles[i % 5], 0, UI_BLACK);
+        UI_FillWidth(body, 1.0f);
+        UI_Text(body, bodies[i % 4], 0, UI_BLACK);
+        UI_TextWrap(body, true);
+    }
+    return true;
+}
+
+bool saveSnapshot(UIContext *ctx, const char *path) {
+    uint32_t size = UIContext_SnapshotSize(ctx, true);
+    void *buffer = malloc(size);
+    if (size == 0 || buffer == NULL || !UIContext_WriteSnapshot(ctx, buffer, size, true)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(ctx));
+        free(buffer);
+        return false;
+    }
+    FILE *file = fopen(path, "wb");
+    bool written = file != NULL && fwrite(buffer, 1, size, file) == size;
+    if (file != NULL)
+        written &= fclose(file) == 0;
+    if (!written)
+        fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+    free(buffer);
+    return written;
+}
+
+// Load the snapshot into a new context and draw its first frame
+bool loadContext(UIContext *ctx, UINullBackend *backend, const void *data, uint32_t size, double *loadTime, double *drawTime) {
+    double start = timeNow();
+    if (!UIContext_Init(ctx, (void *)backend))
+        return false;
+    UIContext_SetMaxElements(ctx, 0);
+    UIContext_UpdateWindow(ctx, WINDOW_W, WINDOW_H);
+    if (!UIContext_LoadSnapshot(ctx, data, size)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(ctx));
+        return false;
+    }
+    *loadTime = timeNow() - start;
+    start = timeNow();
+    if (!UIContext_Draw(ctx))
+        return false;
+    *drawTime = timeNow() - start;
+    return true;
+}
+
+// Put each field packed in the last word of the first style out of its range
+// and count the snapshots that load anyway
+uint32_t loadCorruptStyles(UINullBackend *backend, const void *data, uint32_t size) {
+    // Mask of each field and the value it is given
+    const uint32_t corruptions[][2] = {
+        { 7u, 4u }, // Direction
+        { 7u << 3, 3u << 3 }, // Horizontal alignment
+        { 7u << 6, 7u << 6 }, // Vertical alignment
+        { 0xffu << 9, 3u << 9 }, // Width sizing
+        { 0xffu << 17, 0xffu << 17 }, // Height sizing
+        { 0x7fu << 25, 1u << 25 } // Unused bits
+    };
+    uint32_t *copy = (uint32_t *)malloc(size);
+    if (copy == NULL)
+        return 1;
+    uint32_t loaded = 0;
+    for (uint32_t i = 0; i < sizeof(corruptions) / sizeof(*corruptions); i++) {
+        memcpy(copy, data, size);
+        uint32_t *packed = copy + sizeof(UI__SnapshotHeader) / sizeof(uint32_t) + 15;
+        *packed = (*packed & ~corruptions[i][0]) | corruptions[i][1];
+        UIContext ctx;
+        if (!UIContext_Init(&ctx, (void *)backend))
+            return 1;
+        UIContext_UpdateWindow(&ctx, WINDOW_W, WINDOW_H);
+        if (UIContext_LoadSnapshot(&ctx, copy, size) || UI_ErrorGetKind(&ctx) != UIErrorKind_invalidSnapshot)
+            loaded++;
+        UIContext_Destroy(&ctx);
+    }
+    free(copy);
+    return loaded;
+}
+
+bool sameCommands(const UIDrawCommand *commands, uint32_t count, const UIDrawList *list) {
+    return list->len == count && memcmp(commands, list->data, sizeof(UIDrawCommand) * count) == 0;
+}
+
+#ifdef _WIN32
+
+bool mapFile(Mapping *mapping, const char *path) {
+    mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE)
+        return false;
+    mapping->size = GetFileSize(mapping->file, NULL);
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping->mapping == NULL)
+        return false;
+    mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_READ, 0, 0, 0);
+    return mapping->data != NULL;
+}
+
+void unmapFile(Mapping *mapping) {
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(mapping->mapping);
+    CloseHandle(mapping->file);
+}
+
+#else
+
+bool mapFile(Mapping *mapping, const char *path) {
+    mapping->file = open(path, O_RDONLY);
+    struct stat info;
+    if (mapping->file < 0 || fstat(mapping->file, &info) != 0)
+        return false;
+    mapping->size = (uint32_t)info.st_size;
+    void *data = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, mapping->file, 0);
+    mapping->data = data == MAP_FAILED ? NULL : data;
+    return mapping->data != NULL;
+}
+
+void unmapFile(Mapping *mapping) {
+    munmap((void *)mapping->data, mapping->size);
+    close(mapping->file);
+}
+
+#endif
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
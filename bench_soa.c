@@ -0,0 +1,570 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Compares the fit and position passes on the arrays of the tree with the
+// same passes on elements that each have their own allocation and point to
+// their children, the way the layout ran before the tree. Both run the same
+// algorithm: the children of fill elements count with their minimum, the
+// children are aligned and can be reversed, the fit pass keeps the size of
+// the children along the layout direction for the position pass, and the
+// position pass compares each box with the last layout and clears the dirty
+// flags. The elements are allocated in the order they are created, then in a
+// shuffled order like in a heap that has seen other allocations. Every way
+// must give the same boxes.
+// Usage: bench_soa [repetitions]
+// Each tree is a row of panels of 20 rows of 10 square cells, with about 50000
+// and 200000 elements. Every element is marked dirty before each layout,
+// outside the measured time. The cache misses are read from the hardware
+// counters of Linux when the kernel gives access to them.
+
+#define PANEL_ROWS 20
+#define ROW_CELLS 10
+
+// The fields of an element before the tree, each element has its own block.
+// `childExtent`, `scroll` and `content` are the fields the tree passes added.
+typedef struct Element {
+    UIRect box;
+    UILayout layout;
+    UIColor backgroundColor;
+    float scrollX, scrollY;
+    float contentW, contentH;
+    struct Element *parent;
+    void *context;
+    struct {
+        struct Element **data;
+        uint32_t len, cap;
+    } children;
+    UIRect lastBox; // Box at the end of the last layout
+    float childExtent; // Size of the children along the layout direction, set by the fit pass
+    bool dirty; // Set when the element or any of its descendants changed
+} Element;
+
+typedef struct Counter {
+    int fd; // Negative when the cache misses cannot be counted
+} Counter;
+
+bool buildTree(UIContext *ctx, uint32_t elementCount);
+Element **copyElements(UIContext *ctx, bool shuffled);
+bool copyElement(UIElement *element, Element *parent, Element **blocks, Element **order, uint32_t *next);
+void freeElements(Element **blocks, uint32_t count);
+void elementMarkDirty(Element *element);
+void elementFit(Element *element);
+void elementFitWidth(Element *element);
+void elementFitHeight(Element *element);
+void elementSetW(Element *element, float w);
+void elementSetH(Element *element, float h);
+float elementChildSum(Element *element, bool horizontal);
+float elementChildMax(Element *element, bool horizontal);
+void elementPosition(Element *element);
+void elementPositionX(Element *element);
+void elementPositionY(Element *element);
+void treeMarkDirty(UI__Tree *tree);
+void treeLayout(UI__Tree *tree);
+uint32_t countMismatches(UI__Tree *tree, Element **blocks);
+Counter counterOpen(void);
+uint64_t counterRead(Counter *counter);
+void counterClose(Counter *counter);
+double timeNow(void);
+
+int main(int argc, char **argv) {
+    uint32_t repetitions = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+    uint32_t elementCounts[] = { 50000, 200000 };
+    const char *names[] = { "elements", "shuffled", "arrays" };
+    Counter counter = counterOpen();
+    if (counter.fd < 0)
+        printf("The cache misses cannot be counted on this system\n");
+
+    bool same = true;
+    for (uint32_t c = 0; c < sizeof(elementCounts) / sizeof(*elementCounts); c++) {
+        UINullBackend backend;
+        UINullBackend_Init(&backend);
+        UIContext context;
+        if (!UIContext_Init(&context, (void *)&backend))
+            return 1;
+        UIContext_SetMaxElements(&context, 0);
+        UIContext_UpdateWindow(&context, 1280, 720);
+        if (!buildTree(&context, elementCounts[c]) || !UIContext_Draw(&context)) {
+            fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&context));
+            return 1;
+        }
+        UI__Tree *tree = &context._tree;
+        uint32_t n = tree->len;
+
+        for (uint32_t way = 0; way < 3; way++) {
+            Element **blocks = NULL;
+            if (way < 2 && (blocks = copyElements(&context, way == 1)) == NULL)
+                return 1;
+            double time = 0;
+            uint64_t misses = 0;
+            for (uint32_t r = 0; r < repetitions; r++) {
+                if (blocks != NULL)
+                    elementMarkDirty(blocks[0]);
+                else
+                    treeMarkDirty(tree);
+                uint64_t startMisses = counterRead(&counter);
+                double start = timeNow();
+                if (blocks != NULL) {
+                    elementFit(blocks[0]);
+                    elementPosition(blocks[0]);
+                } else
+                    treeLayout(tree);
+                time += timeNow() - start;
+                misses += counterRead(&counter) - startMisses;
+            }
+
+            uint32_t mismatches = blocks != NULL ? countMismatches(tree, blocks) : 0;
+            same &= mismatches == 0;
+            printf("%6u %-8s  %7.2f ns/element", n, names[way], time * 1e9 / ((double)n * repetitions));
+            if (counter.fd >= 0)
+                printf("  %6.3f cache misses/element", (double)misses / ((double)n * repetitions));
+            printf("  %u mismatches\n", mismatches);
+            if (blocks != NULL)
+                freeElements(blocks, n);
+        }
+        UIContext_Destroy(&context);
+    }
+    counterClose(&counter);
+    return same ? 0 : 1;
+}
+
+bool buildTree(UIContext *ctx, uint32_t elementCount) {
+    uint32_t panelCount = elementCount / (1 + PANEL_ROWS * (1 + ROW_CELLS));
+    UI_LayoutDirection(ctx->root, UILayoutDirection_leftToRight);
+    UI_ChildGap(ctx->root, 4.0f);
+    for (uint32_t p = 0; p < panelCount; p++) {
+        UIElement *panel = UIElement_New(ctx->root);
+        if (panel == NULL)
+            return false;
+        UI_Padding(panel, 4.0f);
+        UI_ChildGap(panel, 2.0f);
+        UI_AlignX(panel, p % 2 == 0 ? UIAlignX_left : UIAlignX_center);
+        for (uint32_t r = 0; r < PANEL_ROWS; r++) {
+            UIElement *row = UIElement_New(panel);
+            if (row == NULL)
+                return false;
+            UI_LayoutDirection(row, r % 4 == 3 ? UILayoutDirection_rightToLeft : UILayoutDirection_leftToRight);
+            UI_PaddingEx(row, 1.0f, 1.0f, 2.0f, 2.0f);
+            UI_ChildGap(row, 1.0f);
+            UI_AlignY(row, r % 3 == 0 ? UIAlignY_top : r % 3 == 1 ? UIAlignY_center : UIAlignY_bottom);
+            for (uint32_t i = 0; i < ROW_CELLS; i++) {
+                UIElement *cell = UIElement_New(row);
+                if (cell == NULL)
+                    return false;
+                float size = (float)(8 + (p + r + i) % 5);
+                UI_FixedWidth(cell, size);
+                UI_FixedHeight(cell, size);
+                UI_MarginEx(cell, (float)(r % 2), (float)(r % 2), (float)(i % 3), (float)(i % 3));
+            }
+        }
+    }
+    return true;
+}
+
+// Copy each element of the context into its own block, return the blocks by
+// row of the tree
+Element **copyElements(UIContext *ctx, bool shuffled) {
+    uint32_t n = ctx->_tree.len;
+    Element **blocks = (Element **)malloc(sizeof(Element *) * n);
+    Element **order = (Element **)malloc(sizeof(Element *) * n);
+    if (blocks == NULL || order == NULL)
+        return NULL;
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = (Element *)malloc(sizeof(Element));
+        if (order[i] == NULL)
+            return NULL;
+    }
+    if (shuffled) {
+        srand(1);
+        for (uint32_t i = n - 1; i > 0; i--) {
+            uint32_t j = (uint32_t)rand() % (i + 1);
+            Element *swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+    }
+    // The blocks are used depth first, in the order an application creates them
+    uint32_t next = 0;
+    bool copied = copyElement(ctx->root, NULL, blocks, order, &next);
+    free(order);
+    return copied ? blocks : NULL;
+}
+
+bool copyElement(UIElement *element, Element *parent, Element **blocks, Element **order, uint32_t *next) {
+    Element *copy = order[(*next)++];
+    *copy = (Element) {
+        .box = element->context->_tree.boxes[element->_handle],
+        .layout = *UIElement_Layout(element),
+        .backgroundColor = element->backgroundColor,
+        .scrollX = element->scrollX,
+        .scrollY = element->scrollY,
+        .contentW = element->contentW,
+        .contentH = element->contentH,
+        .parent = parent,
+        .context = element->context,
+        .children = { NULL, element->children.len, element->children.len },
+        .lastBox = { 0, 0, 0, 0 },
+        .childExtent = 0,
+        .dirty = true
+    };
+    blocks[element->_handle] = copy;
+    if (element->children.len == 0)
+        return true;
+    copy->children.data = (Element **)malloc(sizeof(Element *) * element->children.len);
+    if (copy->children.data == NULL)
+        return false;
+    for (uint32_t i = 0; i < element->children.len; i++) {
+        copy->children.data[i] = order[*next];
+        if (!copyElement(element->children.data[i], copy, blocks, order, next))
+            return false;
+    }
+    return true;
+}
+
+void freeElements(Element **blocks, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        free(blocks[i]->children.data);
+        free(blocks[i]);
+    }
+    free(blocks);
+}
+
+void elementMarkDirty(Element *element) {
+    element->dirty = true;
+    for (uint32_t i = 0, n = element->children.len; i < n; i++)
+        elementMarkDirty(element->children.data[i]);
+}
+
+// The fit pass of the tree on the elements, both axes in one visit
+void elementFit(Element *element) {
+    if (!element->dirty)
+        return;
+    for (uint32_t i = 0, n = element->children.len; i < n; i++)
+        elementFit(element->children.data[i]);
+
+    UILayout *layout = &element->layout;
+    bool horizontal = layout->direction == UILayoutDirection_leftToRight ||
+        layout->direction == UILayoutDirection_rightToLeft;
+    element->childExtent = elementChildSum(element, horizontal);
+    if (layout->w_sizing == UISizing_fixed)
+        elementSetW(element, layout->w_min);
+    else if (layout->w_sizing == UISizing_fit)
+        elementFitWidth(element);
+    if (layout->h_sizing == UISizing_fixed)
+        elementSetH(element, layout->h_min);
+    else if (layout->h_sizing == UISizing_fit)
+        elementFitHeight(element);
+}
+
+void elementFitWidth(Element *element) {
+    UIPadding padding = element->layout.padding;
+    if (element->children.len == 0) {
+        elementSetW(element, padding.left + padding.right + element->contentW);
+        return;
+    }
+    bool horizontal = element->layout.direction == UILayoutDirection_leftToRight ||
+        element->layout.direction == UILayoutDirection_rightToLeft;
+    float w = horizontal ? element->childExtent : elementChildMax(element, true);
+    if (element->contentW > 0)
+        w = UI_fmax2(w, padding.left + padding.right + element->contentW);
+    elementSetW(element, w);
+}
+
+void elementFitHeight(Element *element) {
+    UIPadding padding = element->layout.padding;
+    if (element->children.len == 0) {
+        elementSetH(element, padding.top + padding.bottom + element->contentH);
+        return;
+    }
+    bool horizontal = element->layout.direction == UILayoutDirection_leftToRight ||
+        element->layout.direction == UILayoutDirection_rightToLeft;
+    float h = horizontal ? elementChildMax(element, false) : element->childExtent;
+    if (element->contentH > 0)
+        h = UI_fmax2(h, padding.top + padding.bottom + element->contentH);
+    elementSetH(element, h);
+}
+
+void elementSetW(Element *element, float w) {
+    if (w < element->layout.w_min)
+        w = element->layout.w_min;
+    else if (w > element->layout.w_max && element->layout.w_max != 0)
+        w = element->layout.w_max;
+    element->box.w = w < 0 ? 0 : w;
+}
+
+void elementSetH(Element *element, float h) {
+    if (h < element->layout.h_min)
+        h = element->layout.h_min;
+    else if (h > element->layout.h_max && element->layout.h_max != 0)
+        h = element->layout.h_max;
+    element->box.h = h < 0 ? 0 : h;
+}
+
+// Sum of the children along an axis with the padding, the margins and the
+// gaps, fill children count with their minimum
+float elementChildSum(Element *element, bool horizontal) {
+    UIPadding padding = element->layout.padding;
+    float prevMargin = horizontal ? padding.left : padding.top;
+    float sum = 0;
+    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
+        Element *child = element->children.data[i];
+        UILayout *layout = &child->layout;
+        float gap = i == 0 ? 0 : element->layout.childGap;
+        if (horizontal)
+            sum += layout->w_sizing == UISizing_fill ? layout->w_min : child->box.w;
+        else
+            sum += layout->h_sizing == UISizing_fill ? layout->h_min : child->box.h;
+        sum += UI_fmax3(prevMargin, horizontal ? layout->margin.left : layout->margin.top, gap);
+        prevMargin = horizontal ? layout->margin.right : layout->margin.bottom;
+    }
+    return sum + UI_fmax2(horizontal ? padding.right : padding.bottom, prevMargin);
+}
+
+// Largest child across an axis with the padding and its margins
+float elementChildMax(Element *element, bool horizontal) {
+    UIPadding padding = element->layout.padding;
+    float max = 0;
+    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
+        Element *child = element->children.data[i];
+        UILayout *layout = &child->layout;
+        float size = horizontal
+            ? (layout->w_sizing == UISizing_fill ? layout->w_min : child->box.w) +
+                UI_fmax2(padding.left, layout->margin.left) + UI_fmax2(padding.right, layout->margin.right)
+            : (layout->h_sizing == UISizing_fill ? layout->h_min : child->box.h) +
+                UI_fmax2(padding.top, layout->margin.top) + UI_fmax2(padding.bottom, layout->margin.bottom);
+        if (max < size)
+            max = size;
+    }
+    return max;
+}
+
+// The position pass of the tree on the elements
+void elementPosition(Element *element) {
+    UIRect box = element->box;
+    UIRect lastBox = element->lastBox;
+    bool moved = box.x != lastBox.x || box.y != lastBox.y || box.w != lastBox.w || box.h != lastBox.h;
+    if (!element->dirty && !moved)
+        return;
+
+    elementPositionX(element);
+    elementPositionY(element);
+    element->lastBox = box;
+    element->dirty = false;
+    for (uint32_t i = 0, n = element->children.len; i < n; i++)
+        elementPosition(element->children.data[i]);
+}
+
+void elementPositionX(Element *element) {
+    UILayout *layout = &element->layout;
+    UIPadding padding = layout->padding;
+    float baseX = element->box.x - element->scrollX;
+    float elementW = element->box.w;
+    uint32_t n = element->children.len;
+
+    if (layout->direction == UILayoutDirection_topToBottom || layout->direction == UILayoutDirection_bottomToTop) {
+        for (uint32_t i = 0; i < n; i++) {
+            Element *child = element->children.data[i];
+            float leftSpace = UI_fmax2(padding.left, child->layout.margin.left);
+            float rightSpace = UI_fmax2(padding.right, child->layout.margin.right);
+            float childW = child->box.w;
+            switch (layout->alignX) {
+            case UIAlignX_left:
+                child->box.x = baseX + leftSpace;
+                break;
+            case UIAlignX_right:
+                child->box.x = baseX + elementW - childW - rightSpace;
+                break;
+            case UIAlignX_center: {
+                float offset = (elementW - childW) / 2.0f;
+                if (offset < leftSpace)
+                    offset = leftSpace;
+                else if (elementW - offset - childW < rightSpace)
+                    offset = elementW - childW - rightSpace;
+                child->box.x = baseX + offset;
+                break;
+            }
+            }
+        }
+        return;
+    }
+    if (n == 0)
+        return;
+
+    bool reverse = layout->direction == UILayoutDirection_rightToLeft;
+    float childWidth = element->childExtent;
+    float childOffset = 0;
+    if (layout->alignX == UIAlignX_right)
+        childOffset = elementW - childWidth;
+    else if (layout->alignX == UIAlignX_center) {
+        Element *first = element->children.data[reverse ? n - 1 : 0];
+        Element *last = element->children.data[reverse ? 0 : n - 1];
+        float leftSpace = UI_fmax2(padding.left, first->layout.margin.left);
+        float rightSpace = UI_fmax2(padding.right, last->layout.margin.right);
+        childWidth -= leftSpace + rightSpace;
+        float offset = (elementW - childWidth) / 2;
+        if (offset < leftSpace)
+            offset = leftSpace;
+        else if (elementW - offset - childWidth < rightSpace)
+            offset = elementW - childWidth - rightSpace;
+        childOffset = offset - leftSpace;
+    }
+    float xOffset = 0;
+    float prevMargin = padding.left;
+    for (uint32_t i = 0; i < n; i++) {
+        Element *child = element->children.data[reverse ? n - 1 - i : i];
+        float gap = i == 0 ? 0 : layout->childGap;
+        xOffset += UI_fmax3(prevMargin, child->layout.margin.left, gap);
+        child->box.x = baseX + xOffset + childOffset;
+        xOffset += child->box.w;
+        prevMargin = child->layout.margin.right;
+    }
+}
+
+void elementPositionY(Element *element) {
+    UILayout *layout = &element->layout;
+    UIPadding padding = layout->padding;
+    float baseY = element->box.y - element->scrollY;
+    float elementH = element->box.h;
+    uint32_t n = element->children.len;
+
+    if (layout->direction == UILayoutDirection_leftToRight || layout->direction == UILayoutDirection_rightToLeft) {
+        for (uint32_t i = 0; i < n; i++) {
+            Element *child = element->children.data[i];
+            float topSpace = UI_fmax2(padding.top, child->layout.margin.top);
+            float bottomSpace = UI_fmax2(padding.bottom, child->layout.margin.bottom);
+            float childH = child->box.h;
+            switch (layout->alignY) {
+            case UIAlignY_top:
+                child->box.y = baseY + topSpace;
+                break;
+            case UIAlignY_bottom:
+                child->box.y = baseY + elementH - childH - bottomSpace;
+                break;
+            case UIAlignY_center: {
+                float offset = (elementH - childH) / 2.0f;
+                if (offset < topSpace)
+                    offset = topSpace;
+                else if (elementH - offset - childH < bottomSpace)
+                    offset = elementH - childH - bottomSpace;
+                child->box.y = baseY + offset;
+                break;
+            }
+            }
+        }
+        return;
+    }
+    if (n == 0)
+        return;
+
+    bool reverse = layout->direction == UILayoutDirection_bottomToTop;
+    float childHeight = element->childExtent;
+    float childOffset = 0;
+    if (layout->alignY == UIAlignY_bottom)
+        childOffset = elementH - childHeight;
+    else if (layout->alignY == UIAlignY_center) {
+        Element *first = element->children.data[reverse ? n - 1 : 0];
+        Element *last = element->children.data[reverse ? 0 : n - 1];
+        float topSpace = UI_fmax2(padding.top, first->layout.margin.top);
+        float bottomSpace = UI_fmax2(padding.bottom, last->layout.margin.bottom);
+        childHeight -= topSpace + bottomSpace;
+        float offset = (elementH - childHeight) / 2;
+        if (offset < topSpace)
+            offset = topSpace;
+        else if (elementH - offset - childHeight < bottomSpace)
+            offset = elementH - childHeight - bottomSpace;
+        childOffset = offset - topSpace;
+    }
+    float yOffset = 0;
+    float prevMargin = padding.top;
+    for (uint32_t i = 0; i < n; i++) {
+        Element *child = element->children.data[reverse ? n - 1 - i : i];
+        float gap = i == 0 ? 0 : layout->childGap;
+        yOffset += UI_fmax3(prevMargin, child->layout.margin.top, gap);
+        child->box.y = baseY + yOffset + childOffset;
+        yOffset += child->box.h;
+        prevMargin = child->layout.margin.bottom;
+    }
+}
+
+void treeMarkDirty(UI__Tree *tree) {
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        tree->dirty[i] = true;
+}
+
+// The fit and position passes of the context over every row of the tree, the
+// tree has no wrapped text so both axes are fit in one pass
+void treeLayout(UI__Tree *tree) {
+    UI__TreeFit(tree);
+    UI__TreePosition(tree);
+}
+
+uint32_t countMismatches(UI__Tree *tree, Element **blocks) {
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UIRect a = tree->boxes[i];
+        UIRect b = blocks[i]->box;
+        if (a.x != b.x || a.y != b.y || a.w != b.w || a.h != b.h)
+            mismatches++;
+    }
+    return mismatches;
+}
+
+#ifdef __linux__
+
+Counter counterOpen(void) {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(struct perf_event_attr),
+        .config = PERF_COUNT_HW_CACHE_MISSES,
+        .exclude_kernel = 1,
+        .exclude_hv = 1
+    };
+    Counter counter = { .fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0) };
+    return counter;
+}
+
+uint64_t counterRead(Counter *counter) {
+    uint64_t value = 0;
+    if (counter->fd < 0 || read(counter->fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+void counterClose(Counter *counter) {
+    if (counter->fd >= 0)
+        close(counter->fd);
+}
+
+#else
+
+Counter counterOpen(void) {
+    Counter counter = { .fd = -1 };
+    return counter;
+}
+
+uint64_t counterRead(Counter *counter) {
+    (void)counter;
+    return 0;
+}
+
+void counterClose(Counter *counter) {
+    (void)counter;
+}
+
+#endif
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
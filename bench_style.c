@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define UI_IMPLEMENTATION
+#include "ui.h"
+#include "null_impl.c"
+
+// Styles the rows of a table with the layout setters and with shared styles
+// and checks that both give the same boxes. Each row has a label and a value,
+// the setters take a dozen calls per row where `UI_Style` takes three. Every
+// other row is then highlighted with a taller style and put back.
+// Usage: bench_style [rows] [repetitions]
+
+typedef struct Table {
+    UIContext context;
+    UIElement *list;
+    UIElement **rows; // Row, label and value of each row
+} Table;
+
+typedef struct Styles {
+    UIStyle row, selected, label, value;
+} Styles;
+
+void tableInit(Table *table, UINullBackend *backend, uint32_t rowCount);
+void applySetters(Table *table, uint32_t rowCount);
+void selectSetters(Table *table, uint32_t rowCount, bool selected);
+Styles addStyles(UIContext *ctx);
+void applyStyles(Table *table, uint32_t rowCount, const Styles *styles);
+void selectStyles(Table *table, uint32_t rowCount, const Styles *styles, bool selected);
+double timeNow(void);
+
+int main(int argc, char **argv) {
+    uint32_t rowCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    uint32_t repetitions = argc > 2 ? (uint32_t)atoi(argv[2]) : 20;
+
+    UINullBackend backend;
+    UINullBackend_Init(&backend);
+    Table setters;
+    Table styled;
+    tableInit(&setters, &backend, rowCount);
+    tableInit(&styled, &backend, rowCount);
+    Styles styles = addStyles(&styled.context);
+
+    double start = timeNow();
+    applySetters(&setters, rowCount);
+    double setterApply = timeNow() - start;
+    start = timeNow();
+    applyStyles(&styled, rowCount, &styles);
+    double styleApply = timeNow() - start;
+
+    // Highlighting goes back and forth between two layouts already interned
+    double setterSelect = 0;
+    double styleSelect = 0;
+    for (uint32_t r = 0; r < repetitions; r++) {
+        start = timeNow();
+        selectSetters(&setters, rowCount, r % 2 == 0);
+        setterSelect += timeNow() - start;
+        start = timeNow();
+        selectStyles(&styled, rowCount, &styles, r % 2 == 0);
+        styleSelect += timeNow() - start;
+    }
+    if (!UIContext_Draw(&setters.context) || !UIContext_Draw(&styled.context)) {
+        fprintf(stderr, "UI Error: %s\n", UI_ErrorGetStr(&setters.context));
+        return 1;
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < rowCount * 3; i++) {
+        UIRect a = UIElement_Box(setters.rows[i]);
+        UIRect b = UIElement_Box(styled.rows[i]);
+        if (a.x != b.x || a.y != b.y || a.w != b.w || a.h != b.h)
+            mismatches++;
+    }
+    printf(
+        "%u rows  %u bytes per element\n"
+        "setters  apply %8.3f ms  highlight %8.3f ms  %u styles\n"
+        "styles   apply %8.3f ms  highlight %8.3f ms  %u styles\n"
+        "%u mismatches\n",
+        rowCount, (uint32_t)sizeof(UIElement),
+        setterApply * 1e3, setterSelect * 1e3 / repetitions, setters.context._styles.count,
+        styleApply * 1e3, styleSelect * 1e3 / repetitions, styled.context._styles.count,
+        mismatches);
+
+    UIContext_Destroy(&setters.context);
+    UIContext_Destroy(&styled.context);
+    free(setters.rows);
+    free(styled.rows);
+    return mismatches == 0 ? 0 : 1;
+}
+
+void tableInit(Table *table, UINullBackend *backend, uint32_t rowCount) {
+    UIContext *ctx = &table->context;
+    if (!UIContext_Init(ctx, (void *)backend))
+        exit(1);
+    UIContext_SetMaxElements(ctx, 0);
+    UIContext_UpdateWindow(ctx, 1280, 720);
+    table->list = UIElement_New(ctx->root);
+    table->rows = (UIElement **)malloc(sizeof(UIElement *) * rowCount * 3);
+    if (table->list == NULL || table->rows == NULL || !UIElement_ReserveChildren(table->list, rowCount))
+        exit(1);
+    UI_FillWidth(table->list, 1.0f);
+    UI_FillHeight(table->list, 1.0f);
+    UI_ClipChildren(table->list, true);
+    for (uint32_t i = 0; i < rowCount; i++) {
+        UIElement *row = UIElement_New(table->list);
+        UIElement *label = row == NULL ? NULL : UIElement_New(row);
+        UIElement *value = label == NULL ? NULL : UIElement_New(row);
+        if (value == NULL)
+            exit(1);
+        table->rows[i * 3] = row;
+        table->rows[i * 3 + 1] = label;
+        table->rows[i * 3 + 2] = value;
+    }
+}
+
+void applySetters(Table *table, uint32_t rowCount) {
+    for (uint32_t i = 0; i < rowCount; i++) {
+        UIElement *row = table->rows[i * 3];
+        UIElement *label = table->rows[i * 3 + 1];
+        UIElement *value = table->rows[i * 3 + 2];
+        UI_LayoutDirection(row, UILayoutDirection_leftToRight);
+        UI_FillWidth(row, 1.0f);
+        UI_FixedHeight(row, 24.0f);
+        UI_PaddingEx(row, 2.0f, 2.0f, 8.0f, 8.0f);
+        UI_ChildGap(row, 8.0f);
+        UI_AlignY(row, UIAlignY_center);
+        UI_FixedWidth(label, 120.0f);
+        UI_FillHeight(label, 1.0f);
+        UI_FillWidth(value, 1.0f);
+        UI_FillHeight(value, 1.0f);
+        UI_MinWidth(value, 40.0f);
+        UI_MaxWidth(value, 600.0f);
+    }
+}
+
+void selectSetters(Table *table, uint32_t rowCount, bool selected) {
+    for (uint32_t i = 0; i < rowCount; i += 2) {
+        UIElement *row = table->rows[i * 3];
+        UI_FixedHeight(row, selected ? 48.0f : 24.0f);
+        UI_PaddingEx(row, selected ? 6.0f : 2.0f, selected ? 6.0f : 2.0f, 8.0f, 8.0f);
+    }
+}
+
+Styles addStyles(UIContext *ctx) {
+    const UILayout row = {
+        .padding = { 2.0f, 2.0f, 8.0f, 8.0f },
+        .margin = { 0, 0, 0, 0 },
+        .direction = UILayoutDirection_leftToRight,
+        .alignX = UIAlignX_left,
+        .alignY = UIAlignY_center,
+        .w_sizing = UISizing_fill,
+        .h_sizing = UISizing_fixed,
+        .childGap = 8.0f,
+        .w_weight = 1.0f,
+        .w_min = 0.0f,
+        .w_max = 0.0f,
+        .h_weight = 0.0f,
+        .h_min = 24.0f,
+        .h_max = 24.0f
+    };
+    UILayout selected = row;
+    selected.padding.top = selected.padding.bottom = 6.0f;
+    selected.h_min = selected.h_max = 48.0f;
+
+    const UILayout label = {
+        .padding = { 0, 0, 0, 0 },
+        .margin = { 0, 0, 0, 0 },
+        .direction = UILayoutDirection_topToBottom,
+        .alignX = UIAlignX_left,
+        .alignY = UIAlignY_top,
+        .w_sizing = UISizing_fixed,
+        .h_sizing = UISizing_fill,
+        .childGap = 0.0f,
+        .w_weight = 1.0f,
+        .w_min = 120.0f,
+        .w_max = 120.0f,
+        .h_weight = 1.0f,
+        .h_min = 0.0f,
+        .h_max = 0.0f
+    };
+    UILayout value = label;
+    value.w_sizing = UISizing_fill;
+    value.w_min = 40.0f;
+    value.w_max = 600.0f;
+
+    Styles styles = {
+        .row = UIContext_AddStyle(ctx, &row),
+        .selected = UIContext_AddStyle(ctx, &selected),
+        .label = UIContext_AddStyle(ctx, &label),
+        .value = UIContext_AddStyle(ctx, &value)
+    };
+    return styles;
+}
+
+void applyStyles(Table *table, uint32_t rowCount, const Styles *styles) {
+    for (uint32_t i = 0; i < rowCount; i++) {
+        UI_Style(table->rows[i * 3], styles->row);
+        UI_Style(table->rows[i * 3 + 1], styles->label);
+        UI_Style(table->rows[i * 3 + 2], styles->value);
+    }
+}
+
+void selectStyles(Table *table, uint32_t rowCount, const Styles *styles, bool selected) {
+    for (uint32_t i = 0; i < rowCount; i += 2)
+        UI_Style(table->rows[i * 3], selected ? styles->selected : styles->row);
+}
+
+double timeNow(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -0,0 +1,509 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include "ui.h"
+
+// A backend that draws into a framebuffer in memory, without a GPU or SDL.
+// Pixels are RGBA with one byte per channel, a pixel is covered by a rectangle
+// when its center is inside it, so the output only depends on the draw list.
+// The screen is split in tiles and each tile is drawn by a single thread.
+// Every font is the same monospaced font of 8 by 16 pixels scaled by the font
+// number, its glyphs are solid boxes. Define UICPU_EXTERNAL_FONT to implement
+// the text functions elsewhere.
+
+// The SSE2 spans are used when the target has them, define UI_NO_SIMD to
+// always use the scalar ones
+#if !defined(UI_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define UICPU_SSE2
+#include <emmintrin.h>
+#endif
+
+#define UICPU_TILE_SIZE 64
+
+// Pixels covered by a command, the end is excluded
+typedef struct UICPUSpan {
+    int32_t x0, y0, x1, y1;
+} UICPUSpan;
+
+// The `userData` of a context using the CPU backend
+typedef struct UICPUBackend {
+    uint8_t *pixels; // Supplied by the caller, only the damage of partial draw lists is cleared
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch; // Bytes from a row to the next
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t *tileStart; // Index in `binned` of the first command of each tile, one more than the tiles
+    uint32_t *binned; // Commands of each tile in drawing order
+    uint32_t binnedCap;
+    UICPUSpan *spans; // Of each command of the list being drawn
+    uint32_t spanCap;
+    const UIDrawList *list;
+    const UIGlyphAtlas *atlas;
+    uint64_t pixelsDrawn; // Pixels written by the last UI_DrawList, counted once per command
+    // Workers, the thread that calls UI_DrawList is the first one
+    thrd_t *threads;
+    uint32_t threadCount; // Not including the calling thread
+    mtx_t lock;
+    cnd_t wake;
+    cnd_t done;
+    uint32_t generation; // Incremented for each batch of tasks
+    uint32_t busyThreads;
+    bool quit;
+    void (*task)(void *data, uint32_t index);
+    void *taskData;
+    uint32_t taskCount;
+    atomic_uint nextTask;
+} UICPUBackend;
+
+// Draw into `width * height` pixels, the memory must stay valid until the
+// backend draws into another framebuffer
+void UICPUBackend_Init(UICPUBackend *backend, uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch);
+void UICPUBackend_Destroy(UICPUBackend *backend);
+void UICPUBackend_SetFramebuffer(UICPUBackend *backend, uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch);
+// Start the threads that draw the tiles and run the layout tasks,
+// `threadCount` does not include the thread that draws the context
+bool UICPUBackend_StartWorkers(UICPUBackend *backend, uint32_t threadCount);
+void UICPUBackend_StopWorkers(UICPUBackend *backend);
+// Call `task` once for every index below `count` on all the threads
+void UICPUBackend_RunTasks(UICPUBackend *backend, void (*task)(void *data, uint32_t index), void *data, uint32_t count);
+
+bool UICPUBackend_Reserve(UICPUBackend *backend, uint32_t commandCount, uint32_t binnedCount);
+bool UICPUBackend_Bin(UICPUBackend *backend, const UIDrawList *list);
+void UICPUBackend_DrawTile(void *data, uint32_t tile);
+void UICPUBackend_ClearTile(UICPUBackend *backend, UICPUSpan bounds);
+void UICPU_FillSpan(uint32_t *row, int32_t count, UIColor color);
+void UICPU_DrawGlyph(
+    uint8_t *pixels, uint32_t pitch, UICPUSpan span,
+    const UIDrawCommand *command, const UIGlyphAtlas *atlas);
+uint32_t UICPU_Blend(uint32_t dst, uint32_t src, uint32_t alpha);
+void UICPUBackend_Work(UICPUBackend *backend);
+int UICPUWorker_Main(void *data);
+
+void *UI_MemAlloc(uint32_t size) {
+    return malloc(size);
+}
+
+void *UI_MemExpand(void *block, uint32_t size) {
+    return realloc(block, size);
+}
+
+void *UI_MemShrink(void *block, uint32_t size) {
+    void *new_block = realloc(block, size);
+    return new_block == NULL ? block : new_block;
+}
+
+void UI_MemFree(void *block) {
+    free(block);
+}
+
+void UICPUBackend_Init(UICPUBackend *backend, uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch) {
+    backend->tileStart = NULL;
+    backend->binned = NULL;
+    backend->binnedCap = 0;
+    backend->spans = NULL;
+    backend->spanCap = 0;
+    backend->list = NULL;
+    backend->atlas = NULL;
+    backend->pixelsDrawn = 0;
+    backend->threads = NULL;
+    backend->threadCount = 0;
+    UICPUBackend_SetFramebuffer(backend, pixels, width, height, pitch);
+}
+
+void UICPUBackend_Destroy(UICPUBackend *backend) {
+    UICPUBackend_StopWorkers(backend);
+    free(backend->tileStart);
+    free(backend->binned);
+    free(backend->spans);
+    backend->tileStart = NULL;
+    backend->binned = NULL;
+    backend->binnedCap = 0;
+    backend->spans = NULL;
+    backend->spanCap = 0;
+}
+
+void UICPUBackend_SetFramebuffer(UICPUBackend *backend, uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch) {
+    backend->pixels = pixels;
+    backend->width = width;
+    backend->height = height;
+    backend->pitch = pitch;
+    backend->tilesX = (width + UICPU_TILE_SIZE - 1) / UICPU_TILE_SIZE;
+    backend->tilesY = (height + UICPU_TILE_SIZE - 1) / UICPU_TILE_SIZE;
+    free(backend->tileStart);
+    backend->tileStart = NULL;
+}
+
+bool UI_DrawList(UIContext *ctx, const UIDrawList *list) {
+    UICPUBackend *backend = (UICPUBackend *)ctx->userData;
+    backend->pixelsDrawn = 0;
+    // The atlas is read in place, nothing has to be uploaded
+    ctx->atlas.dirty = (UIRect) { 0, 0, 0, 0 };
+    // The damage of partial lists is cleared even without commands
+    bool clear = list->partial && list->damageCount != 0;
+    if ((list->len == 0 && !clear) || backend->tilesX == 0 || backend->tilesY == 0)
+        return true;
+    if (!UICPUBackend_Bin(backend, list))
+        return false;
+    backend->list = list;
+    backend->atlas = &ctx->atlas;
+    UICPUBackend_RunTasks(backend, UICPUBackend_DrawTile, backend, backend->tilesX * backend->tilesY);
+    return true;
+}
+
+bool UICPUBackend_Reserve(UICPUBackend *backend, uint32_t commandCount, uint32_t binnedCount) {
+    if (backend->tileStart == NULL) {
+        backend->tileStart = malloc(sizeof(uint32_t) * (backend->tilesX * backend->tilesY + 1));
+        if (backend->tileStart == NULL)
+            return false;
+    }
+    if (commandCount > backend->spanCap) {
+        UICPUSpan *spans = realloc(backend->spans, sizeof(UICPUSpan) * commandCount);
+        if (spans == NULL)
+            return false;
+        backend->spans = spans;
+        backend->spanCap = commandCount;
+    }
+    if (binnedCount > backend->binnedCap) {
+        uint32_t *binned = realloc(backend->binned, sizeof(uint32_t) * binnedCount);
+        if (binned == NULL)
+            return false;
+        backend->binned = binned;
+        backend->binnedCap = binnedCount;
+    }
+    return true;
+}
+
+// Find the pixels of each command and sort the commands by the tiles they
+// touch, keeping the drawing order inside each tile
+bool UICPUBackend_Bin(UICPUBackend *backend, const UIDrawList *list) {
+    if (!UICPUBackend_Reserve(backend, list->len, 0))
+        return false;
+    uint32_t tileCount = backend->tilesX * backend->tilesY;
+    uint32_t *tileStart = backend->tileStart;
+    memset(tileStart, 0, sizeof(uint32_t) * (tileCount + 1));
+
+    uint32_t binnedCount = 0;
+    for (uint32_t i = 0; i < list->len; i++) {
+        const UIDrawCommand *command = &list->data[i];
+        float left = command->rect.x > command->clip.x ? command->rect.x : command->clip.x;
+        float top = command->rect.y > command->clip.y ? command->rect.y : command->clip.y;
+        float right = command->rect.x + command->rect.w;
+        float bottom = command->rect.y + command->rect.h;
+        if (command->clip.x + command->clip.w < right)
+            right = command->clip.x + command->clip.w;
+        if (command->clip.y + command->clip.h < bottom)
+            bottom = command->clip.y + command->clip.h;
+
+        // Pixels whose center is inside the rectangle
+        UICPUSpan span = {
+            .x0 = (int32_t)fmaxf(ceilf(left - 0.5f), 0),
+            .y0 = (int32_t)fmaxf(ceilf(top - 0.5f), 0),
+            .x1 = (int32_t)fminf(ceilf(right - 0.5f), (float)backend->width),
+            .y1 = (int32_t)fminf(ceilf(bottom - 0.5f), (float)backend->height)
+        };
+        if (command->color.a == 0 || span.x0 >= span.x1 || span.y0 >= span.y1)
+            span = (UICPUSpan) { 0, 0, 0, 0 };
+        backend->spans[i] = span;
+        if (span.x0 == span.x1)
+            continue;
+        backend->pixelsDrawn += (uint64_t)(span.x1 - span.x0) * (uint64_t)(span.y1 - span.y0);
+        for (int32_t ty = span.y0 / UICPU_TILE_SIZE; ty <= (span.y1 - 1) / UICPU_TILE_SIZE; ty++) {
+            for (int32_t tx = span.x0 / UICPU_TILE_SIZE; tx <= (span.x1 - 1) / UICPU_TILE_SIZE; tx++) {
+                tileStart[ty * backend->tilesX + tx + 1]++;
+                binnedCount++;
+            }
+        }
+    }
+
+    for (uint32_t t = 0; t < tileCount; t++)
+        tileStart[t + 1] += tileStart[t];
+    if (!UICPUBackend_Reserve(backend, list->len, binnedCount))
+        return false;
+    // `tileStart` is moved to the end of each tile while filling it and then back
+    for (uint32_t i = 0; i < list->len; i++) {
+        UICPUSpan span = backend->spans[i];
+        if (span.x0 == span.x1)
+            continue;
+        for (int32_t ty = span.y0 / UICPU_TILE_SIZE; ty <= (span.y1 - 1) / UICPU_TILE_SIZE; ty++) {
+            for (int32_t tx = span.x0 / UICPU_TILE_SIZE; tx <= (span.x1 - 1) / UICPU_TILE_SIZE; tx++)
+                backend->binned[tileStart[ty * backend->tilesX + tx]++] = i;
+        }
+    }
+    for (uint32_t t = tileCount; t > 0; t--)
+        tileStart[t] = tileStart[t - 1];
+    tileStart[0] = 0;
+    return true;
+}
+
+void UICPUBackend_DrawTile(void *data, uint32_t tile) {
+    UICPUBackend *backend = (UICPUBackend *)data;
+    int32_t tileX = (int32_t)(tile % backend->tilesX) * UICPU_TILE_SIZE;
+    int32_t tileY = (int32_t)(tile / backend->tilesX) * UICPU_TILE_SIZE;
+    UICPUSpan bounds = { tileX, tileY, tileX + UICPU_TILE_SIZE, tileY + UICPU_TILE_SIZE };
+    if (backend->list->partial)
+        UICPUBackend_ClearTile(backend, bounds);
+
+    for (uint32_t i = backend->tileStart[tile]; i < backend->tileStart[tile + 1]; i++) {
+        uint32_t index = backend->binned[i];
+        const UIDrawCommand *command = &backend->list->data[index];
+        UICPUSpan span = backend->spans[index];
+        if (span.x0 < bounds.x0) span.x0 = bounds.x0;
+        if (span.y0 < bounds.y0) span.y0 = bounds.y0;
+        if (span.x1 > bounds.x1) span.x1 = bounds.x1;
+        if (span.y1 > bounds.y1) span.y1 = bounds.y1;
+
+        if (command->src.w != 0) {
+            UICPU_DrawGlyph(backend->pixels, backend->pitch, span, command, backend->atlas);
+            continue;
+        }
+        for (int32_t y = span.y0; y < span.y1; y++) {
+            uint32_t *row = (uint32_t *)(backend->pixels + (size_t)y * backend->pitch) + span.x0;
+            UICPU_FillSpan(row, span.x1 - span.x0, command->color);
+        }
+    }
+}
+
+// Make the damaged pixels of a tile transparent black, the damage is made of whole pixels
+void UICPUBackend_ClearTile(UICPUBackend *backend, UICPUSpan bounds) {
+    const UIDrawList *list = backend->list;
+    if (bounds.x1 > (int32_t)backend->width) bounds.x1 = (int32_t)backend->width;
+    if (bounds.y1 > (int32_t)backend->height) bounds.y1 = (int32_t)backend->height;
+    for (uint32_t k = 0; k < list->damageCount; k++) {
+        UIRect damage = list->damage[k];
+        int32_t x0 = (int32_t)damage.x > bounds.x0 ? (int32_t)damage.x : bounds.x0;
+        int32_t y0 = (int32_t)damage.y > bounds.y0 ? (int32_t)damage.y : bounds.y0;
+        int32_t x1 = (int32_t)(damage.x + damage.w) < bounds.x1 ? (int32_t)(damage.x + damage.w) : bounds.x1;
+        int32_t y1 = (int32_t)(damage.y + damage.h) < bounds.y1 ? (int32_t)(damage.y + damage.h) : bounds.y1;
+        for (int32_t y = y0; y < y1 && x0 < x1; y++)
+            memset(backend->pixels + (size_t)y * backend->pitch + (size_t)x0 * 4, 0, (size_t)(x1 - x0) * 4);
+    }
+}
+
+// Blend `alpha` parts of 255 of `src` over `dst`, the alpha channel of `src`
+// counts as opaque. The division by 255 is rounded like the SSE2 version.
+uint32_t UICPU_Blend(uint32_t dst, uint32_t src, uint32_t alpha) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t s = shift == 24 ? 255 : (src >> shift) & 0xff;
+        uint32_t d = (dst >> shift) & 0xff;
+        uint32_t t = s * alpha + d * (255 - alpha) + 128;
+        result |= ((t + (t >> 8)) >> 8) << shift;
+    }
+    return result;
+}
+
+void UICPU_FillSpan(uint32_t *row, int32_t count, UIColor color) {
+    uint32_t src = (uint32_t)color.r | (uint32_t)color.g << 8 | (uint32_t)color.b << 16 | 0xffu << 24;
+    int32_t i = 0;
+    if (color.a == 255) {
+#ifdef UICPU_SSE2
+        __m128i pixels = _mm_set1_epi32((int)src);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_si128((__m128i *)(row + i), pixels);
+#endif
+        for (; i < count; i++)
+            row[i] = src;
+        return;
+    }
+
+#ifdef UICPU_SSE2
+    // Two pixels in each half, one channel in each 16-bit lane
+    __m128i zero = _mm_setzero_si128();
+    __m128i srcTimesAlpha = _mm_mullo_epi16(
+        _mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero), _mm_set1_epi16((short)color.a));
+    __m128i invAlpha = _mm_set1_epi16((short)(255 - color.a));
+    __m128i round = _mm_set1_epi16(128);
+    for (; i + 4 <= count; i += 4) {
+        __m128i dst = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), invAlpha), srcTimesAlpha);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), invAlpha), srcTimesAlpha);
+        lo = _mm_add_epi16(lo, round);
+        hi = _mm_add_epi16(hi, round);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(row + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+        row[i] = UICPU_Blend(row[i], src, color.a);
+}
+
+// Blend the coverage of the atlas times the alpha of the color, `span` is
+// inside the rectangle of the command
+void UICPU_DrawGlyph(
+    uint8_t *pixels, uint32_t pitch, UICPUSpan span,
+    const UIDrawCommand *command, const UIGlyphAtlas *atlas)
+{
+    UIColor color = command->color;
+    uint32_t src = (uint32_t)color.r | (uint32_t)color.g << 8 | (uint32_t)color.b << 16 | 0xffu << 24;
+    // Glyphs are drawn at their size, the first pixel of the span is at the
+    // same offset from the rectangle in the atlas
+    int32_t srcX = (int32_t)command->src.x + span.x0 - (int32_t)ceilf(command->rect.x - 0.5f);
+    int32_t srcY = (int32_t)command->src.y + span.y0 - (int32_t)ceilf(command->rect.y - 0.5f);
+    for (int32_t y = span.y0; y < span.y1; y++) {
+        uint32_t *row = (uint32_t *)(pixels + (size_t)y * pitch);
+        const uint8_t *coverage = atlas->pixels + (size_t)(srcY + y - span.y0) * UI_ATLAS_SIZE + srcX;
+        for (int32_t x = span.x0; x < span.x1; x++) {
+            uint32_t t = coverage[x - span.x0] * color.a + 128;
+            uint32_t alpha = (t + (t >> 8)) >> 8;
+            if (alpha != 0)
+                row[x] = UICPU_Blend(row[x], src, alpha);
+        }
+    }
+}
+
+#ifndef UICPU_EXTERNAL_FONT
+
+bool UI_FontMetrics(UIContext *ctx, uint32_t font, UIFontMetrics *metrics) {
+    (void)ctx;
+    float scale = font == 0 ? 1.0f : (float)font;
+    *metrics = (UIFontMetrics) { .ascent = 12.0f * scale, .lineHeight = 16.0f * scale };
+    return true;
+}
+
+bool UI_GlyphMetrics(UIContext *ctx, uint32_t font, uint32_t codepoint, UIGlyphMetrics *metrics) {
+    (void)ctx;
+    uint32_t scale = font == 0 ? 1 : font;
+    uint32_t size = codepoint == ' ' ? 0 : scale;
+    *metrics = (UIGlyphMetrics) {
+        .advance = 8.0f * (float)scale,
+        .x = (float)scale,
+        .y = -10.0f * (float)scale,
+        .w = 6 * size,
+        .h = 10 * size
+    };
+    return true;
+}
+
+bool UI_GlyphRasterize(UIContext *ctx, uint32_t font, uint32_t codepoint, uint8_t *pixels, uint32_t pitch) {
+    (void)ctx;
+    (void)codepoint;
+    uint32_t scale = font == 0 ? 1 : font;
+    for (uint32_t y = 0; y < 10 * scale; y++)
+        memset(pixels + y * pitch, 255, 6 * scale);
+    return true;
+}
+
+#endif // !UICPU_EXTERNAL_FONT
+
+// Take tasks until there are none left
+void UICPUBackend_Work(UICPUBackend *backend) {
+    while (true) {
+        uint32_t task = atomic_fetch_add(&backend->nextTask, 1);
+        if (task >= backend->taskCount)
+            return;
+        backend->task(backend->taskData, task);
+    }
+}
+
+int UICPUWorker_Main(void *data) {
+    UICPUBackend *backend = (UICPUBackend *)data;
+    uint32_t generation = 0;
+    mtx_lock(&backend->lock);
+    while (true) {
+        while (!backend->quit && backend->generation == generation)
+            cnd_wait(&backend->wake, &backend->lock);
+        if (backend->quit)
+            break;
+        generation = backend->generation;
+        mtx_unlock(&backend->lock);
+        UICPUBackend_Work(backend);
+        mtx_lock(&backend->lock);
+        if (--backend->busyThreads == 0)
+            cnd_signal(&backend->done);
+    }
+    mtx_unlock(&backend->lock);
+    return 0;
+}
+
+bool UICPUBackend_StartWorkers(UICPUBackend *backend, uint32_t threadCount) {
+    UICPUBackend_StopWorkers(backend);
+    if (threadCount == 0)
+        return true;
+
+    backend->threads = malloc(sizeof(thrd_t) * threadCount);
+    if (backend->threads == NULL)
+        return false;
+    if (mtx_init(&backend->lock, mtx_plain) != thrd_success) {
+        free(backend->threads);
+        backend->threads = NULL;
+        return false;
+    }
+    cnd_init(&backend->wake);
+    cnd_init(&backend->done);
+    backend->generation = 0;
+    backend->busyThreads = 0;
+    backend->quit = false;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        if (thrd_create(&backend->threads[i], UICPUWorker_Main, backend) != thrd_success) {
+            UICPUBackend_StopWorkers(backend);
+            return false;
+        }
+        backend->threadCount++;
+    }
+    return true;
+}
+
+void UICPUBackend_StopWorkers(UICPUBackend *backend) {
+    if (backend->threads == NULL)
+        return;
+    mtx_lock(&backend->lock);
+    backend->quit = true;
+    cnd_broadcast(&backend->wake);
+    mtx_unlock(&backend->lock);
+    for (uint32_t i = 0; i < backend->threadCount; i++)
+        thrd_join(backend->threads[i], NULL);
+    cnd_destroy(&backend->wake);
+    cnd_destroy(&backend->done);
+    mtx_destroy(&backend->lock);
+    free(backend->threads);
+    backend->threads = NULL;
+    backend->threadCount = 0;
+}
+
+void UICPUBackend_RunTasks(UICPUBackend *backend, void (*task)(void *data, uint32_t index), void *data, uint32_t count) {
+    if (backend->threadCount == 0 || count < 2) {
+        for (uint32_t i = 0; i < count; i++)
+            task(data, i);
+        return;
+    }
+
+    mtx_lock(&backend->lock);
+    backend->task = task;
+    backend->taskData = data;
+    backend->taskCount = count;
+    atomic_store(&backend->nextTask, 0);
+    backend->busyThreads = backend->threadCount;
+    backend->generation++;
+    cnd_broadcast(&backend->wake);
+    mtx_unlock(&backend->lock);
+
+    UICPUBackend_Work(backend);
+    // The other threads may still be running the tasks they took
+    mtx_lock(&backend->lock);
+    while (backend->busyThreads != 0)
+        cnd_wait(&backend->done, &backend->lock);
+    mtx_unlock(&backend->lock);
+}
+
+#ifdef UI_THREADS
+
+void UI_RunTasks(UIContext *ctx, void (*task)(void *data, uint32_t index), void *data, uint32_t count) {
+    UICPUBackend_RunTasks((UICPUBackend *)ctx->userData, task, data, count);
+}
+
+#endif // !UI_THREADS
+
+#ifdef UI_STATS
+
+uint64_t UI_TimeNs(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+#endif // !UI_STATS
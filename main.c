@@ -19,9 +19,14 @@ int main(void) {
     SDL_Renderer *renderer = SDL_CreateRenderer(window, NULL);
     if (renderer == NULL) logErrorAndExit();
 
+    UISDL3Backend backend;
+    UISDL3Backend_Init(&backend, renderer);
+
     UIContext context;
-    if (!UIContext_Init(&context, (void *)renderer))
+    if (!UIContext_Init(&context, (void *)&backend))
         return 1;
+    // The backend keeps the last frame in a texture and only draws what changed
+    UIContext_SetPartialRedraw(&context, true);
 
     if (!generateLayout(context.root))
         return 1;
@@ -31,15 +36,21 @@ int main(void) {
         for (SDL_Event event; SDL_PollEvent(&event);) {
             if (event.type == SDL_EVENT_QUIT)
                 running = false;
+            else if (event.type == SDL_EVENT_WINDOW_EXPOSED)
+                UIContext_ForceRedraw(&context);
         }
+        if (!running)
+            break;
+
         int w, h;
         SDL_GetWindowSize(window, &w, &h);
         UIContext_UpdateWindow(&context, w, h);
 
-        if (!SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE))
-            logErrorAndExit();
-        if (!SDL_RenderClear(renderer))
-            logErrorAndExit();
+        // Sleep until something happens instead of presenting the same frame
+        if (!UIContext_NeedsRedraw(&context)) {
+            SDL_WaitEvent(NULL);
+            continue;
+        }
 
         if (!UIContext_Draw(&context))
             return 1;
@@ -48,6 +59,8 @@ int main(void) {
             logErrorAndExit();
     }
 
+    UIContext_Destroy(&context);
+    UISDL3Backend_Destroy(&backend);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -70,6 +83,10 @@ bool generateLayout(UIElement *root) {
     UI_FillHeight(sidebar, 1.0f);
     UI_MinWidth(sidebar, 100);
     UI_MaxWidth(sidebar, 300);
+    UI_Padding(sidebar, 8);
+
+    UIElement *title = UIElement_New(sidebar);
+    UI_Text(title, "C UI", 2, UI_BLACK);
 
     UIElement *pageContent = UIElement_New(root);
     UI_BackgroundColor(pageContent, UI_WHITE);
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <time.h>
+#include "ui.h"
+
+// A backend that draws nothing, for benchmarks and hosts without a display.
+// Memory comes from the C library and every call is counted. Every font is
+// the same monospaced font of 8 by 16 pixels, its glyphs are solid boxes.
+
+// Counters of the memory functions, shared by all the contexts
+typedef struct UINullMemStats {
+    uint64_t allocs;
+    uint64_t expands;
+    uint64_t frees;
+    uint64_t bytes; // Requested by UI_MemAlloc and UI_MemExpand
+} UINullMemStats;
+
+// The `userData` of a context using the null backend
+typedef struct UINullBackend {
+    uint32_t drawLists; // Calls to UI_DrawList
+    uint32_t commands; // Commands in the last draw list
+    uint32_t glyphsRasterized; // Calls to UI_GlyphRasterize
+} UINullBackend;
+
+UINullMemStats UINull_memStats = { 0, 0, 0, 0 };
+
+void UINullBackend_Init(UINullBackend *backend);
+
+void *UI_MemAlloc(uint32_t size) {
+    UINull_memStats.allocs++;
+    UINull_memStats.bytes += size;
+    return malloc(size);
+}
+
+void *UI_MemExpand(void *block, uint32_t size) {
+    UINull_memStats.expands++;
+    UINull_memStats.bytes += size;
+    return realloc(block, size);
+}
+
+void *UI_MemShrink(void *block, uint32_t size) {
+    void *new_block = realloc(block, size);
+    return new_block == NULL ? block : new_block;
+}
+
+void UI_MemFree(void *block) {
+    if (block != NULL)
+        UINull_memStats.frees++;
+    free(block);
+}
+
+void UINullBackend_Init(UINullBackend *backend) {
+    backend->drawLists = 0;
+    backend->commands = 0;
+    backend->glyphsRasterized = 0;
+}
+
+bool UI_DrawList(UIContext *ctx, const UIDrawList *list) {
+    UINullBackend *backend = (UINullBackend *)ctx->userData;
+    backend->drawLists++;
+    backend->commands = list->len;
+    ctx->atlas.dirty = (UIRect) { 0, 0, 0, 0 };
+    return true;
+}
+
+bool UI_FontMetrics(UIContext *ctx, uint32_t font, UIFontMetrics *metrics) {
+    (void)ctx;
+    (void)font;
+    *metrics = (UIFontMetrics) { .ascent = 12.0f, .lineHeight = 16.0f };
+    return true;
+}
+
+bool UI_GlyphMetrics(UIContext *ctx, uint32_t font, uint32_t codepoint, UIGlyphMetrics *metrics) {
+    (void)ctx;
+    (void)font;
+    uint32_t size = codepoint == ' ' ? 0 : 1;
+    *metrics = (UIGlyphMetrics) { .advance = 8.0f, .x = 1.0f, .y = -10.0f, .w = 6 * size, .h = 10 * size };
+    return true;
+}
+
+bool UI_GlyphRasterize(UIContext *ctx, uint32_t font, uint32_t codepoint, uint8_t *pixels, uint32_t pitch) {
+    (void)font;
+    (void)codepoint;
+    UINullBackend *backend = (UINullBackend *)ctx->userData;
+    backend->glyphsRasterized++;
+    for (uint32_t y = 0; y < 10; y++) {
+        for (uint32_t x = 0; x < 6; x++)
+            pixels[y * pitch + x] = 255;
+    }
+    return true;
+}
+
+#ifdef UI_THREADS
+
+void UI_RunTasks(UIContext *ctx, void (*task)(void *data, uint32_t index), void *data, uint32_t count) {
+    (void)ctx;
+    for (uint32_t i = 0; i < count; i++)
+        task(data, i);
+}
+
+#endif // !UI_THREADS
+
+#ifdef UI_STATS
+
+uint64_t UI_TimeNs(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+#endif // !UI_STATS
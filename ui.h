@@ -4,9 +4,31 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define UI_IMPLEMENTATION
-
+// Default maximum number of elements of a context, see `UIContext_SetMaxElements`
+#ifndef UI_MAX_ELEMENT_COUNT
 #define UI_MAX_ELEMENT_COUNT 8192
+#endif
+
+// Width and height in pixels of the glyph atlas of a context, it uses one byte per pixel
+#ifndef UI_ATLAS_SIZE
+#define UI_ATLAS_SIZE 1024
+#endif
+
+// Number of wrapped texts whose lines are kept by a context, a power of 2. The
+// texts used longest ago make room for new ones.
+#ifndef UI_TEXT_CACHE_SIZE
+#define UI_TEXT_CACHE_SIZE 1024
+#endif
+
+// Maximum number of damaged rectangles of a frame, see `UIContext_SetPartialRedraw`
+#ifndef UI_DAMAGE_RECTS
+#define UI_DAMAGE_RECTS 8
+#endif
+
+// Number of frames kept by the statistics, see `UIContext_StatsSummary`
+#ifndef UI_STATS_HISTORY
+#define UI_STATS_HISTORY 128
+#endif
 
 #define UI_RED (UIColor) { 255, 0, 0, 255 }
 #define UI_GREEN (UIColor) { 0, 255, 0, 255 }
@@ -35,10 +57,35 @@ typedef struct UIPadding {
 typedef struct UIContext UIContext;
 typedef struct UIElement UIElement;
 
+typedef struct UIFontMetrics {
+    float ascent; // From the top of a line to the baseline
+    float lineHeight;
+} UIFontMetrics;
+
+typedef struct UIGlyphMetrics {
+    float advance; // From the pen position to the next one
+    float x, y; // Top left corner of the bitmap from the pen position on the baseline
+    uint32_t w, h; // Size of the bitmap in pixels
+} UIGlyphMetrics;
+
+typedef struct UIText {
+    const char *str; // UTF-8, not copied, NULL for elements without text
+    uint32_t len;
+    uint32_t font;
+    UIColor color;
+    bool wrap; // Break the lines to fit the width of the element
+    uint32_t hash; // Of the bytes of wrapped text, computed when it is set
+} UIText;
+
+// The array comes from the size classes of the context, see `UI__CHILD_CLASSES`.
+// A removed child leaves NULL in its slot until the array is compacted, read
+// the children with `UIElement_Child` after removing some.
 typedef struct UI__Children {
     UIElement **data;
-    uint16_t len;
-    uint16_t cap;
+    uint32_t len; // Slots in use, holes included
+    uint32_t cap;
+    uint32_t start; // The slots before it are all holes
+    uint32_t holes;
 } UI__Children;
 
 typedef enum UILayoutDirection {
@@ -75,70 +122,575 @@ typedef struct UILayout {
     float h_min, h_max;
 } UILayout;
 
+// Handle of a layout interned on the context, see `UIContext_AddStyle`
+typedef uint32_t UIStyle;
+
+#define UI_DEFAULT_STYLE 0 // Layout of new elements
+
 struct UIElement {
-    UIRect box;
-    UILayout layout;
+    UIStyle _style; // Set by `UI_Style` and by the layout setters
     UIColor backgroundColor;
+    float scrollX, scrollY; // Subtracted from the position of the children
+    float contentW, contentH; // Size of the text before it is wrapped, inside the padding
+    bool clipChildren; // Children are only drawn inside the box of the element
+    bool _virtualRow; // Added and removed by the virtual list that created it
+    UIText text;
     UIElement *parent;
     UIContext *context;
     UI__Children children;
+    uint32_t _index; // Position of the element in the children of its parent
+    uint32_t _handle; // Position of the element in the layout tree
+    uint32_t _id; // Key in the id table, 0 for elements not created by `UI_Begin`
+    uint32_t _signature; // Hash of the layout of the element and of its descendants
 };
 
+#define UI__NO_HANDLE UINT32_MAX
+
+// Called for every shown row of a virtual list when it shows another index,
+// `row` keeps the children and layout left by the previous call
+typedef void (*UIVirtualRowFn)(UIElement *row, uint32_t index, void *userData);
+
+// State of an element made a list by `UI_VirtualList`, the shown rows are the
+// children of the element in order
+typedef struct UI__VirtualList {
+    struct UI__VirtualList *next; // Next list of the context
+    UIElement *element;
+    UIVirtualRowFn rowFn;
+    void *userData;
+    uint32_t rowCount;
+    float rowHeight;
+    double scrollY; // Distance from the top of the first row, floats are too short for long lists
+    uint32_t firstRow; // Index shown by the first child
+    UIElement **rows; // Every row created, the ones past the children are detached
+    uint32_t rowsLen;
+    uint32_t rowsCap;
+    bool refill; // Every shown row must be filled again
+} UI__VirtualList;
+
+typedef struct UI__Sizing {
+    float w_min, w_max;
+    float w_weight;
+    float h_min, h_max;
+    float h_weight;
+    // The height of a wrapped text is only kept here, it is broken again each
+    // time the row is written, before the heights are fit
+    float contentW, contentH;
+    uint8_t w_sizing;
+    uint8_t h_sizing;
+    uint8_t wrapText; // The height of the content depends on the width of the box
+} UI__Sizing;
+
+typedef struct UI__Spacing {
+    UIPadding padding;
+    UIPadding margin;
+    float childGap;
+    float scrollX, scrollY;
+    uint8_t direction;
+    uint8_t alignX;
+    uint8_t alignY;
+} UI__Spacing;
+
+typedef struct UI__Links {
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t childCount;
+} UI__Links;
+
+// The data used by the layout, stored as a structure of arrays indexed by the
+// handle of the elements. Handles are assigned in breadth-first order so that
+// the children of an element are contiguous and come after their parent.
+typedef struct UI__Tree {
+    uint32_t len;
+    uint32_t cap;
+    UIElement **elements;
+    uint64_t *fillEvents; // Two per row, used by the fill solver like `scratch`
+    UIRect *boxes;
+    UIRect *lastBoxes; // Boxes at the end of the last layout
+    UIRect *bounds; // Union of the boxes of the subtree that can be visible
+    UIRect *clips; // Area where the element is visible, set with `bounds` after a layout
+    UIRect *visible; // Part of the box inside the clip when the clips were last computed
+    UI__Sizing *sizing;
+    UI__Spacing *spacing;
+    UI__Links *links;
+    UIColor *colors;
+    float *childExtent; // Size of the children along the layout direction, set by the fit pass
+    uint32_t *scratch; // Fill children, each element uses the rows of its own children
+    uint32_t *drawOrder; // Handles in depth-first order, updated when the tree is rebuilt
+    uint32_t *drawEnd; // Index in `drawOrder` after the subtree of the element
+    uint8_t *dirty; // Set when the element or any of its descendants changed
+    uint8_t *clipChildren;
+} UI__Tree;
+
+// Fields of the children of an element along one axis, each one points to the
+// field of the first child in the rows of its array
+typedef struct UI__AxisColumns {
+    const float *size; // In `boxes`
+    const float *minSize; // In `sizing`
+    const uint8_t *sizing; // In `sizing`
+    const float *marginBefore; // In `spacing`
+    const float *marginAfter; // In `spacing`
+    uint32_t count;
+} UI__AxisColumns;
+
+typedef struct UIDrawCommand {
+    UIRect rect;
+    UIRect clip; // Only the part of `rect` inside `clip` is visible
+    UIRect src; // Area of the glyph atlas tinted by `color`, empty for solid rectangles
+    UIColor color;
+} UIDrawCommand;
+
+// Commands of a frame in drawing order, the memory is reused between frames
+typedef struct UIDrawList {
+    UIDrawCommand *data;
+    uint32_t len;
+    uint32_t cap;
+    // Rectangles of whole pixels that do not overlap, the commands are clipped
+    // to them. With `partial` the pixels outside of them must keep the last
+    // frame and the ones inside are cleared by the backend, otherwise there
+    // is a single rectangle with the whole window.
+    UIRect damage[UI_DAMAGE_RECTS];
+    uint32_t damageCount;
+    bool partial;
+} UIDrawList;
+
+// Atlas slots are squares of 8, 16, 32, 64, 128 and 256 pixels
+#define UI__ATLAS_CLASSES 6
+#define UI__ATLAS_MIN_SLOT 8u
+
+typedef struct UI__Glyph {
+    uint32_t font;
+    uint32_t codepoint; // UINT32_MAX for empty entries
+    UIGlyphMetrics metrics;
+    uint32_t slot; // UI__NO_HANDLE when the glyph is not in the atlas
+} UI__Glyph;
+
+typedef struct UI__AtlasSlot {
+    uint16_t x, y;
+    uint32_t glyph; // Index in the glyph table, UI__NO_HANDLE for free slots
+    uint32_t frame; // Last frame that drew the glyph
+    uint32_t sizeClass;
+    uint32_t prev, next; // In the list of the slots of the same size, most recently used first
+} UI__AtlasSlot;
+
+// Coverage of the glyphs drawn by a context. Glyphs are cached in square slots
+// laid out on shelves as tall as the slots. When there are no free slots of a
+// size and no room for a new shelf, the glyph used longest ago is evicted.
+typedef struct UIGlyphAtlas {
+    uint8_t *pixels; // UI_ATLAS_SIZE rows of UI_ATLAS_SIZE bytes, NULL until a glyph is drawn
+    UIRect dirty; // Pixels changed since the backend copied them, emptied by the backend
+    UIRect white; // Fully covered pixels, to draw solid rectangles with the atlas
+    uint32_t _frame; // Incremented by every frame that is drawn
+    uint32_t _shelfEnd; // Top of the space without shelves
+    UI__AtlasSlot *_slots;
+    uint32_t _slotCount;
+    uint32_t _slotCap;
+    uint32_t _first[UI__ATLAS_CLASSES]; // Most recently used slot of each size
+    uint32_t _last[UI__ATLAS_CLASSES];
+    UI__Glyph *_glyphs; // Metrics of every glyph measured, indexed by font and codepoint
+    uint32_t _glyphCap;
+    uint32_t _glyphLen;
+} UIGlyphAtlas;
+
+typedef struct UI__TextLine {
+    uint32_t begin, end; // Bytes of the line, without the spaces where it was broken
+    float width;
+} UI__TextLine;
+
+// Lines of a text broken to fit a width
+typedef struct UI__TextLayout {
+    const char *str; // Only compared, NULL for unused entries
+    uint32_t len;
+    uint32_t hash; // Of the text, the font and the width
+    uint32_t font;
+    float width; // Available width, UI__NO_WRAP breaks lines only at '\n'
+    float maxWidth; // Of the widest line
+    float height;
+    UI__TextLine *lines;
+    uint32_t lineCount;
+    uint32_t lineCap;
+    uint32_t chain; // Next layout of the same bucket
+    uint32_t prev, next; // In the list of the cache, most recently used first
+} UI__TextLayout;
+
+// `UI_TEXT_CACHE_SIZE` layouts found through chains from twice as many buckets
+// by their hash, the one used longest ago is broken again for a new text
+typedef struct UI__TextCache {
+    UI__TextLayout *layouts; // NULL until a text wraps
+    uint32_t *buckets; // First layout of each bucket, in the block of `layouts`
+    uint32_t first, last;
+} UI__TextCache;
+
+#define UI__POOL_MIN_SLAB 64
+#define UI__POOL_MAX_SLAB 16384
+#define UI__POOL_TRIMMED UINT32_MAX // Live count of the slabs freed by a trim
+
+// Children arrays of 2, 4, ... `UI__CHILD_MAX_CLASS` children come from one
+// pool per size, larger ones from `UI_MemAlloc`
+#define UI__CHILD_CLASSES 6
+#define UI__CHILD_MAX_CLASS (2 << (UI__CHILD_CLASSES - 1))
+
+// A contiguous block of buckets, followed by the buckets themselves
+typedef struct UI__PoolSlab {
+    struct UI__PoolSlab *next;
+    uint32_t cap;
+    uint32_t live; // Only valid when `epoch` matches the one of the allocator
+    uint32_t epoch;
+} UI__PoolSlab;
+
 typedef struct UI__PoolBucket {
-    struct UI__PoolBucket *next;
+    UI__PoolSlab *slab;
+    union {
+        struct UI__PoolBucket *next; // While the bucket is free
+        uint32_t epoch; // While the bucket is in use, epoch it was allocated in
+    } link;
 } UI__PoolBucket;
 
 typedef struct UIPoolAllocator {
     uint32_t elementSize;
-    uint32_t maxBucketCount;
-    uint32_t bucketCount;
-    UI__PoolBucket *firstBucket;
+    uint32_t bucketSize;
+    uint32_t maxBucketCount; // Zero for no limit
+    uint32_t bucketCount; // Number of buckets in use
+    uint32_t epoch; // Incremented on every reset
+    UI__PoolBucket *firstBucket; // First free bucket
+    UI__PoolSlab *firstSlab;
+    UI__PoolSlab *slab; // Slab new buckets are taken from
+    uint32_t slabUsed; // Number of buckets taken from `slab`
 } UIPoolAllocator;
 
+#define UI__ARENA_MIN_CHUNK 65536
+
+typedef struct UI__ArenaChunk {
+    struct UI__ArenaChunk *next;
+    uint32_t size; // Usable bytes after the header
+} UI__ArenaChunk;
+
+// A linear allocator, memory is only given back all at once
+typedef struct UIArena {
+    UI__ArenaChunk *firstChunk;
+    UI__ArenaChunk *chunk; // Chunk new allocations are taken from
+    uint32_t used; // Bytes taken from `chunk`
+} UIArena;
+
+typedef struct UI__IdEntry {
+    uint32_t key; // 0 for empty entries
+    uint32_t signature;
+    uint32_t frame; // Last frame the element was part of the tree
+    UIRect box;
+    float childExtent;
+} UI__IdEntry;
+
+#define UI__NO_STYLE UINT32_MAX
+#define UI__STYLE_PINNED 0x80000000u // Added to the references by `UIContext_AddStyle`
+
+typedef struct UI__Style {
+    UILayout layout;
+    uint32_t hash;
+    uint32_t refs; // Elements using the style
+    uint32_t next; // Next style of the same bucket or next free style
+} UI__Style;
+
+// Layouts of the elements, each different layout is stored once. Styles no
+// element uses are freed unless they are pinned.
+typedef struct UI__StyleTable {
+    UI__Style *styles;
+    uint32_t *buckets; // First style of each bucket by hash, UI__NO_STYLE when empty
+    uint32_t len; // Styles used or free
+    uint32_t cap;
+    uint32_t bucketCap; // Always a power of two
+    uint32_t count; // Styles used
+    uint32_t firstFree;
+} UI__StyleTable;
+
+#define UI_SNAPSHOT_VERSION 1
+#define UI__SNAPSHOT_MAGIC 0x4e534955u // "UISN" read as a little endian word
+#define UI__SNAPSHOT_BOXES 1u // The snapshot has the boxes of the last frame
+#define UI__SNAPSHOT_CLIP 1u
+#define UI__SNAPSHOT_WRAP 2u
+#define UI__NO_TEXT UINT32_MAX
+
+// A snapshot is the header followed by the styles as written by
+// `UI__LayoutWords`, the rows, their boxes when there are some and the texts.
+// Rows and styles refer to each other by index, the root is the first row and
+// the others follow in breadth-first order.
+typedef struct UI__SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t elementCount;
+    uint32_t styleCount;
+    uint32_t textSize; // Bytes of text, each text ends with '\0'
+    uint32_t windowW, windowH; // Size of the window the boxes were computed for
+} UI__SnapshotHeader;
+
+typedef struct UI__SnapshotElement {
+    uint32_t firstChild; // The children of a row are consecutive rows
+    uint32_t childCount;
+    uint32_t style;
+    UIColor backgroundColor;
+    float scrollX, scrollY;
+    float contentW, contentH; // Size of the text measured when it was written
+    uint32_t textOffset; // UI__NO_TEXT for rows without text
+    uint32_t textLen;
+    uint32_t font;
+    UIColor textColor;
+    uint32_t flags;
+} UI__SnapshotElement;
+
+typedef struct UI__SnapshotBox {
+    UIRect box;
+    float childExtent;
+} UI__SnapshotBox;
+
+// Open addressing hash table with the state of the elements of the last frame
+typedef struct UI__IdTable {
+    UI__IdEntry *entries;
+    uint32_t cap; // Always a power of two
+    uint32_t len;
+} UI__IdTable;
+
 // Errors
 
 typedef enum UIErrorKind {
     UIErrorKind_noError,
 
     UIErrorKind_outOfMemory,
+    UIErrorKind_tooManyElements,
+    UIErrorKind_invalidSnapshot,
 
     UI__ErrorKind_count
 } UIErrorKind;
 
-const char *UI_errorStr[UI__ErrorKind_count] = {
-    [UIErrorKind_noError] = "no error",
-    [UIErrorKind_outOfMemory] = "out of memory"
-};
+extern const char *UI_errorStr[UI__ErrorKind_count];
 
 typedef struct UIWindow {
     uint32_t w, h;
 } UIWindow;
 
+// Size of the smallest cells of the hit grid
+#define UI__HIT_CELL_SIZE 16.0f
+#define UI__HIT_MAX_LEVELS 16
+
+typedef struct UI__HitEntry {
+    uint32_t drawIndex;
+    UIRect rect; // Part of the box inside the clip of the element, empty once it moved
+} UI__HitEntry;
+
+typedef struct UI__HitMoved {
+    uint32_t drawIndex;
+    uint32_t next; // Handle of the next moved entry of the same cell, drawn before this one
+    UIRect rect;
+} UI__HitMoved;
+
+typedef struct UI__HitLevel {
+    float cellSize;
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t firstCell;
+} UI__HitLevel;
+
+// Grids of the elements drawn by the last frame, each level has cells twice
+// as large as the previous one. An element is in the cell of its top left
+// corner in the first level with cells at least as large as its visible box,
+// so it overlaps at most four cells of that level. Elements whose visible box
+// changes after the grid is built leave an empty entry and are listed by the
+// cell of their new box, until so many moved that the grid is built again.
+typedef struct UI__HitGrid {
+    UI__HitLevel levels[UI__HIT_MAX_LEVELS];
+    uint32_t levelCount;
+    uint32_t windowW, windowH; // Covered by the levels
+    uint32_t *cellStart; // Index of the first entry of each cell, and one past the last entry
+    uint32_t *cellMoved; // Handle of the last drawn moved entry of each cell, in the block of `cellStart`
+    uint32_t cellCap;
+    UI__HitEntry *entries; // Sorted by cell, then by draw index, elements that cannot be hit last
+    UI__HitMoved *moved; // Of each handle
+    uint32_t *entryOf; // Entry of each handle, `UI__NO_HANDLE` once it moved
+    uint32_t *cellOf; // Cell of each handle, `UI__NO_HANDLE` for elements that cannot be hit
+    uint32_t entryCap;
+    uint32_t movedCount;
+    bool dirty; // Set when the tree is rebuilt, the grid is built by the next query
+} UI__HitGrid;
+
+#ifdef UI_STATS
+
+typedef enum UIStatsTime {
+    UIStatsTime_rebuild, // Numbering the elements after the structure changed
+    UIStatsTime_fit,
+    UIStatsTime_fill,
+    UIStatsTime_position,
+    UIStatsTime_draw, // Building the draw list and `UI_DrawList`
+    UIStatsTime_frame, // The whole call to `UIContext_Draw`
+
+    UIStatsTime_count
+} UIStatsTime;
+
+// Counters of a single call to `UIContext_Draw`
+typedef struct UIFrameStats {
+    uint64_t timeNs[UIStatsTime_count];
+    uint32_t elementsLaidOut; // Elements the layout passes did not skip
+    uint32_t fillIterations; // Rounds of the fill loop, and minimums and maximums passed by the fill solver
+    uint32_t textLayouts; // Wrapped texts broken into lines, the ones found in the cache are not counted
+    uint32_t drawCommands; // 0 when the frame was not drawn
+    uint32_t drawCalls; // Reported by the backend, see `UIContext_StatsAddDrawCalls`
+    uint32_t allocs; // Calls to `UI_MemAlloc` and `UI_MemExpand` since the last frame, by any context
+    uint64_t allocBytes;
+    uint32_t liveElements;
+} UIFrameStats;
+
+typedef struct UIStatsSummary {
+    uint64_t minNs, avgNs, maxNs, p99Ns;
+} UIStatsSummary;
+
+typedef struct UIStats {
+    UIFrameStats frame; // The last frame
+    UIFrameStats _history[UI_STATS_HISTORY]; // Ring buffer of the last frames
+    uint32_t _historyLen;
+    uint32_t _historyNext;
+    uint64_t _allocs; // Value of the memory counters at the end of the last frame
+    uint64_t _allocBytes;
+} UIStats;
+
+#endif // !UI_STATS
+
+#ifdef UI_THREADS
+
+// A range of `drawOrder` made of whole subtrees with the same parent
+typedef struct UI__LayoutTask {
+    uint32_t begin;
+    uint32_t end;
+    bool moved; // Set by the position pass if any box in the range changed
+    uint32_t laidOut; // Set by the fit pass
+    uint32_t fillIterations; // Set by the fill pass
+} UI__LayoutTask;
+
+typedef struct UI__LayoutPlan {
+    UI__LayoutTask *tasks;
+    uint32_t taskCount;
+    uint32_t taskCap;
+    uint32_t *serialRows; // Rows laid out on the calling thread, in breadth-first order
+    uint32_t serialCount;
+    uint32_t rowCap;
+    bool dirty; // Set when the tree is rebuilt
+} UI__LayoutPlan;
+
+typedef enum UI__LayoutPass {
+    UI__LayoutPass_fitWidth,
+    UI__LayoutPass_fillWidth,
+    UI__LayoutPass_fitHeight,
+    UI__LayoutPass_fillHeight,
+    UI__LayoutPass_position
+} UI__LayoutPass;
+
+typedef struct UI__LayoutJob {
+    UI__Tree *tree;
+    UI__LayoutPlan *plan;
+    UI__LayoutPass pass;
+} UI__LayoutJob;
+
+#endif // !UI_THREADS
+
 struct UIContext {
     void *userData;
     UIWindow window;
     UIElement *root;
     UIPoolAllocator _elementAllocator;
-    UI__Children _fillChildren; // Used to store children that are set to fill
+    UIPoolAllocator _childAllocators[UI__CHILD_CLASSES]; // Children arrays by size class
+    UIArena _frameArena;
+    bool _useFrameArena; // Elements and children arrays are allocated in `_frameArena`
+    uint32_t _frameElementCount;
+    uint32_t _frame; // Incremented by `UIContext_BeginFrame`
+    UIElement *_current; // Element opened by the last call to `UI_Begin`
+    uint32_t _failedDepth; // Number of nested `UI_Begin` calls that failed
+    UI__IdTable _idTable;
+    UI__StyleTable _styles;
+    UI__Tree _tree;
+    UI__Tree _backTree; // Filled when the tree is rebuilt and then swapped with `_tree`
+    UIDrawList drawList;
+    UI__VirtualList *_virtualLists;
+    UI__HitGrid _hitGrid;
+    UIGlyphAtlas atlas;
+    UI__TextCache _textCache;
+    bool _hasWrappedText; // Set by the first text that wraps, the layout looks for them only then
+#ifdef UI_THREADS
+    uint32_t _taskMinSize; // 0 when the layout runs on the calling thread
+    UI__LayoutPlan _layoutPlan;
+#endif
+    bool _structureDirty; // Set when elements are added or removed
+    bool _redraw; // Set when the next frame may differ from the last one drawn
+    bool _clipsDirty; // Set when the bounds and clips of the tree must be computed again
+    bool _partialRedraw;
+    UIRect _damage[UI_DAMAGE_RECTS]; // Damaged since the last frame drawn, only with `_partialRedraw`
+    uint32_t _damageCount;
     UIErrorKind errorKind;
+#ifdef UI_STATS
+    UIStats stats;
+#endif
 };
 
 // Pool allocator functions
 
-// Initialize a pool allocator
+// Initialize a pool allocator, `maxBuckets` is the maximum number of live items or 0
 void UIPoolAllocatorInit(UIPoolAllocator *allocator, uint32_t elemSize, uint32_t maxBuckets);
-// Free all memory associated with `allocator`
+// Free all memory associated with `allocator`, including the items still in use
 void UIPoolAllocatorDestroy(UIPoolAllocator *allocator);
 
 // Allocate an item in a pool allocator
 void *UIPoolAllocatorAlloc(UIPoolAllocator *allocator);
-// Free an item allocated with `UIPoolAllocatorAlloc`
+// Free an item allocated with `UIPoolAllocatorAlloc`. An item allocated before
+// the last reset was already freed by it and is ignored, but only until an
+// allocation takes its place or a trim frees its slab: after that the pointer
+// must not be freed anymore.
 void UIPoolAllocatorFree(UIPoolAllocator *allocator, void *data);
+// Free all the items at once, the memory is kept for new allocations
+void UIPoolAllocatorReset(UIPoolAllocator *allocator);
+// Give the slabs that have no items in use back with `UI_MemFree`. The slabs of
+// items allocated before the last reset are empty, so those pointers must not
+// be passed to `UIPoolAllocatorFree` after a trim.
+void UIPoolAllocatorTrim(UIPoolAllocator *allocator);
+
+// Arena functions
+
+// Initialize an arena
+void UIArenaInit(UIArena *arena);
+// Free all memory associated with `arena`
+void UIArenaDestroy(UIArena *arena);
+
+// Allocate `size` bytes aligned to 8 bytes
+void *UIArenaAlloc(UIArena *arena, uint32_t size);
+// Free all the allocations at once, the memory is kept for new allocations
+void UIArenaReset(UIArena *arena);
 
 // Context management functions
 
 // Initialize a context
 bool UIContext_Init(UIContext *ctx, void *userData);
+// Free all memory associated with a context, including its elements
+void UIContext_Destroy(UIContext *ctx);
+// Set the maximum number of elements of a context, 0 means no limit
+void UIContext_SetMaxElements(UIContext *ctx, uint32_t maxElements);
+// Allocate the elements of the context in an arena that is cleared by
+// `UIContext_BeginFrame`, call before adding any element
+void UIContext_UseFrameArena(UIContext *ctx);
+// Remove all the elements but the root to build the tree of a new frame, only
+// for contexts that use the frame arena
+void UIContext_BeginFrame(UIContext *ctx);
+
+#ifdef UI_THREADS
+// Lay out groups of sibling subtrees with at least `minTaskSize` elements as
+// separate tasks passed to `UI_RunTasks`, 0 lays out the whole tree on the
+// calling thread. The boxes are the same in both cases.
+void UIContext_SetParallelLayout(UIContext *ctx, uint32_t minTaskSize);
+#endif
+
+#ifdef UI_STATS
+// Reset the statistics, including the history
+void UIContext_StatsReset(UIContext *ctx);
+// Add the calls made to the renderer while drawing the current frame, called by
+// the backend inside `UI_DrawList`
+void UIContext_StatsAddDrawCalls(UIContext *ctx, uint32_t drawCalls);
+// Get the minimum, average, maximum and 99th percentile of `time` over the
+// last `UI_STATS_HISTORY` frames
+UIStatsSummary UIContext_StatsSummary(UIContext *ctx, UIStatsTime time);
+#endif
 
 // Get the error kind
 UIErrorKind UI_ErrorGetKind(UIContext *ctx);
@@ -148,13 +700,91 @@ const char *UI_ErrorGetStr(UIContext *ctx);
 // Update functions
 
 void UIContext_UpdateWindow(UIContext *ctx, uint32_t width, uint32_t height);
+// Check if the next call to `UIContext_Draw` would draw a different frame
+bool UIContext_NeedsRedraw(UIContext *ctx);
+// Make the next call to `UIContext_Draw` draw the whole window even if nothing changed
+void UIContext_ForceRedraw(UIContext *ctx);
+// Draw only the parts of the window changed since the last frame, the backend
+// must keep the pixels outside the damage of the draw list. Frames that are
+// the same as the last one pass an empty draw list to present it again.
+void UIContext_SetPartialRedraw(UIContext *ctx, bool partial);
+// Draw the frame, nothing is drawn if it is the same as the last one
 bool UIContext_Draw(UIContext *ctx);
 
+// Hit testing functions, they use the boxes of the last frame drawn or of the
+// last layout when the tree was rebuilt since, by taking a snapshot
+
+// Get the topmost element at `x`, `y` that is not clipped, elements with a
+// transparent background can be hit too. NULL if there is none.
+UIElement *UI_HitTest(UIContext *ctx, float x, float y);
+// Get the elements that overlap `rect` and are not clipped, in no particular
+// order. At most `cap` are written to `elements`, all of them are counted.
+uint32_t UI_QueryRect(UIContext *ctx, UIRect rect, UIElement **elements, uint32_t cap);
+
 // Element management functions
 
 UIElement *UIElement_New(UIElement *parent);
+// Make room for `count` children of `element` so that adding them does not
+// grow its array again
+bool UIElement_ReserveChildren(UIElement *element, uint32_t count);
+// Get the number of children of `element`
+uint32_t UIElement_ChildCount(UIElement *element);
+// Get the child of `element` at `index`, or NULL past the last child. Children
+// removed from the first or the last position are skipped at once, the holes
+// left by children removed elsewhere are closed by the first call.
+UIElement *UIElement_Child(UIElement *element, uint32_t index);
+// Remove `element` from its parent and free it with its descendants, pointers
+// to them must not be used anymore. The root and the rows of virtual lists are
+// left alone, virtual lists inside the subtree are freed with their rows.
+// The siblings keep their slots, the hole is closed when the tree is rebuilt
+// or the array is full.
+void UIElement_Destroy(UIElement *element);
+// Move `element` and its descendants after the last child of `parent`. Fails
+// if `parent` is inside the subtree of `element` or the memory runs out. The
+// old siblings keep their slots, like in `UIElement_Destroy`.
+bool UIElement_SetParent(UIElement *element, UIElement *parent);
+// Move `element` to `index` in the children of its parent, the siblings in
+// between shift by one. An index past the last child moves it to the end.
+void UIElement_SetIndex(UIElement *element, uint32_t index);
+// Get the box of `element` computed by the last call to `UIContext_Draw`
+UIRect UIElement_Box(UIElement *element);
+// Get the layout of `element`, valid until the next style is added
+const UILayout *UIElement_Layout(UIElement *element);
+
+// Style functions, a style is a layout shared by the elements that use it
+
+// Intern `layout` on the context, the same layout always gives the same style.
+// The style stays valid until the context is destroyed, UI_DEFAULT_STYLE is
+// returned when the memory runs out.
+UIStyle UIContext_AddStyle(UIContext *ctx, const UILayout *layout);
+// Give `element` the layout of `style`, the layout setters then change the
+// layout of this element only
+void UI_Style(UIElement *element, UIStyle style);
+
+// Snapshot functions, a snapshot is the tree of a context in a buffer that can
+// be saved to a file and mapped back. The rows are numbered, so the buffer is
+// read where it is without changes. Snapshots are read by the same version of
+// the library on machines with the same byte order.
+
+// Get the size of the snapshot of `ctx`, with the boxes of its layout when
+// `boxes` is set. The tree is laid out first. 0 when the memory runs out.
+uint32_t UIContext_SnapshotSize(UIContext *ctx, bool boxes);
+// Write the snapshot of `ctx` to `buffer` of `size` bytes, aligned to 4 bytes.
+// Fails if it is too small. The shown rows of virtual lists are written as
+// plain elements.
+bool UIContext_WriteSnapshot(UIContext *ctx, void *buffer, uint32_t size, bool boxes);
+// Add the elements of a snapshot to the root of `ctx`, which must not have
+// children, and give the root its style. The texts point into `data`, which
+// must stay valid and unchanged while they are used. The boxes are used when
+// the window has the size it had when they were written, the next frame is
+// then drawn without a layout.
+bool UIContext_LoadSnapshot(UIContext *ctx, const void *data, uint32_t size);
 
 void UI_BackgroundColor(UIElement *element, UIColor color);
+// Draw the children and their descendants only inside the box of `element`
+void UI_ClipChildren(UIElement *element, bool clip);
+// Move the children of `element` up by `y` and left by `x`
+void UI_Scroll(UIElement *element, float x, float y);
 
 void UI_FitWidth(UIElement *element);
 void UI_FitHeight(UIElement *element);
@@ -179,10 +809,48 @@ void UI_AlignY(UIElement *element, UIAlignY align);
 
 void UI_LayoutDirection(UIElement *element, UILayoutDirection direction);
 
+// Draw `text` inside the padding of `element` with a font of the backend, fit
+// elements take the size of a line of text. The text is aligned like the
+// children and must stay valid until it is changed, NULL removes it.
+void UI_Text(UIElement *element, const char *text, uint32_t font, UIColor color);
+// Break the text of `element` into lines at spaces and '\n' to fit its width,
+// the height of fit elements is then the height of the lines. Fit widths use
+// the longest line without breaks. The bytes of wrapped text are hashed when it
+// is set, so call `UI_Text` again after changing them in place.
+void UI_TextWrap(UIElement *element, bool wrap);
+
+// Virtual list functions, not available for contexts that use the frame arena
+
+// Make `element` a list of `rowCount` rows of height `rowHeight`, only the rows
+// inside its box are elements. `UIContext_Draw` calls `rowFn` to fill a row
+// when it shows another index. The height of the list must not depend on its
+// children, which are managed by it. Calling this again fills all the shown
+// rows again.
+bool UI_VirtualList(UIElement *element, uint32_t rowCount, float rowHeight, UIVirtualRowFn rowFn, void *userData);
+// Scroll a virtual list by `y` from the top of its first row, the offset is
+// clamped to the rows by `UIContext_Draw`
+void UI_VirtualListScroll(UIElement *element, double y);
+// Get the offset of a virtual list from the top of its first row
+double UI_VirtualListScrollY(UIElement *element);
+
+// Immediate mode functions, for contexts that use the frame arena
+
+// Get the id of a string
+uint32_t UI_Id(const char *str);
+// Combine an id with an index, to tell apart elements created in a loop
+uint32_t UI_IdIndex(uint32_t id, uint32_t index);
+// Open a new element as a child of the last open one, or of the root. The id
+// must be unique among the siblings and the element must be closed with `UI_End`.
+// Elements with the same id and layout as in the last frame reuse its layout.
+UIElement *UI_Begin(UIContext *ctx, uint32_t id);
+// Close the element opened by the last `UI_Begin`
+void UI_End(UIContext *ctx);
+
 // Utility functions
 
 float UI_fmax2(float a, float b);
 float UI_fmax3(float a, float b, float c);
+float UI_fmin2(float a, float b);
 
 // Implementation specific functions
 
@@ -191,90 +859,479 @@ void *UI_MemExpand(void *block, uint32_t size);
 void *UI_MemShrink(void *block, uint32_t size);
 void UI_MemFree(void *block);
 
-bool UI_DrawRect(UIContext *ctx, UIRect rect, UIColor color);
+// Draw all the commands in `list`, in order. Commands with a `src` copy it
+// from `ctx->atlas`, the pixels in `ctx->atlas.dirty` changed since the last list.
+bool UI_DrawList(UIContext *ctx, const UIDrawList *list);
+
+// Get the metrics of a font of the backend
+bool UI_FontMetrics(UIContext *ctx, uint32_t font, UIFontMetrics *metrics);
+// Get the metrics of the glyph of `codepoint`, it may be empty
+bool UI_GlyphMetrics(UIContext *ctx, uint32_t font, uint32_t codepoint, UIGlyphMetrics *metrics);
+// Write the coverage of a glyph, rows of `metrics.w` bytes `pitch` bytes apart
+bool UI_GlyphRasterize(UIContext *ctx, uint32_t font, uint32_t codepoint, uint8_t *pixels, uint32_t pitch);
+
+#ifdef UI_THREADS
+// Call `task` once for every index below `count`, from any thread, and return
+// when all the calls returned
+void UI_RunTasks(UIContext *ctx, void (*task)(void *data, uint32_t index), void *data, uint32_t count);
+#endif
+
+#ifdef UI_STATS
+// Current time in nanoseconds from any fixed point
+uint64_t UI_TimeNs(void);
+#endif
 
 #ifdef UI_IMPLEMENTATION
 
+// The SSE2 kernels are used when the target has them, define UI_NO_SIMD to
+// always use the scalar ones
+#if !defined(UI_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define UI__SSE2
+#include <emmintrin.h>
+#endif
+
+// Containers with fewer children use the scalar kernels
+#define UI__SIMD_MIN_CHILDREN 16
+// Ranges of fill events sorted by insertion
+#define UI__FILL_SORT_MIN 16
+// Rounds of the fill loop before the solver shares what is left
+#define UI__FILL_MAX_ROUNDS 16
+
+#include <float.h>
+#define UI__NO_WRAP FLT_MAX
+
+#define UI__BOX_COLUMN(column, i) (*(const float *)((const uint8_t *)(column) + sizeof(UIRect) * (i)))
+#define UI__SIZING_COLUMN(column, type, i) (*(const type *)((const uint8_t *)(column) + sizeof(UI__Sizing) * (i)))
+#define UI__SPACING_COLUMN(column, i) (*(const float *)((const uint8_t *)(column) + sizeof(UI__Spacing) * (i)))
+
+// Time the sections of a frame, nothing is measured without UI_STATS
+#ifdef UI_STATS
+#define UI__STATS_START(lap) uint64_t lap = UI_TimeNs()
+#define UI__STATS_LAP(ctx, time, lap) UI__StatsLap((ctx), (time), &(lap))
+#define UI__STATS_ADD(ctx, field, value) ((ctx)->stats.frame.field += (value))
+#else
+#define UI__STATS_START(lap) ((void)0)
+#define UI__STATS_LAP(ctx, time, lap) ((void)0)
+#define UI__STATS_ADD(ctx, field, value) ((void)(value))
+#endif
+
+UI__PoolBucket *UI__PoolSlabBucket(UIPoolAllocator *allocator, UI__PoolSlab *slab, uint32_t index);
+
 UIElement *UI__Context_AllocElement(UIContext *ctx);
 void UI__Context_FreeElement(UIContext *ctx, UIElement *element);
 void UI__ErrorSet(UIContext *ctx, UIErrorKind errorKind);
+void UI__ElementMarkDirty(UIElement *element);
+bool UI__PaddingEq(UIPadding a, UIPadding b);
+
+bool UI__DrawListPush(UIContext *ctx, UIRect rect, UIColor color, UIRect clip, UIRect src);
 
 bool UI__ChildrenAppend(UI__Children *children, UIElement *child);
+bool UI__ChildrenGrow(UIContext *ctx, UI__Children *children, uint32_t cap);
+uint32_t UI__ChildrenClass(uint32_t cap);
+void UI__ContextFreeChildren(UIContext *ctx, UI__Children *children);
 void UI__ChildrenRemoveSwap(UI__Children *children, uint32_t index);
-void UI__ChildrenRemoveShift(UI__Children *children, uint32_t index);
+void UI__ChildrenRemove(UI__Children *children, uint32_t index);
+void UI__ChildrenCompact(UI__Children *children);
 
 bool UI__Element_AddChild(UIElement *parent, UIElement *child);
 void UI__Element_RemoveChild(UIElement *child);
+bool UI__ElementIsInside(UIElement *element, UIElement *ancestor);
+
+uint32_t UI__ElementHandle(UIElement *element);
+void UI__ElementFreeChildren(UIElement *element);
+void UI__ElementFreeSubtree(UIElement *element);
+void UI__ElementSetScroll(UIElement *element, float x, float y);
+
+UI__VirtualList *UI__ContextFindVirtualList(UIContext *ctx, UIElement *element);
+bool UI__ContextShowVirtualRows(UIContext *ctx, bool *changed);
+bool UI__VirtualListShowRows(UI__VirtualList *list, bool *changed);
+bool UI__VirtualListAddRows(UI__VirtualList *list, uint32_t count);
+
+bool UI__TreeReserve(UI__Tree *tree, uint32_t count);
+void UI__TreeWriteElement(UI__Tree *tree, uint32_t handle, UIElement *element);
+bool UI__ContextUpdateTree(UIContext *ctx);
+bool UI__ContextRebuildTree(UIContext *ctx);
+void UI__TreeSortDrawOrder(UI__Tree *tree);
+
+float UI__TreeChildWidth(UI__Tree *tree, uint32_t handle);
+float UI__TreeChildHeight(UI__Tree *tree, uint32_t handle);
+float UI__TreeChildMaxWidth(UI__Tree *tree, uint32_t handle);
+float UI__TreeChildMaxHeight(UI__Tree *tree, uint32_t handle);
+
+bool UI__ContextLayout(UIContext *ctx);
+
+uint32_t UI__TreeFit(UI__Tree *tree);
+uint32_t UI__TreeFitWidths(UI__Tree *tree);
+void UI__TreeFitHeights(UI__Tree *tree);
+void UI__TreeFitElementWidth(UI__Tree *tree, uint32_t handle);
+void UI__TreeFitElementHeight(UI__Tree *tree, uint32_t handle);
+void UI__TreeFitWidth(UI__Tree *tree, uint32_t handle);
+void UI__TreeFitHeight(UI__Tree *tree, uint32_t handle);
+
+uint32_t UI__TreeFillWidths(UI__Tree *tree);
+uint32_t UI__TreeFillHeights(UI__Tree *tree);
+uint32_t UI__TreeFillElementWidth(UI__Tree *tree, uint32_t handle);
+uint32_t UI__TreeFillElementHeight(UI__Tree *tree, uint32_t handle);
+uint32_t UI__TreeFillWidth(UI__Tree *tree, uint32_t handle);
+uint32_t UI__TreeFillHeight(UI__Tree *tree, uint32_t handle);
+
+bool UI__ContextWrapText(UIContext *ctx);
+
+bool UI__TreePosition(UI__Tree *tree);
+bool UI__TreePositionElement(UI__Tree *tree, uint32_t handle);
+void UI__TreePositionX(UI__Tree *tree, uint32_t handle);
+void UI__TreePositionY(UI__Tree *tree, uint32_t handle);
+
+void UI__TreeSetW(UI__Tree *tree, uint32_t handle, float w);
+void UI__TreeSetH(UI__Tree *tree, uint32_t handle, float h);
+
+UI__AxisColumns UI__TreeColumnsX(UI__Tree *tree, uint32_t handle);
+UI__AxisColumns UI__TreeColumnsY(UI__Tree *tree, uint32_t handle);
+float UI__ColumnsSum(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap);
+float UI__ColumnsMax(UI__AxisColumns *columns, float paddingBefore, float paddingAfter);
+// Clamp the fill children in `handles` whose share of `space` breaks their
+// minimum or their maximum, take them out of `handles` and their size out of
+// `space`, in rounds until one clamps none. Return false if they still break
+// a limit after `UI__FILL_MAX_ROUNDS` rounds.
+bool UI__FillRounds(
+    float *size, const float *weight, const float *min, const float *max,
+    uint32_t *handles, uint32_t *count, float *space, float *totalWeight, uint32_t *iterations);
+// Return the share of one unit of weight where the fill children in `handles`,
+// clamped to their minimum and maximum, add up to `space`. The shares where the
+// children leave their minimum or reach their maximum are sorted in `events`,
+// which has room for two per child, and passed once in order.
+float UI__FillSolve(
+    const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint64_t *events, uint32_t count, float space, uint32_t *iterations);
+void UI__FillSort(uint64_t *events, uint32_t count);
+void UI__FillQuickSort(uint64_t *events, uint32_t count, uint32_t depth);
+void UI__FillHeapSort(uint64_t *events, uint32_t count);
+void UI__FillSiftDown(uint64_t *events, uint32_t i, uint32_t count);
+float UI__FillKey(const float *bound, const float *weight, uint32_t handle);
+uint64_t UI__FillEvent(float key, uint32_t handle);
+float UI__FillEventKey(uint64_t event);
+// Set the size of the fill children in `handles` to their share of `space`,
+// `size` points to the box of the first row and the other pointers to the sizing
+void UI__FillExpand(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight);
+float UI__ColumnsSumScalar(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap);
+float UI__ColumnsMaxScalar(UI__AxisColumns *columns, float paddingBefore, float paddingAfter);
+void UI__FillExpandScalar(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight);
+#ifdef UI__SSE2
+__m128 UI__ColumnsSizeSSE2(UI__AxisColumns *columns, uint32_t i);
+__m128 UI__SpacingColumnSSE2(const float *column, uint32_t i);
+float UI__ColumnsSumSSE2(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap);
+float UI__ColumnsMaxSSE2(UI__AxisColumns *columns, float paddingBefore, float paddingAfter);
+void UI__FillExpandSSE2(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight);
+#endif
+
+void UI__TreeClip(UI__Tree *tree, UIRect window);
+bool UI__TreeDraw(UIContext *ctx);
+bool UI__TreeDrawsElement(UI__Tree *tree, uint32_t handle);
+void UI__ContextDamageVisible(UIContext *ctx);
+void UI__ContextDamage(UIContext *ctx, UIRect rect);
+void UI__ContextTakeDamage(UIContext *ctx);
+void UI__ElementDamage(UIElement *element);
+
+bool UI__DrawText(UIContext *ctx, uint32_t handle, UIRect clip);
+bool UI__TextMeasure(UIContext *ctx, UIText *text, float *w, float *h);
+void UI__ElementMeasureText(UIElement *element);
+UI__TextLayout *UI__ContextTextLayout(UIContext *ctx, UIText *text, float width);
+bool UI__TextBreakLines(UIContext *ctx, UIText *text, float width, UI__TextLayout *layout);
+bool UI__TextLayoutPush(UIContext *ctx, UI__TextLayout *layout, uint32_t begin, uint32_t end, float width);
+bool UI__TextCacheInit(UIContext *ctx);
+void UI__TextCacheTouch(UI__TextCache *cache, uint32_t index);
+void UI__ContextFreeTextLayouts(UIContext *ctx);
+uint32_t UI__Utf8Next(const char *str, uint32_t len, uint32_t *i);
+
+void UI__AtlasDestroy(UIGlyphAtlas *atlas);
+uint32_t UI__AtlasGlyph(UIContext *ctx, uint32_t font, uint32_t codepoint);
+bool UI__AtlasGlyphsResize(UIContext *ctx, uint32_t cap);
+bool UI__AtlasInit(UIContext *ctx);
+bool UI__AtlasAddShelf(UIContext *ctx, uint32_t sizeClass);
+bool UI__AtlasPlace(UIContext *ctx, uint32_t glyph);
+void UI__AtlasUnlink(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot);
+void UI__AtlasPushFront(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot);
+void UI__AtlasPushBack(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot);
+
+bool UI__ContextBuildHitGrid(UIContext *ctx);
+uint32_t UI__HitGridCellOf(UI__HitGrid *grid, UIRect rect);
+void UI__HitGridMove(UI__HitGrid *grid, uint32_t handle, UIRect rect);
+uint32_t UI__HitGridCell(float coord, float cellSize, uint32_t count);
+UIRect UI__RectUnion(UIRect a, UIRect b);
+UIRect UI__RectIntersect(UIRect a, UIRect b);
+// Check if the intersection of `a` and `b` is not empty
+bool UI__RectOverlaps(UIRect a, UIRect b);
+float UI__RectArea(UIRect rect);
+
+#ifdef UI_THREADS
+bool UI__ContextPlanLayout(UIContext *ctx);
+bool UI__LayoutPlanPush(UIContext *ctx, UI__LayoutTask task);
+bool UI__ContextLayoutTasks(UIContext *ctx);
+void UI__LayoutTaskRun(void *data, uint32_t index);
+#endif
+
+uint32_t UI__HashU32(uint32_t hash, uint32_t value);
+uint32_t UI__HashF32(uint32_t hash, float value);
+uint32_t UI__HashBytes(const char *bytes, uint32_t len);
+
+bool UI__StyleTableInit(UIContext *ctx);
+void UI__StyleTableDestroy(UI__StyleTable *table);
+uint32_t UI__StyleTableIntern(UIContext *ctx, const UILayout *layout);
+bool UI__StyleTableGrow(UIContext *ctx);
+void UI__StyleTableRelease(UI__StyleTable *table, uint32_t style);
+void UI__StyleTableCollect(UIContext *ctx);
+void UI__LayoutWords(const UILayout *layout, uint32_t *words);
+uint32_t UI__HashLayout(const uint32_t *words);
+void UI__ElementSetStyle(UIElement *element, uint32_t style);
+void UI__ElementSetLayout(UIElement *element, const UILayout *layout);
+
+void UI__LayoutFromWords(const uint32_t *words, UILayout *layout);
+uint32_t *UI__ContextSnapshotHeader(UIContext *ctx, bool boxes, UI__SnapshotHeader *header);
+uint32_t UI__SnapshotSize(const UI__SnapshotHeader *header);
+void UI__SnapshotApply(UIElement *element, const UI__SnapshotElement *row, const uint32_t *styleMap, const char *text);
+bool UI__SnapshotCheck(const void *data, uint32_t size);
+bool UI__SnapshotCheckStyle(const uint32_t *words);
+UI__IdEntry *UI__IdTableFind(UI__IdTable *table, uint32_t key);
+UI__IdEntry *UI__IdTableInsert(UIContext *ctx, uint32_t key);
+bool UI__IdTableResize(UIContext *ctx, uint32_t cap);
+bool UI__ElementReuseLayout(UIElement *element, UIRect *box, float *childExtent);
+void UI__ContextSaveIdBoxes(UIContext *ctx);
+
+// Call `UI_MemAlloc` and `UI_MemExpand`, counting the calls with UI_STATS
+void *UI__MemAlloc(uint32_t size);
+void *UI__MemExpand(void *block, uint32_t size);
+void UI__MemCopy(void *dst, const void *src, uint32_t size);
+
+#ifdef UI_STATS
+void UI__StatsLap(UIContext *ctx, UIStatsTime time, uint64_t *lap);
+void UI__StatsEndFrame(UIContext *ctx);
+
+// Calls of the memory functions made by the library, owned by the translation
+// unit that defines UI_IMPLEMENTATION
+typedef struct UI__MemCounters {
+    uint64_t allocs;
+    uint64_t bytes;
+} UI__MemCounters;
+
+UI__MemCounters UI__memCounters = { 0, 0 };
+#endif
 
-float UI__ElementChildWidth(UIElement *element);
-float UI__ElementChildHeight(UIElement *element);
-float UI__ElementChildMaxWidth(UIElement *element);
-float UI__ElementChildMaxHeight(UIElement *element);
-
-void UI__ElementFitSize(UIElement *element);
-void UI__ElementFitWidth(UIElement *element);
-void UI__ElementFitHeight(UIElement *element);
-
-bool UI__ElementFillSize(UIElement *element);
-bool UI__ElementFillWidth(UIElement *element);
-bool UI__ElementFillHeight(UIElement *element);
-
-void UI__ElementPosition(UIElement *element);
-void UI__ElementPositionX(UIElement *element);
-void UI__ElementPositionY(UIElement *element);
-
-void UI__ElementSetW(UIElement *element, float w);
-void UI__ElementSetH(UIElement *element, float h);
-void UI__ElementSetX(UIElement *element, float x);
-void UI__ElementSetY(UIElement *element, float y);
-
-bool UI__ElementDraw(UIElement *element);
+const char *UI_errorStr[UI__ErrorKind_count] = {
+    [UIErrorKind_noError] = "no error",
+    [UIErrorKind_outOfMemory] = "out of memory",
+    [UIErrorKind_tooManyElements] = "too many elements",
+    [UIErrorKind_invalidSnapshot] = "invalid snapshot"
+};
 
 void UIPoolAllocatorInit(UIPoolAllocator *allocator, uint32_t elemSize, uint32_t maxBuckets) {
     allocator->bucketCount = 0;
     allocator->maxBucketCount = maxBuckets;
     allocator->elementSize = elemSize;
+    // Keep the buckets aligned to pointers
+    allocator->bucketSize = (sizeof(UI__PoolBucket) + elemSize + 7) & ~(uint32_t)7;
+    allocator->epoch = 0;
     allocator->firstBucket = NULL;
+    allocator->firstSlab = NULL;
+    allocator->slab = NULL;
+    allocator->slabUsed = 0;
 }
 
 void UIPoolAllocatorDestroy(UIPoolAllocator *allocator) {
-    UI__PoolBucket *bucket = allocator->firstBucket;
-    while (bucket != NULL) {
-        UI__PoolBucket *nextBucket = bucket->next;
-        UI_MemFree(bucket);
-        bucket = nextBucket;
+    UI__PoolSlab *slab = allocator->firstSlab;
+    while (slab != NULL) {
+        UI__PoolSlab *nextSlab = slab->next;
+        UI_MemFree(slab);
+        slab = nextSlab;
     }
+    UIPoolAllocatorInit(allocator, allocator->elementSize, allocator->maxBucketCount);
 }
 
-void *UIPoolAllocatorAlloc(UIPoolAllocator *allocator) {
-    if (allocator->firstBucket != NULL) {
-        UI__PoolBucket *bucket = allocator->firstBucket;
-        allocator->firstBucket = bucket->next;
-        bucket->next = NULL;
-        return (void *)(bucket + 1);
-    }
+UI__PoolBucket *UI__PoolSlabBucket(UIPoolAllocator *allocator, UI__PoolSlab *slab, uint32_t index) {
+    uint8_t *buckets = (uint8_t *)slab + ((sizeof(UI__PoolSlab) + 7) & ~(uint32_t)7);
+    return (UI__PoolBucket *)(buckets + allocator->bucketSize * index);
+}
 
-    UI__PoolBucket *newBucket = UI_MemAlloc(sizeof(UI__PoolBucket) + allocator->elementSize);
-    if (newBucket == NULL)
+void *UIPoolAllocatorAlloc(UIPoolAllocator *allocator) {
+    if (allocator->maxBucketCount != 0 && allocator->bucketCount >= allocator->maxBucketCount)
         return NULL;
 
-    newBucket->next = NULL;
-    return (void *)(newBucket + 1);
+    UI__PoolBucket *bucket = allocator->firstBucket;
+    if (bucket != NULL)
+        allocator->firstBucket = bucket->link.next;
+    else {
+        UI__PoolSlab *slab = allocator->slab;
+        // Move to the next slab, reusing the ones kept by a reset
+        if (slab == NULL || allocator->slabUsed == slab->cap) {
+            UI__PoolSlab *next = slab == NULL ? allocator->firstSlab : slab->next;
+            if (next == NULL) {
+                uint32_t cap = slab == NULL ? UI__POOL_MIN_SLAB : slab->cap * 2;
+                if (cap > UI__POOL_MAX_SLAB)
+                    cap = UI__POOL_MAX_SLAB;
+                next = (UI__PoolSlab *)UI__MemAlloc(
+                    ((sizeof(UI__PoolSlab) + 7) & ~(uint32_t)7) + allocator->bucketSize * cap);
+                if (next == NULL)
+                    return NULL;
+                next->next = NULL;
+                next->cap = cap;
+                next->live = 0;
+                next->epoch = allocator->epoch;
+                if (slab == NULL)
+                    allocator->firstSlab = next;
+                else
+                    slab->next = next;
+            }
+            allocator->slab = slab = next;
+            allocator->slabUsed = 0;
+        }
+        bucket = UI__PoolSlabBucket(allocator, slab, allocator->slabUsed++);
+        bucket->slab = slab;
+    }
+
+    UI__PoolSlab *slab = bucket->slab;
+    if (slab->epoch != allocator->epoch) {
+        slab->epoch = allocator->epoch;
+        slab->live = 0;
+    }
+    slab->live++;
+    allocator->bucketCount++;
+    bucket->link.epoch = allocator->epoch;
+    return (void *)(bucket + 1);
 }
 
 void UIPoolAllocatorFree(UIPoolAllocator *allocator, void *data) {
     UI__PoolBucket *bucket = (UI__PoolBucket *)data - 1;
-    if (allocator->maxBucketCount != 0 && allocator->bucketCount >= allocator->maxBucketCount) {
-        UI_MemFree(bucket);
+    if (bucket->link.epoch != allocator->epoch)
         return;
-    }
-    bucket->next = allocator->firstBucket;
+    bucket->slab->live--;
+    allocator->bucketCount--;
+    bucket->link.next = allocator->firstBucket;
     allocator->firstBucket = bucket;
 }
 
+void UIPoolAllocatorReset(UIPoolAllocator *allocator) {
+    // Slabs are lazily marked as empty when their epoch does not match
+    allocator->epoch++;
+    allocator->bucketCount = 0;
+    allocator->firstBucket = NULL;
+    allocator->slab = NULL;
+    allocator->slabUsed = 0;
+}
+
+void UIPoolAllocatorTrim(UIPoolAllocator *allocator) {
+    // Mark the empty slabs, the slab buckets are taken from is kept
+    bool trimmed = false;
+    for (UI__PoolSlab *slab = allocator->firstSlab; slab != NULL; slab = slab->next) {
+        bool empty = slab->epoch != allocator->epoch || slab->live == 0;
+        if (empty && slab != allocator->slab) {
+            slab->epoch = allocator->epoch;
+            slab->live = UI__POOL_TRIMMED;
+            trimmed = true;
+        }
+    }
+    if (!trimmed)
+        return;
+
+    // The free buckets of all the marked slabs are unlinked in one pass
+    UI__PoolBucket **bucket = &allocator->firstBucket;
+    while (*bucket != NULL) {
+        if ((*bucket)->slab->live == UI__POOL_TRIMMED)
+            *bucket = (*bucket)->link.next;
+        else
+            bucket = &(*bucket)->link.next;
+    }
+    UI__PoolSlab **slab = &allocator->firstSlab;
+    while (*slab != NULL) {
+        UI__PoolSlab *current = *slab;
+        if (current->live == UI__POOL_TRIMMED) {
+            *slab = current->next;
+            UI_MemFree(current);
+        } else
+            slab = &current->next;
+    }
+}
+
+void UIArenaInit(UIArena *arena) {
+    arena->firstChunk = NULL;
+    arena->chunk = NULL;
+    arena->used = 0;
+}
+
+void UIArenaDestroy(UIArena *arena) {
+    UI__ArenaChunk *chunk = arena->firstChunk;
+    while (chunk != NULL) {
+        UI__ArenaChunk *nextChunk = chunk->next;
+        UI_MemFree(chunk);
+        chunk = nextChunk;
+    }
+    UIArenaInit(arena);
+}
+
+void *UIArenaAlloc(UIArena *arena, uint32_t size) {
+    size = (size + 7) & ~(uint32_t)7;
+    UI__ArenaChunk *chunk = arena->chunk;
+    // Move to the next chunk, reusing the ones kept by a reset
+    while (chunk == NULL || arena->used + size > chunk->size) {
+        UI__ArenaChunk *next = chunk == NULL ? arena->firstChunk : chunk->next;
+        if (next == NULL) {
+            uint32_t chunkSize = chunk == NULL ? UI__ARENA_MIN_CHUNK : chunk->size * 2;
+            if (chunkSize < size)
+                chunkSize = size;
+            next = (UI__ArenaChunk *)UI__MemAlloc(((sizeof(UI__ArenaChunk) + 7) & ~(uint32_t)7) + chunkSize);
+            if (next == NULL)
+                return NULL;
+            next->next = NULL;
+            next->size = chunkSize;
+            if (chunk == NULL)
+                arena->firstChunk = next;
+            else
+                chunk->next = next;
+        }
+        arena->chunk = chunk = next;
+        arena->used = 0;
+    }
+
+    uint8_t *data = (uint8_t *)chunk + ((sizeof(UI__ArenaChunk) + 7) & ~(uint32_t)7) + arena->used;
+    arena->used += size;
+    return (void *)data;
+}
+
+void UIArenaReset(UIArena *arena) {
+    arena->chunk = NULL;
+    arena->used = 0;
+}
+
 bool UIContext_Init(UIContext *ctx, void *userData) {
     ctx->userData = userData;
+    UIArenaInit(&ctx->_frameArena);
+    ctx->_useFrameArena = false;
+    ctx->_frameElementCount = 0;
+    ctx->_frame = 0;
+    ctx->_failedDepth = 0;
+    ctx->_idTable = (UI__IdTable) { .entries = NULL, .cap = 0, .len = 0 };
+    if (!UI__StyleTableInit(ctx))
+        return false;
+    // The tree is built by the first call to `UIContext_Draw`
+    ctx->_tree = (UI__Tree) { .len = 0, .cap = 0, .elements = NULL };
+    ctx->_backTree = (UI__Tree) { .len = 0, .cap = 0, .elements = NULL };
+    ctx->_virtualLists = NULL;
+    ctx->_hitGrid = (UI__HitGrid) { .cellStart = NULL, .entries = NULL, .moved = NULL, .dirty = true };
+    ctx->atlas = (UIGlyphAtlas) { .pixels = NULL, ._slots = NULL, ._glyphs = NULL };
+    ctx->_textCache = (UI__TextCache) { .layouts = NULL, .buckets = NULL };
+    ctx->_hasWrappedText = false;
+#ifdef UI_THREADS
+    ctx->_taskMinSize = 0;
+    ctx->_layoutPlan = (UI__LayoutPlan) { .tasks = NULL, .serialRows = NULL, .dirty = true };
+#endif
+    ctx->_structureDirty = true;
     UIPoolAllocatorInit(&ctx->_elementAllocator, sizeof(UIElement), UI_MAX_ELEMENT_COUNT);
+    for (uint32_t i = 0; i < UI__CHILD_CLASSES; i++)
+        UIPoolAllocatorInit(&ctx->_childAllocators[i], sizeof(UIElement *) * (2 << i), 0);
     UIElement *root = UI__Context_AllocElement(ctx);
     if (!root)
         return false;
@@ -282,22 +1339,123 @@ bool UIContext_Init(UIContext *ctx, void *userData) {
     UI_FixedHeight(root, 0);
 
     ctx->root = root;
+    ctx->_current = root;
     ctx->window.w = 0;
     ctx->window.h = 0;
 
-    ctx->_fillChildren = (UI__Children){
+    ctx->drawList = (UIDrawList){
         .data = NULL,
         .len = 0,
-        .cap = 0
+        .cap = 0,
+        .damageCount = 0,
+        .partial = false
     };
 
+    ctx->_redraw = true;
+    ctx->_clipsDirty = true;
+    ctx->_partialRedraw = false;
+    ctx->_damageCount = 0;
     ctx->errorKind = UIErrorKind_noError;
+#ifdef UI_STATS
+    UIContext_StatsReset(ctx);
+#endif
 
     return true;
 }
 
+void UIContext_Destroy(UIContext *ctx) {
+    if (!ctx->_useFrameArena)
+        UI__ElementFreeChildren(ctx->root);
+    ctx->root = NULL;
+    // The rows detached from a list are not reached from the root
+    while (ctx->_virtualLists != NULL) {
+        UI__VirtualList *list = ctx->_virtualLists;
+        for (uint32_t i = 0; i < list->rowsLen; i++) {
+            if (list->rows[i]->parent == NULL)
+                UI__ElementFreeChildren(list->rows[i]);
+        }
+        if (list->rows != NULL)
+            UI_MemFree(list->rows);
+        ctx->_virtualLists = list->next;
+        UI_MemFree(list);
+    }
+
+    UIPoolAllocatorDestroy(&ctx->_elementAllocator);
+    for (uint32_t i = 0; i < UI__CHILD_CLASSES; i++)
+        UIPoolAllocatorDestroy(&ctx->_childAllocators[i]);
+    UIArenaDestroy(&ctx->_frameArena);
+    if (ctx->_idTable.entries != NULL)
+        UI_MemFree(ctx->_idTable.entries);
+    ctx->_idTable = (UI__IdTable) { .entries = NULL, .cap = 0, .len = 0 };
+    UI__StyleTableDestroy(&ctx->_styles);
+    if (ctx->_tree.elements != NULL)
+        UI_MemFree(ctx->_tree.elements);
+    if (ctx->_backTree.elements != NULL)
+        UI_MemFree(ctx->_backTree.elements);
+    if (ctx->drawList.data != NULL)
+        UI_MemFree(ctx->drawList.data);
+    ctx->_tree = (UI__Tree) { .len = 0, .cap = 0, .elements = NULL };
+    ctx->_backTree = (UI__Tree) { .len = 0, .cap = 0, .elements = NULL };
+    ctx->drawList = (UIDrawList) { .data = NULL, .len = 0, .cap = 0, .damageCount = 0, .partial = false };
+    if (ctx->_hitGrid.cellStart != NULL)
+        UI_MemFree(ctx->_hitGrid.cellStart);
+    if (ctx->_hitGrid.entries != NULL)
+        UI_MemFree(ctx->_hitGrid.entries);
+    if (ctx->_hitGrid.moved != NULL)
+        UI_MemFree(ctx->_hitGrid.moved);
+    ctx->_hitGrid = (UI__HitGrid) { .cellStart = NULL, .entries = NULL, .moved = NULL, .dirty = true };
+    UI__AtlasDestroy(&ctx->atlas);
+    UI__ContextFreeTextLayouts(ctx);
+#ifdef UI_THREADS
+    if (ctx->_layoutPlan.tasks != NULL)
+        UI_MemFree(ctx->_layoutPlan.tasks);
+    if (ctx->_layoutPlan.serialRows != NULL)
+        UI_MemFree(ctx->_layoutPlan.serialRows);
+    ctx->_layoutPlan = (UI__LayoutPlan) { .tasks = NULL, .serialRows = NULL, .dirty = true };
+#endif
+}
+
+void UIContext_SetMaxElements(UIContext *ctx, uint32_t maxElements) {
+    ctx->_elementAllocator.maxBucketCount = maxElements;
+}
+
+void UIContext_UseFrameArena(UIContext *ctx) {
+    ctx->_useFrameArena = true;
+}
+
+void UIContext_BeginFrame(UIContext *ctx) {
+    if (!ctx->_useFrameArena)
+        return;
+    UIArenaReset(&ctx->_frameArena);
+    ctx->_frameElementCount = 0;
+    ctx->_frame++;
+    ctx->_current = ctx->root;
+    ctx->_failedDepth = 0;
+    // The root is the only element not in the arena
+    ctx->root->children = (UI__Children) { .len = 0, .cap = 0, .data = NULL, .start = 0, .holes = 0 };
+    ctx->root->_signature = 0;
+    UI__StyleTableCollect(ctx);
+    // Children of the root may be reused even if some were added or removed
+    if (ctx->_tree.len != 0)
+        ctx->_tree.dirty[0] = true;
+    ctx->_structureDirty = true;
+    ctx->_redraw = true;
+}
+
 UIElement *UI__Context_AllocElement(UIContext *ctx) {
-    UIElement *element = (UIElement *)UIPoolAllocatorAlloc(&ctx->_elementAllocator);
+    UIPoolAllocator *allocator = &ctx->_elementAllocator;
+    uint32_t elementCount = allocator->bucketCount + ctx->_frameElementCount;
+    if (allocator->maxBucketCount != 0 && elementCount >= allocator->maxBucketCount) {
+        UI__ErrorSet(ctx, UIErrorKind_tooManyElements);
+        return NULL;
+    }
+    // The root is created before the frame arena can be enabled
+    UIElement *element;
+    if (ctx->_useFrameArena) {
+        element = (UIElement *)UIArenaAlloc(&ctx->_frameArena, sizeof(UIElement));
+        ctx->_frameElementCount += element != NULL;
+    } else
+        element = (UIElement *)UIPoolAllocatorAlloc(allocator);
 
     if (element == NULL) {
         UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
@@ -305,30 +1463,30 @@ UIElement *UI__Context_AllocElement(UIContext *ctx) {
     }
 
     element->context = ctx;
-    element->box = (UIRect) { 0, 0, 0, 0 };
+    element->_index = 0;
+    element->_handle = UI__NO_HANDLE;
+    element->_id = 0;
+    element->_signature = 0;
     element->parent = NULL;
     element->backgroundColor = (UIColor) { 255, 255, 255, 255 };
-    element->children = (UI__Children) { .len = 0, .cap = 0, .data = NULL };
-    element->layout = (UILayout) {
-        .padding = { 0, 0, 0, 0 },
-        .margin = { 0, 0, 0, 0 },
-        .childGap = 0,
-        .alignX = UIAlignX_left,
-        .alignY = UIAlignY_top,
-        .direction = UILayoutDirection_topToBottom,
-        .w_sizing = UISizing_fit,
-        .w_min = 0.0f,
-        .w_max = 0.0f,
-        .w_weight = 1.0f,
-        .h_sizing = UISizing_fit,
-        .h_min = 0.0f,
-        .h_max = 0.0f,
-        .h_weight = 1.0f
-    };
+    element->clipChildren = false;
+    element->_virtualRow = false;
+    element->text = (UIText) { .str = NULL, .len = 0, .font = 0, .color = { 0, 0, 0, 255 }, .wrap = false, .hash = 0 };
+    element->children = (UI__Children) { .len = 0, .cap = 0, .data = NULL, .start = 0, .holes = 0 };
+    element->_style = UI_DEFAULT_STYLE;
+    ctx->_styles.styles[UI_DEFAULT_STYLE].refs++;
+    element->scrollX = 0.0f;
+    element->scrollY = 0.0f;
+    element->contentW = 0.0f;
+    element->contentH = 0.0f;
     return element;
 }
 
 void UI__Context_FreeElement(UIContext *ctx, UIElement *element) {
+    // Elements in the frame arena are freed by `UIContext_BeginFrame`
+    if (ctx->_useFrameArena && element != ctx->root)
+        return;
+    UI__StyleTableRelease(&ctx->_styles, element->_style);
     UIPoolAllocatorFree(&ctx->_elementAllocator, (void *)element);
 }
 
@@ -344,414 +1502,907 @@ const char *UI_ErrorGetStr(UIContext *ctx) {
     return UI_errorStr[ctx->errorKind];
 }
 
+bool UI__DrawListPush(UIContext *ctx, UIRect rect, UIColor color, UIRect clip, UIRect src) {
+    UIDrawList *list = &ctx->drawList;
+    if (list->len == list->cap) {
+        uint32_t newCap = list->cap == 0 ? 64 : list->cap * 2;
+        UIDrawCommand *newData;
+        if (list->data == NULL)
+            newData = (UIDrawCommand *)UI__MemAlloc(sizeof(UIDrawCommand) * newCap);
+        else
+            newData = (UIDrawCommand *)UI__MemExpand(list->data, sizeof(UIDrawCommand) * newCap);
+
+        if (newData == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        list->data = newData;
+        list->cap = newCap;
+    }
+    list->data[list->len++] = (UIDrawCommand) { .rect = rect, .clip = clip, .src = src, .color = color };
+    return true;
+}
+
 bool UI__ChildrenAppend(UI__Children *children, UIElement *child) {
-    if (children->len < children->cap) {
-        children->data[children->len++] = child;
-        return true;
+    // Closing the holes is paid by the removals that made them
+    if (children->len == children->cap && children->holes != 0 && children->holes >= children->len / 2)
+        UI__ChildrenCompact(children);
+    if (children->len == children->cap) {
+        if (children->cap > UINT32_MAX / 2) {
+            UI__ErrorSet(child->context, UIErrorKind_outOfMemory);
+            return false;
+        }
+        if (!UI__ChildrenGrow(child->context, children, children->cap == 0 ? 2 : children->cap * 2))
+            return false;
+    }
+    child->_index = children->len;
+    children->data[children->len++] = child;
+    return true;
+}
+
+// Move the children to an array of at least `cap` children, arrays of a size
+// class are rounded up to it
+bool UI__ChildrenGrow(UIContext *ctx, UI__Children *children, uint32_t cap) {
+    if (cap > UINT32_MAX / sizeof(UIElement *)) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
     }
+    uint32_t sizeClass = UI__ChildrenClass(cap);
+    if (sizeClass < UI__CHILD_CLASSES)
+        cap = 2 << sizeClass;
+
     UIElement **newData;
-    if (children->data == NULL)
-        newData = (UIElement **)UI_MemAlloc(sizeof(UIElement *) * 2);
-    else
-        newData = (UIElement **)UI_MemExpand(children->data, sizeof(UIElement *) * children->cap * 2);
+    if (ctx->_useFrameArena)
+        newData = (UIElement **)UIArenaAlloc(&ctx->_frameArena, sizeof(UIElement *) * cap);
+    else if (sizeClass < UI__CHILD_CLASSES)
+        newData = (UIElement **)UIPoolAllocatorAlloc(&ctx->_childAllocators[sizeClass]);
+    else if (children->cap > UI__CHILD_MAX_CLASS) {
+        // Large arrays grow in place when they can
+        newData = (UIElement **)UI__MemExpand(children->data, sizeof(UIElement *) * cap);
+        if (newData == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        children->data = newData;
+        children->cap = cap;
+        return true;
+    } else
+        newData = (UIElement **)UI__MemAlloc(sizeof(UIElement *) * cap);
 
     if (newData == NULL) {
-        UI__ErrorSet(child->context, UIErrorKind_outOfMemory);
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
         return false;
     }
-    if (children->cap == 0)
-        children->cap = 2;
-    else
-        children->cap *= 2;
+    if (children->data != NULL)
+        UI__MemCopy(newData, children->data, sizeof(UIElement *) * children->len);
+    UI__ContextFreeChildren(ctx, children);
     children->data = newData;
-    newData[children->len++] = child;
+    children->cap = cap;
     return true;
 }
 
+// Smallest size class with room for `cap` children, `UI__CHILD_CLASSES` for
+// arrays that are too large
+uint32_t UI__ChildrenClass(uint32_t cap) {
+    uint32_t sizeClass = 0;
+    while (sizeClass < UI__CHILD_CLASSES && (2u << sizeClass) < cap)
+        sizeClass++;
+    return sizeClass;
+}
+
+// Give the array of `children` back to where it came from
+void UI__ContextFreeChildren(UIContext *ctx, UI__Children *children) {
+    // Arrays of the frame arena are freed by `UIContext_BeginFrame`
+    if (children->data != NULL && !ctx->_useFrameArena) {
+        uint32_t sizeClass = UI__ChildrenClass(children->cap);
+        if (sizeClass < UI__CHILD_CLASSES)
+            UIPoolAllocatorFree(&ctx->_childAllocators[sizeClass], (void *)children->data);
+        else
+            UI_MemFree(children->data);
+    }
+    children->data = NULL;
+    children->cap = 0;
+}
+
 void UI__ChildrenRemoveSwap(UI__Children *children, uint32_t index) {
     if (index >= children->len)
         return;
     children->data[index] = children->data[children->len - 1];
+    children->data[index]->_index = index;
     children->len--;
 }
 
-void UI__ChildrenRemoveShift(UI__Children *children, uint32_t index) {
-    if (index >= children->len)
+// Leave a hole in the slot of the child at `index`, the siblings keep their
+// slots. Holes at the end are dropped and holes at the start are skipped.
+void UI__ChildrenRemove(UI__Children *children, uint32_t index) {
+    if (index >= children->len || children->data[index] == NULL)
         return;
+    UIElement **data = children->data;
+    data[index] = NULL;
+    children->holes++;
+    while (children->len != 0 && data[children->len - 1] == NULL) {
+        children->len--;
+        children->holes--;
+    }
+    if (children->start > children->len)
+        children->start = children->len;
+    while (children->start < children->len && data[children->start] == NULL)
+        children->start++;
+}
 
+// Move the children over the holes, in order
+void UI__ChildrenCompact(UI__Children *children) {
     UIElement **data = children->data;
-    for (uint32_t i = index, n = children->len; i < n - 1; i++) {
-        data[i] = data[i + 1];
+    uint32_t len = 0;
+    for (uint32_t i = children->start, n = children->len; i < n; i++) {
+        if (data[i] == NULL)
+            continue;
+        data[len] = data[i];
+        data[len]->_index = len;
+        len++;
     }
-    children->len--;
+    children->len = len;
+    children->start = 0;
+    children->holes = 0;
 }
 
 void UIContext_UpdateWindow(UIContext *ctx, uint32_t width, uint32_t height) {
+    if (ctx->window.w == width && ctx->window.h == height)
+        return;
     ctx->window.w = width;
     ctx->window.h = height;
+    UI_FixedWidth(ctx->root, (float)width);
+    UI_FixedHeight(ctx->root, (float)height);
+    // The backend may lose the pixels of the last frame
+    UIContext_ForceRedraw(ctx);
+}
+
+bool UIContext_NeedsRedraw(UIContext *ctx) {
+    return ctx->_redraw || ctx->_structureDirty || ctx->_tree.dirty[0];
+}
+
+void UIContext_ForceRedraw(UIContext *ctx) {
+    ctx->_redraw = true;
+    UI__ContextDamage(ctx, (UIRect) { 0, 0, (float)ctx->window.w, (float)ctx->window.h });
+}
+
+void UIContext_SetPartialRedraw(UIContext *ctx, bool partial) {
+    if (ctx->_partialRedraw == partial)
+        return;
+    ctx->_partialRedraw = partial;
+    ctx->_damageCount = 0;
+    UIContext_ForceRedraw(ctx);
 }
 
 bool UIContext_Draw(UIContext *ctx) {
-    UIElement *root = ctx->root;
-    UI_FixedWidth(root, (float)ctx->window.w);
-    UI_FixedHeight(root, (float)ctx->window.h);
+#ifdef UI_STATS
+    ctx->stats.frame = (UIFrameStats) { .allocs = 0 };
+    uint64_t frameStart = UI_TimeNs();
+#endif
+    if (!UI__ContextUpdateTree(ctx))
+        return false;
+    // Virtual lists show the rows inside their new boxes, which are laid out
+    // again. Rows that change the box of their list are shown on the next frame.
+    for (uint32_t i = 0; i < 2 && ctx->_virtualLists != NULL; i++) {
+        bool changed = false;
+        if (!UI__ContextShowVirtualRows(ctx, &changed))
+            return false;
+        if (!changed)
+            break;
+        if (!UI__ContextUpdateTree(ctx))
+            return false;
+    }
 
-    UI__ElementFitSize(root);
-    UI__ElementFillSize(root);
-    UI__ElementPosition(root);
-    return UI__ElementDraw(root);
+    // The layout may not have changed any box
+    UI__Tree *tree = &ctx->_tree;
+    if (ctx->_redraw) {
+        UI__STATS_START(lap);
+        if (ctx->_clipsDirty) {
+            UIRect window = { 0, 0, (float)ctx->window.w, (float)ctx->window.h };
+            UI__TreeClip(tree, window);
+            UI__ContextDamageVisible(ctx);
+            ctx->_clipsDirty = false;
+        }
+        UI__ContextTakeDamage(ctx);
+        ctx->drawList.len = 0;
+        ctx->atlas._frame++;
+        if (!UI__TreeDraw(ctx))
+            return false;
+        if (!UI_DrawList(ctx, &ctx->drawList))
+            return false;
+        ctx->_redraw = false;
+        UI__STATS_ADD(ctx, drawCommands, ctx->drawList.len);
+        UI__STATS_LAP(ctx, UIStatsTime_draw, lap);
+    } else if (ctx->_partialRedraw) {
+        // Nothing is damaged, the backend presents the last frame again
+        ctx->drawList.len = 0;
+        ctx->drawList.damageCount = 0;
+        ctx->drawList.partial = true;
+        if (!UI_DrawList(ctx, &ctx->drawList))
+            return false;
+    }
+#ifdef UI_STATS
+    UI__StatsLap(ctx, UIStatsTime_frame, &frameStart);
+    UI__StatsEndFrame(ctx);
+#endif
+    return true;
 }
 
-float UI__ElementChildWidth(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    float prevMargin = padding.left;
-    float w = 0;
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        UIPadding margin = child->layout.margin;
+// Rebuild the tree and lay it out if anything changed
+bool UI__ContextUpdateTree(UIContext *ctx) {
+    UI__STATS_START(lap);
+    if (ctx->_structureDirty) {
+        if (!UI__ContextRebuildTree(ctx))
+            return false;
+        ctx->_structureDirty = false;
+        ctx->_clipsDirty = true;
+        // The grid refers to the rows of the old tree by their draw index
+        ctx->_hitGrid.dirty = true;
+#ifdef UI_THREADS
+        ctx->_layoutPlan.dirty = true;
+#endif
+        UI__STATS_LAP(ctx, UIStatsTime_rebuild, lap);
+    }
 
-        float gap = i == 0 ? 0 : element->layout.childGap;
-        if (child->layout.w_sizing == UISizing_fill)
-            w += child->layout.w_min;
-        else
-            w += child->box.w;
-        w += UI_fmax3(prevMargin, margin.left, gap);
-        prevMargin = margin.right;
+    if (ctx->_tree.dirty[0]) {
+        if (!UI__ContextLayout(ctx))
+            return false;
+        if (ctx->_idTable.len != 0)
+            UI__ContextSaveIdBoxes(ctx);
     }
-    w += UI_fmax2(padding.right, prevMargin);
-    return w;
+    return true;
 }
 
-float UI__ElementChildHeight(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    float prevMargin = padding.top;
-    float h = 0;
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        UIPadding margin = child->layout.margin;
+bool UI__TreeReserve(UI__Tree *tree, uint32_t count) {
+    if (count <= tree->cap)
+        return true;
+    uint32_t cap = tree->cap == 0 ? 64 : tree->cap;
+    while (cap < count)
+        cap *= 2;
+
+    // All the arrays share a single block, ordered by alignment
+    uint32_t rowSize = sizeof(UIElement *)
+                     + sizeof(uint64_t) * 2
+                     + sizeof(UIRect) * 5
+                     + sizeof(UI__Sizing)
+                     + sizeof(UI__Spacing)
+                     + sizeof(UI__Links)
+                     + sizeof(UIColor)
+                     + sizeof(float)
+                     + sizeof(uint32_t) * 3
+                     + sizeof(uint8_t) * 2;
+    uint8_t *block = (uint8_t *)UI__MemAlloc(rowSize * cap);
+    if (block == NULL)
+        return false;
 
-        float gap = i == 0 ? 0 : element->layout.childGap;
-        if (child->layout.h_sizing == UISizing_fill)
-            h += child->layout.h_min;
-        else
-            h += child->box.h;
-        h += UI_fmax3(prevMargin, margin.top, gap);
-        prevMargin = margin.bottom;
+    UI__Tree newTree = { .len = tree->len, .cap = cap };
+    newTree.elements = (UIElement **)block;
+    block += sizeof(UIElement *) * cap;
+    newTree.fillEvents = (uint64_t *)block;
+    block += sizeof(uint64_t) * 2 * cap;
+    newTree.boxes = (UIRect *)block;
+    block += sizeof(UIRect) * cap;
+    newTree.lastBoxes = (UIRect *)block;
+    block += sizeof(UIRect) * cap;
+    newTree.bounds = (UIRect *)block;
+    block += sizeof(UIRect) * cap;
+    newTree.clips = (UIRect *)block;
+    block += sizeof(UIRect) * cap;
+    newTree.visible = (UIRect *)block;
+    block += sizeof(UIRect) * cap;
+    newTree.sizing = (UI__Sizing *)block;
+    block += sizeof(UI__Sizing) * cap;
+    newTree.spacing = (UI__Spacing *)block;
+    block += sizeof(UI__Spacing) * cap;
+    newTree.links = (UI__Links *)block;
+    block += sizeof(UI__Links) * cap;
+    newTree.colors = (UIColor *)block;
+    block += sizeof(UIColor) * cap;
+    newTree.childExtent = (float *)block;
+    block += sizeof(float) * cap;
+    newTree.scratch = (uint32_t *)block;
+    block += sizeof(uint32_t) * cap;
+    newTree.drawOrder = (uint32_t *)block;
+    block += sizeof(uint32_t) * cap;
+    newTree.drawEnd = (uint32_t *)block;
+    block += sizeof(uint32_t) * cap;
+    newTree.dirty = block;
+    block += sizeof(uint8_t) * cap;
+    newTree.clipChildren = block;
+
+    if (tree->elements != NULL) {
+        uint32_t len = tree->len;
+        UI__MemCopy(newTree.elements, tree->elements, sizeof(UIElement *) * len);
+        UI__MemCopy(newTree.boxes, tree->boxes, sizeof(UIRect) * len);
+        UI__MemCopy(newTree.lastBoxes, tree->lastBoxes, sizeof(UIRect) * len);
+        UI__MemCopy(newTree.visible, tree->visible, sizeof(UIRect) * len);
+        UI__MemCopy(newTree.sizing, tree->sizing, sizeof(UI__Sizing) * len);
+        UI__MemCopy(newTree.spacing, tree->spacing, sizeof(UI__Spacing) * len);
+        UI__MemCopy(newTree.links, tree->links, sizeof(UI__Links) * len);
+        UI__MemCopy(newTree.colors, tree->colors, sizeof(UIColor) * len);
+        UI__MemCopy(newTree.childExtent, tree->childExtent, sizeof(float) * len);
+        UI__MemCopy(newTree.dirty, tree->dirty, sizeof(uint8_t) * len);
+        UI__MemCopy(newTree.clipChildren, tree->clipChildren, sizeof(uint8_t) * len);
+        UI_MemFree(tree->elements);
     }
-    h += UI_fmax2(padding.bottom, prevMargin);
-    return h;
+    *tree = newTree;
+    return true;
 }
 
-float UI__ElementChildMaxWidth(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    float maxW = 0;
+void UI__TreeWriteElement(UI__Tree *tree, uint32_t handle, UIElement *element) {
+    const UILayout *layout = UIElement_Layout(element);
+    tree->sizing[handle] = (UI__Sizing) {
+        .w_min = layout->w_min,
+        .w_max = layout->w_max,
+        .w_weight = layout->w_weight,
+        .h_min = layout->h_min,
+        .h_max = layout->h_max,
+        .h_weight = layout->h_weight,
+        .contentW = element->contentW,
+        .contentH = element->contentH,
+        .w_sizing = (uint8_t)layout->w_sizing,
+        .h_sizing = (uint8_t)layout->h_sizing,
+        .wrapText = element->text.wrap && element->text.str != NULL
+    };
+    tree->spacing[handle] = (UI__Spacing) {
+        .padding = layout->padding,
+        .margin = layout->margin,
+        .childGap = layout->childGap,
+        .scrollX = element->scrollX,
+        .scrollY = element->scrollY,
+        .direction = (uint8_t)layout->direction,
+        .alignX = (uint8_t)layout->alignX,
+        .alignY = (uint8_t)layout->alignY
+    };
+    tree->colors[handle] = element->backgroundColor;
+    tree->clipChildren[handle] = element->clipChildren;
+}
 
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        UIPadding margin = child->layout.margin;
+bool UI__ContextRebuildTree(UIContext *ctx) {
+    UI__Tree *oldTree = &ctx->_tree;
+    UI__Tree *tree = &ctx->_backTree;
 
-        float leftSpace = UI_fmax2(padding.left, margin.left);
-        float rightSpace = UI_fmax2(padding.right, margin.right);
-        float totalWidth = 0;
-        if (child->layout.w_sizing == UISizing_fill)
-            totalWidth = child->layout.w_min + leftSpace + rightSpace;
-        else
-            totalWidth = child->box.w + leftSpace + rightSpace;
-        if (maxW < totalWidth)
-            maxW = totalWidth;
+    tree->len = 0;
+    if (!UI__TreeReserve(tree, 1)) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    tree->elements[0] = ctx->root;
+    tree->links[0].parent = UI__NO_HANDLE;
+    tree->len = 1;
+
+    // Number the elements in breadth-first order
+    for (uint32_t i = 0; i < tree->len; i++) {
+        UI__Children children = tree->elements[i]->children;
+        if (!UI__TreeReserve(tree, tree->len + children.len - children.holes)) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        tree->links[i].firstChild = tree->len;
+        tree->links[i].childCount = children.len - children.holes;
+        // The holes stay in the array until it fills up
+        for (uint32_t j = children.start; j < children.len; j++) {
+            if (children.data[j] == NULL)
+                continue;
+            tree->elements[tree->len] = children.data[j];
+            tree->links[tree->len].parent = i;
+            tree->len++;
+        }
+    }
+
+    // Rows of the old tree still in use are marked in its scratch rows
+    for (uint32_t i = 0, n = oldTree->len; i < n; i++)
+        oldTree->scratch[i] = false;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UIElement *element = tree->elements[i];
+        uint32_t oldHandle = UI__ElementHandle(element);
+        UIRect box = { 0, 0, 0, 0 };
+        float childExtent = 0;
+        if (oldHandle == UI__NO_HANDLE) {
+            // Elements created by `UI_Begin` may be the same as in the last frame
+            bool reuse = UI__ElementReuseLayout(element, &box, &childExtent);
+            tree->boxes[i] = box;
+            tree->lastBoxes[i] = box;
+            tree->visible[i] = (UIRect) { 0, 0, 0, 0 };
+            tree->childExtent[i] = childExtent;
+            tree->dirty[i] = !reuse;
+        } else {
+            tree->boxes[i] = oldTree->boxes[oldHandle];
+            tree->lastBoxes[i] = oldTree->lastBoxes[oldHandle];
+            tree->visible[i] = oldTree->visible[oldHandle];
+            tree->childExtent[i] = oldTree->childExtent[oldHandle];
+            tree->dirty[i] = oldTree->dirty[oldHandle];
+            oldTree->scratch[oldHandle] = true;
+        }
+        UI__TreeWriteElement(tree, i, element);
+    }
+
+    // Removed elements leave their pixels behind
+    for (uint32_t i = 0, n = oldTree->len; i < n && ctx->_partialRedraw; i++) {
+        if (!oldTree->scratch[i] && UI__TreeDrawsElement(oldTree, i))
+            UI__ContextDamage(ctx, oldTree->visible[i]);
+    }
+
+    // Elements that moved may have been marked in their old position
+    for (uint32_t i = tree->len - 1; i > 0; i--) {
+        if (tree->dirty[i])
+            tree->dirty[tree->links[i].parent] = true;
+    }
+
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        tree->elements[i]->_handle = i;
+    UI__TreeSortDrawOrder(tree);
+
+    UI__Tree swap = *oldTree;
+    *oldTree = *tree;
+    *tree = swap;
+    return true;
+}
+
+// Parents are drawn before their children, each subtree is drawn before the
+// next sibling
+void UI__TreeSortDrawOrder(UI__Tree *tree) {
+    uint32_t *index = tree->scratch;
+
+    // Count the elements of each subtree
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        index[i] = 1;
+    for (uint32_t i = tree->len - 1; i > 0; i--)
+        index[tree->links[i].parent] += index[i];
+
+    // The subtree of a child starts after the subtrees of the siblings before it
+    index[0] = 0;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UI__Links links = tree->links[i];
+        uint32_t next = index[i] + 1;
+        for (uint32_t j = 0; j < links.childCount; j++) {
+            uint32_t subtreeSize = index[links.firstChild + j];
+            index[links.firstChild + j] = next;
+            next += subtreeSize;
+            tree->drawEnd[links.firstChild + j] = next;
+        }
+        tree->drawOrder[index[i]] = i;
     }
-    return maxW;
+    tree->drawEnd[0] = tree->len;
 }
 
-float UI__ElementChildMaxHeight(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    float maxH = 0;
+float UI__TreeChildWidth(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__AxisColumns columns = UI__TreeColumnsX(tree, handle);
+    return UI__ColumnsSum(&columns, spacing->padding.left, spacing->padding.right, spacing->childGap);
+}
 
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        UIPadding margin = child->layout.margin;
+float UI__TreeChildHeight(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__AxisColumns columns = UI__TreeColumnsY(tree, handle);
+    return UI__ColumnsSum(&columns, spacing->padding.top, spacing->padding.bottom, spacing->childGap);
+}
 
-        float topSpace = UI_fmax2(padding.top, margin.top);
-        float bottomSpace = UI_fmax2(padding.bottom, margin.bottom);
-        float totalHeight = 0;
-        if (child->layout.w_sizing == UISizing_fill)
-            totalHeight = child->layout.w_min + topSpace + bottomSpace;
-        else
-            totalHeight = child->box.w + topSpace + bottomSpace;
-        if (maxH < totalHeight)
-            maxH = totalHeight;
+float UI__TreeChildMaxWidth(UI__Tree *tree, uint32_t handle) {
+    UIPadding padding = tree->spacing[handle].padding;
+    UI__AxisColumns columns = UI__TreeColumnsX(tree, handle);
+    return UI__ColumnsMax(&columns, padding.left, padding.right);
+}
+
+float UI__TreeChildMaxHeight(UI__Tree *tree, uint32_t handle) {
+    UIPadding padding = tree->spacing[handle].padding;
+    UI__AxisColumns columns = UI__TreeColumnsY(tree, handle);
+    return UI__ColumnsMax(&columns, padding.top, padding.bottom);
+}
+
+bool UI__ContextLayout(UIContext *ctx) {
+#ifdef UI_THREADS
+    UI__LayoutPlan *plan = &ctx->_layoutPlan;
+    if (ctx->_taskMinSize != 0 && plan->dirty && !UI__ContextPlanLayout(ctx))
+        return false;
+    // A single task is laid out serially
+    if (ctx->_taskMinSize != 0 && plan->taskCount >= 2)
+        return UI__ContextLayoutTasks(ctx);
+#endif
+    UI__Tree *tree = &ctx->_tree;
+    UI__STATS_START(lap);
+    uint32_t laidOut;
+    uint32_t fillIterations;
+    if (ctx->_hasWrappedText) {
+        // Widths never depend on heights, the heights of wrapped text depend on
+        // the widths of their elements
+        laidOut = UI__TreeFitWidths(tree);
+        UI__STATS_LAP(ctx, UIStatsTime_fit, lap);
+        fillIterations = UI__TreeFillWidths(tree);
+        UI__STATS_LAP(ctx, UIStatsTime_fill, lap);
+        if (!UI__ContextWrapText(ctx))
+            return false;
+        UI__TreeFitHeights(tree);
+        UI__STATS_LAP(ctx, UIStatsTime_fit, lap);
+    } else {
+        // Without wrapped text the axes are independent, each row is read once for both
+        laidOut = UI__TreeFit(tree);
+        UI__STATS_LAP(ctx, UIStatsTime_fit, lap);
+        fillIterations = UI__TreeFillWidths(tree);
+    }
+    UI__STATS_ADD(ctx, elementsLaidOut, laidOut);
+    fillIterations += UI__TreeFillHeights(tree);
+    UI__STATS_ADD(ctx, fillIterations, fillIterations);
+    UI__STATS_LAP(ctx, UIStatsTime_fill, lap);
+    if (UI__TreePosition(tree)) {
+        ctx->_redraw = true;
+        ctx->_clipsDirty = true;
+    }
+    UI__STATS_LAP(ctx, UIStatsTime_position, lap);
+    return true;
+}
+
+// Fit the widths and the heights in one pass, return the number of elements laid out again
+uint32_t UI__TreeFit(UI__Tree *tree) {
+    uint32_t laidOut = 0;
+    for (uint32_t i = tree->len; i-- > 0;) {
+        laidOut += tree->dirty[i] != 0;
+        UI__TreeFitElementWidth(tree, i);
+        UI__TreeFitElementHeight(tree, i);
+    }
+    return laidOut;
+}
+
+// Return the number of elements laid out again
+uint32_t UI__TreeFitWidths(UI__Tree *tree) {
+    uint32_t laidOut = 0;
+    // Children always come after their parent
+    for (uint32_t i = tree->len; i-- > 0;) {
+        laidOut += tree->dirty[i] != 0;
+        UI__TreeFitElementWidth(tree, i);
     }
-    return maxH;
+    return laidOut;
+}
+
+void UI__TreeFitHeights(UI__Tree *tree) {
+    for (uint32_t i = tree->len; i-- > 0;)
+        UI__TreeFitElementHeight(tree, i);
 }
 
-void UI__ElementFitSize(UIElement *element) {
-    for (uint32_t i = 0, n = element->children.len; i < n; i++)
-        UI__ElementFitSize(element->children.data[i]);
+void UI__TreeFitElementWidth(UI__Tree *tree, uint32_t handle) {
+    // The size of a clean subtree is the same as in the last layout
+    if (!tree->dirty[handle])
+        return;
+
+    // The sizes of the children are final, the fill and position passes reuse
+    // the extent, they never read it for an element without children
+    UILayoutDirection direction = tree->spacing[handle].direction;
+    if (tree->links[handle].childCount != 0 &&
+        (direction == UILayoutDirection_leftToRight || direction == UILayoutDirection_rightToLeft))
+    {
+        tree->childExtent[handle] = UI__TreeChildWidth(tree, handle);
+    }
 
-    switch (element->layout.w_sizing) {
+    switch (tree->sizing[handle].w_sizing) {
     case UISizing_fixed:
-        UI__ElementSetW(element, element->layout.w_min);
+        UI__TreeSetW(tree, handle, tree->sizing[handle].w_min);
         break;
     case UISizing_fit:
-        UI__ElementFitWidth(element);
+        UI__TreeFitWidth(tree, handle);
     default:
         break;
     }
+}
+
+void UI__TreeFitElementHeight(UI__Tree *tree, uint32_t handle) {
+    if (!tree->dirty[handle])
+        return;
+
+    UILayoutDirection direction = tree->spacing[handle].direction;
+    if (tree->links[handle].childCount != 0 &&
+        (direction == UILayoutDirection_topToBottom || direction == UILayoutDirection_bottomToTop))
+    {
+        tree->childExtent[handle] = UI__TreeChildHeight(tree, handle);
+    }
 
-    switch (element->layout.h_sizing) {
+    switch (tree->sizing[handle].h_sizing) {
     case UISizing_fixed:
-        UI__ElementSetH(element, element->layout.h_min);
+        UI__TreeSetH(tree, handle, tree->sizing[handle].h_min);
         break;
     case UISizing_fit:
-        UI__ElementFitHeight(element);
+        UI__TreeFitHeight(tree, handle);
     default:
         break;
     }
 }
 
-void UI__ElementFitWidth(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    if (element->children.len == 0) {
-        UI__ElementSetW(element, padding.left + padding.right);
+void UI__TreeFitWidth(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UIPadding padding = spacing->padding;
+    float contentW = tree->sizing[handle].contentW;
+    if (tree->links[handle].childCount == 0) {
+        UI__TreeSetW(tree, handle, padding.left + padding.right + contentW);
         return;
     }
 
-    if (element->layout.direction == UILayoutDirection_leftToRight ||
-        element->layout.direction == UILayoutDirection_rightToLeft)
+    float w;
+    if (spacing->direction == UILayoutDirection_leftToRight ||
+        spacing->direction == UILayoutDirection_rightToLeft)
     {
-        UI__ElementSetW(element, UI__ElementChildWidth(element));
+        w = tree->childExtent[handle];
     } else
-        UI__ElementSetW(element, UI__ElementChildMaxWidth(element));
+        w = UI__TreeChildMaxWidth(tree, handle);
+    // The text is under the children
+    if (contentW > 0)
+        w = UI_fmax2(w, padding.left + padding.right + contentW);
+    UI__TreeSetW(tree, handle, w);
 }
 
-void UI__ElementFitHeight(UIElement *element) {
-    UIPadding padding = element->layout.padding;
-    if (element->children.len == 0) {
-        UI__ElementSetH(element, padding.top + padding.bottom);
+void UI__TreeFitHeight(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UIPadding padding = spacing->padding;
+    float contentH = tree->sizing[handle].contentH;
+    if (tree->links[handle].childCount == 0) {
+        UI__TreeSetH(tree, handle, padding.top + padding.bottom + contentH);
         return;
     }
 
-    if (element->layout.direction == UILayoutDirection_topToBottom ||
-        element->layout.direction == UILayoutDirection_bottomToTop)
+    float h;
+    if (spacing->direction == UILayoutDirection_topToBottom ||
+        spacing->direction == UILayoutDirection_bottomToTop)
     {
-        UI__ElementSetH(element, UI__ElementChildHeight(element));
+        h = tree->childExtent[handle];
     } else
-        UI__ElementSetH(element, UI__ElementChildMaxHeight(element));
+        h = UI__TreeChildMaxHeight(tree, handle);
+    if (contentH > 0)
+        h = UI_fmax2(h, padding.top + padding.bottom + contentH);
+    UI__TreeSetH(tree, handle, h);
 }
 
-bool UI__ElementFillSize(UIElement *element) {
-    if (!UI__ElementFillWidth(element))
-        return false;
-    if (!UI__ElementFillHeight(element))
-        return false;
+// Return the iterations of the loops that clamp the fill children
+uint32_t UI__TreeFillWidths(UI__Tree *tree) {
+    uint32_t iterations = 0;
+    // Parents always come before their children
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        iterations += UI__TreeFillElementWidth(tree, i);
+    return iterations;
+}
 
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        if (!UI__ElementFillSize(element->children.data[i]))
-            return false;
-    }
-    return true;
+uint32_t UI__TreeFillHeights(UI__Tree *tree) {
+    uint32_t iterations = 0;
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        iterations += UI__TreeFillElementHeight(tree, i);
+    return iterations;
 }
 
-bool UI__ElementFillWidth(UIElement *element) {
-    UIPadding padding = element->layout.padding;
+uint32_t UI__TreeFillElementWidth(UI__Tree *tree, uint32_t handle) {
+    if (!tree->dirty[handle] && tree->boxes[handle].w == tree->lastBoxes[handle].w)
+        return 0;
+    return UI__TreeFillWidth(tree, handle);
+}
+
+uint32_t UI__TreeFillElementHeight(UI__Tree *tree, uint32_t handle) {
+    if (!tree->dirty[handle] && tree->boxes[handle].h == tree->lastBoxes[handle].h)
+        return 0;
+    return UI__TreeFillHeight(tree, handle);
+}
+
+// Break the wrapped texts whose width changed into lines and set the height of
+// their content, the elements that may change height are marked to be fit again.
+// A row written again from its element is dirty and gets the height of one line,
+// so it is always broken here before `UI__TreeFitElementHeight` reads it.
+bool UI__ContextWrapText(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UI__Sizing *sizing = &tree->sizing[i];
+        if (!sizing->wrapText || (!tree->dirty[i] && tree->boxes[i].w == tree->lastBoxes[i].w))
+            continue;
+        UIPadding padding = tree->spacing[i].padding;
+        float width = UI_fmax2(tree->boxes[i].w - padding.left - padding.right, 0);
+        UI__TextLayout *layout = UI__ContextTextLayout(ctx, &tree->elements[i]->text, width);
+        if (layout == NULL)
+            return false;
+        if (layout->height == sizing->contentH)
+            continue;
+        sizing->contentH = layout->height;
+        for (uint32_t handle = i; handle != UI__NO_HANDLE && !tree->dirty[handle];) {
+            tree->dirty[handle] = true;
+            handle = tree->links[handle].parent;
+        }
+    }
+    return true;
+}
+
+uint32_t UI__TreeFillWidth(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__Links links = tree->links[handle];
+    UIPadding padding = spacing->padding;
+    float elementW = tree->boxes[handle].w;
 
-    if (element->layout.direction == UILayoutDirection_topToBottom ||
-        element->layout.direction == UILayoutDirection_bottomToTop)
+    if (spacing->direction == UILayoutDirection_topToBottom ||
+        spacing->direction == UILayoutDirection_bottomToTop)
     {
-        for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-            UIElement *child = element->children.data[i];
-            if (child->layout.w_sizing != UISizing_fill)
+        for (uint32_t i = 0; i < links.childCount; i++) {
+            uint32_t child = links.firstChild + i;
+            if (tree->sizing[child].w_sizing != UISizing_fill)
                 continue;
-            float spaceLeft = UI_fmax2(padding.left, child->layout.margin.left);
-            float spaceRight = UI_fmax2(padding.right, child->layout.margin.right);
-            UI__ElementSetW(child, element->box.w - spaceLeft - spaceRight);
+            UIPadding margin = tree->spacing[child].margin;
+            float spaceLeft = UI_fmax2(padding.left, margin.left);
+            float spaceRight = UI_fmax2(padding.right, margin.right);
+            UI__TreeSetW(tree, child, elementW - spaceLeft - spaceRight);
         }
-        return true;
+        return 0;
     }
 
-    float childWidth = UI__ElementChildWidth(element);
+    float childWidth = tree->childExtent[handle];
     float totalWeight = 0;
-    UI__Children *fillChildren = &element->context->_fillChildren;
-    fillChildren->len = 0;
-
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        if (child->layout.w_sizing != UISizing_fill)
+    // Each element uses the scratch rows of its children, elements can be filled in parallel
+    uint32_t *fillChildren = tree->scratch + links.firstChild;
+    uint32_t fillCount = 0;
+
+    for (uint32_t i = 0; i < links.childCount; i++) {
+        uint32_t child = links.firstChild + i;
+        UI__Sizing *sizing = &tree->sizing[child];
+        if (sizing->w_sizing != UISizing_fill)
             continue;
-        if (child->layout.w_weight <= 0) {
-            UI__ElementSetW(child, child->layout.w_min);
+        if (sizing->w_weight <= 0) {
+            UI__TreeSetW(tree, child, sizing->w_min);
             continue;
         }
-        if (!UI__ChildrenAppend(fillChildren, child))
-            return false;
-        totalWeight += child->layout.w_weight;
-        childWidth -= child->layout.w_min;
+        fillChildren[fillCount++] = child;
+        totalWeight += sizing->w_weight;
+        childWidth -= sizing->w_min;
     }
 
-    float spaceRemaining = element->box.w - childWidth;
-    if (spaceRemaining < 0 || totalWeight == 0)
-        return true;
-
-    float prevSpaceRemaining = spaceRemaining;
-    do {
-        prevSpaceRemaining = spaceRemaining;
-        // Set the size when it is below the minimum or above the maximum
-        for (uint32_t i = 0, n = fillChildren->len; i < n; i++) {
-            UIElement *child = fillChildren->data[i];
-            float size = spaceRemaining * child->layout.w_weight / totalWeight;
-            if (size >= child->layout.w_min && (size <= child->layout.w_max || child->layout.w_max == 0))
-                continue;
-            if (size < child->layout.w_min)
-                size = child->layout.w_min;
-            else if (size > child->layout.w_max)
-                size = child->layout.w_max;
-
-            totalWeight -= child->layout.w_weight;
-            spaceRemaining -= size;
-            UI__ElementSetW(child, size);
-
-            // Remove the child from _fillChildren
-            UI__ChildrenRemoveSwap(fillChildren, i);
-            i--; n--;
-        }
-    } while (prevSpaceRemaining != spaceRemaining && spaceRemaining >= 0);
+    float spaceRemaining = elementW - childWidth;
+    if (spaceRemaining < 0 || fillCount == 0)
+        return 0;
 
+    uint32_t iterations = 0;
+    bool done = UI__FillRounds(
+        &tree->boxes[0].w, &tree->sizing[0].w_weight, &tree->sizing[0].w_min, &tree->sizing[0].w_max,
+        fillChildren, &fillCount, &spaceRemaining, &totalWeight, &iterations);
     if (spaceRemaining < 0)
-        return true;
-
-    // Expand the remaining children
-    for (uint32_t i = 0, n = fillChildren->len; i < n; i++) {
-        UIElement *child = fillChildren->data[i];
-        UI__ElementSetW(child, spaceRemaining * child->layout.w_weight / totalWeight);
+        return iterations;
+    // The solver finishes the containers the loop would need many rounds for,
+    // it returns the share of one unit of weight
+    if (!done) {
+        spaceRemaining = UI__FillSolve(
+            &tree->sizing[0].w_weight, &tree->sizing[0].w_min, &tree->sizing[0].w_max,
+            fillChildren, tree->fillEvents + 2 * links.firstChild, fillCount, spaceRemaining, &iterations);
+        totalWeight = 1;
     }
-    return true;
+    UI__FillExpand(
+        &tree->boxes[0].w, &tree->sizing[0].w_weight, &tree->sizing[0].w_min, &tree->sizing[0].w_max,
+        fillChildren, fillCount, spaceRemaining, totalWeight);
+    return iterations;
 }
 
-bool UI__ElementFillHeight(UIElement *element) {
-    UIPadding padding = element->layout.padding;
+uint32_t UI__TreeFillHeight(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__Links links = tree->links[handle];
+    UIPadding padding = spacing->padding;
+    float elementH = tree->boxes[handle].h;
 
-    if (element->layout.direction == UILayoutDirection_leftToRight ||
-        element->layout.direction == UILayoutDirection_rightToLeft)
+    if (spacing->direction == UILayoutDirection_leftToRight ||
+        spacing->direction == UILayoutDirection_rightToLeft)
     {
-        for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-            UIElement *child = element->children.data[i];
-            if (child->layout.h_sizing != UISizing_fill)
+        for (uint32_t i = 0; i < links.childCount; i++) {
+            uint32_t child = links.firstChild + i;
+            if (tree->sizing[child].h_sizing != UISizing_fill)
                 continue;
-            float spaceTop = UI_fmax2(padding.top, child->layout.margin.top);
-            float spaceBottom = UI_fmax2(padding.bottom, child->layout.margin.bottom);
-            UI__ElementSetH(child, element->box.h - spaceTop - spaceBottom);
+            UIPadding margin = tree->spacing[child].margin;
+            float spaceTop = UI_fmax2(padding.top, margin.top);
+            float spaceBottom = UI_fmax2(padding.bottom, margin.bottom);
+            UI__TreeSetH(tree, child, elementH - spaceTop - spaceBottom);
         }
-        return true;
+        return 0;
     }
 
-    float childHeight = UI__ElementChildHeight(element);
+    float childHeight = tree->childExtent[handle];
     float totalWeight = 0;
-    UI__Children *fillChildren = &element->context->_fillChildren;
-    fillChildren->len = 0;
-
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[i];
-        if (child->layout.h_sizing != UISizing_fill)
+    // Each element uses the scratch rows of its children, elements can be filled in parallel
+    uint32_t *fillChildren = tree->scratch + links.firstChild;
+    uint32_t fillCount = 0;
+
+    for (uint32_t i = 0; i < links.childCount; i++) {
+        uint32_t child = links.firstChild + i;
+        UI__Sizing *sizing = &tree->sizing[child];
+        if (sizing->h_sizing != UISizing_fill)
             continue;
-        if (child->layout.h_weight <= 0) {
-            UI__ElementSetH(child, child->layout.h_min);
+        if (sizing->h_weight <= 0) {
+            UI__TreeSetH(tree, child, sizing->h_min);
             continue;
         }
-        if (!UI__ChildrenAppend(fillChildren, child))
-            return false;
-        totalWeight += child->layout.h_weight;
-        childHeight -= child->layout.h_min;
+        fillChildren[fillCount++] = child;
+        totalWeight += sizing->h_weight;
+        childHeight -= sizing->h_min;
     }
 
-    float spaceRemaining = element->box.h - childHeight;
-    if (spaceRemaining < 0 || totalWeight == 0)
-        return true;
-
-    float prevSpaceRemaining = spaceRemaining;
-    do {
-        prevSpaceRemaining = spaceRemaining;
-        // Set the size when it is below the minimum or above the maximum
-        for (uint32_t i = 0, n = fillChildren->len; i < n; i++) {
-            UIElement *child = fillChildren->data[i];
-            float size = spaceRemaining * child->layout.h_weight / totalWeight;
-            if (size >= child->layout.h_min && (size <= child->layout.h_max || child->layout.h_max == 0))
-                continue;
-            if (size < child->layout.h_min)
-                size = child->layout.h_min;
-            else if (size > child->layout.h_max)
-                size = child->layout.h_max;
-
-            totalWeight -= child->layout.h_weight;
-            spaceRemaining -= size;
-            UI__ElementSetH(child, size);
-
-            // Remove the child from _fillChildren
-            fillChildren->data[i] = fillChildren->data[fillChildren->len - 1];
-            fillChildren->len--;
-            i--; n--;
-        }
-    } while (prevSpaceRemaining != spaceRemaining && spaceRemaining >= 0);
+    float spaceRemaining = elementH - childHeight;
+    if (spaceRemaining < 0 || fillCount == 0)
+        return 0;
 
+    uint32_t iterations = 0;
+    bool done = UI__FillRounds(
+        &tree->boxes[0].h, &tree->sizing[0].h_weight, &tree->sizing[0].h_min, &tree->sizing[0].h_max,
+        fillChildren, &fillCount, &spaceRemaining, &totalWeight, &iterations);
     if (spaceRemaining < 0)
-        return true;
-
-    // Expand the remaining children
-    for (uint32_t i = 0, n = fillChildren->len; i < n; i++) {
-        UIElement *child = fillChildren->data[i];
-        UI__ElementSetH(child, spaceRemaining * child->layout.h_weight / totalWeight);
+        return iterations;
+    // The solver finishes the containers the loop would need many rounds for,
+    // it returns the share of one unit of weight
+    if (!done) {
+        spaceRemaining = UI__FillSolve(
+            &tree->sizing[0].h_weight, &tree->sizing[0].h_min, &tree->sizing[0].h_max,
+            fillChildren, tree->fillEvents + 2 * links.firstChild, fillCount, spaceRemaining, &iterations);
+        totalWeight = 1;
     }
-    return true;
+    UI__FillExpand(
+        &tree->boxes[0].h, &tree->sizing[0].h_weight, &tree->sizing[0].h_min, &tree->sizing[0].h_max,
+        fillChildren, fillCount, spaceRemaining, totalWeight);
+    return iterations;
+}
+
+// Return true if any box changed since the last layout
+bool UI__TreePosition(UI__Tree *tree) {
+    bool changed = false;
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        changed |= UI__TreePositionElement(tree, i);
+    return changed;
 }
 
-void UI__ElementPosition(UIElement *element) {
-    UI__ElementPositionX(element);
-    UI__ElementPositionY(element);
+// Return true if the box of the element changed since the last layout
+bool UI__TreePositionElement(UI__Tree *tree, uint32_t handle) {
+    UIRect box = tree->boxes[handle];
+    UIRect lastBox = tree->lastBoxes[handle];
+    bool moved = box.x != lastBox.x || box.y != lastBox.y || box.w != lastBox.w || box.h != lastBox.h;
+    if (!tree->dirty[handle] && !moved)
+        return false;
 
-    for (uint32_t i = 0, n = element->children.len; i < n; i++)
-        UI__ElementPosition(element->children.data[i]);
+    // Most elements are leaves, only the boxes are compared for them
+    if (tree->links[handle].childCount != 0) {
+        UI__TreePositionX(tree, handle);
+        UI__TreePositionY(tree, handle);
+    }
+    tree->lastBoxes[handle] = box;
+    tree->dirty[handle] = false;
+    return moved;
 }
 
-void UI__ElementPositionX(UIElement *element) {
-    float baseX = element->box.x;
-    float elementW = element->box.w;
-    UIPadding padding = element->layout.padding;
+void UI__TreePositionX(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__Links links = tree->links[handle];
+    float baseX = tree->boxes[handle].x - spacing->scrollX;
+    float elementW = tree->boxes[handle].w;
+    UIPadding padding = spacing->padding;
 
-    if (element->layout.direction == UILayoutDirection_topToBottom ||
-        element->layout.direction == UILayoutDirection_bottomToTop)
+    if (spacing->direction == UILayoutDirection_topToBottom ||
+        spacing->direction == UILayoutDirection_bottomToTop)
     {
-        for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-            UIElement *child = element->children.data[i];
-            switch (element->layout.alignX) {
+        for (uint32_t i = 0; i < links.childCount; i++) {
+            uint32_t child = links.firstChild + i;
+            UIPadding margin = tree->spacing[child].margin;
+            float childW = tree->boxes[child].w;
+            switch (spacing->alignX) {
             case UIAlignX_left:
-                UI__ElementSetX(child, baseX + UI_fmax2(padding.left, child->layout.margin.left));
+                tree->boxes[child].x = baseX + UI_fmax2(padding.left, margin.left);
                 break;
             case UIAlignX_right:
-                UI__ElementSetX(
-                    child,
-                    baseX + elementW - child->box.w - UI_fmax2(padding.right, child->layout.margin.right));
+                tree->boxes[child].x = baseX + elementW - childW - UI_fmax2(padding.right, margin.right);
                 break;
             case UIAlignX_center: {
-                float offset = (elementW - child->box.w) / 2.0f;
-                float leftSpace = UI_fmax2(padding.left, child->layout.margin.left);
-                float rightSpace = UI_fmax2(padding.right, child->layout.margin.right);
+                float offset = (elementW - childW) / 2.0f;
+                float leftSpace = UI_fmax2(padding.left, margin.left);
+                float rightSpace = UI_fmax2(padding.right, margin.right);
                 if (offset < leftSpace)
                     offset = leftSpace;
-                else if (elementW - offset - child->box.w < rightSpace)
-                    offset = elementW - child->box.w - rightSpace;
-                UI__ElementSetX(child, baseX + offset);
+                else if (elementW - offset - childW < rightSpace)
+                    offset = elementW - childW - rightSpace;
+                tree->boxes[child].x = baseX + offset;
                 break;
             }
             }
         }
         return;
     }
-    if (element->children.len == 0)
+    if (links.childCount == 0)
         return;
 
-    float childWidth = UI__ElementChildWidth(element);
+    float childWidth = tree->childExtent[handle];
     float childOffset = 0;
-    bool reverseChildren = element->layout.direction == UILayoutDirection_rightToLeft;
-    switch (element->layout.alignX) {
+    bool reverseChildren = spacing->direction == UILayoutDirection_rightToLeft;
+    uint32_t lastChild = links.firstChild + links.childCount - 1;
+    switch (spacing->alignX) {
         case UIAlignX_left:
             childOffset = 0;
             break;
@@ -759,73 +2410,79 @@ void UI__ElementPositionX(UIElement *element) {
             childOffset = elementW - childWidth;
             break;
         case UIAlignX_center: {
-            UIElement *firstChild = element->children.data[reverseChildren ? element->children.len - 1 : 0];
-            UIElement *lastChild = element->children.data[reverseChildren ? 0 : element->children.len - 1];
-            float leftSpace = UI_fmax2(padding.left, firstChild->layout.margin.left);
-            float rightSpace = UI_fmax2(padding.right, lastChild->layout.margin.right);
+            uint32_t first = reverseChildren ? lastChild : links.firstChild;
+            uint32_t last = reverseChildren ? links.firstChild : lastChild;
+            float leftSpace = UI_fmax2(padding.left, tree->spacing[first].margin.left);
+            float rightSpace = UI_fmax2(padding.right, tree->spacing[last].margin.right);
             childWidth -= leftSpace + rightSpace;
             float offset = (elementW - childWidth) / 2;
             if (offset < leftSpace)
                 offset = leftSpace;
             else if (elementW - offset - childWidth < rightSpace)
                 offset = elementW - childWidth - rightSpace;
+            // The loop below already puts the first child after `leftSpace`
+            childOffset = offset - leftSpace;
             break;
         }
     }
 
     float xOffset = 0;
     float prevMargin = padding.left;
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[reverseChildren ? n - i - 1 : i];
-        float gap = i == 0 ? 0 : element->layout.childGap;
-        xOffset += UI_fmax3(prevMargin, child->layout.margin.left, gap);
-        UI__ElementSetX(child, baseX + xOffset + childOffset);
-        xOffset += child->box.w;
-        prevMargin = child->layout.margin.right;
+    for (uint32_t i = 0, n = links.childCount; i < n; i++) {
+        uint32_t child = reverseChildren ? lastChild - i : links.firstChild + i;
+        UIPadding margin = tree->spacing[child].margin;
+        float gap = i == 0 ? 0 : spacing->childGap;
+        xOffset += UI_fmax3(prevMargin, margin.left, gap);
+        tree->boxes[child].x = baseX + xOffset + childOffset;
+        xOffset += tree->boxes[child].w;
+        prevMargin = margin.right;
     }
 }
 
-void UI__ElementPositionY(UIElement *element) {
-    float baseY = element->box.y;
-    float elementH = element->box.h;
-    UIPadding padding = element->layout.padding;
+void UI__TreePositionY(UI__Tree *tree, uint32_t handle) {
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UI__Links links = tree->links[handle];
+    float baseY = tree->boxes[handle].y - spacing->scrollY;
+    float elementH = tree->boxes[handle].h;
+    UIPadding padding = spacing->padding;
 
-    if (element->layout.direction == UILayoutDirection_leftToRight ||
-        element->layout.direction == UILayoutDirection_rightToLeft)
+    if (spacing->direction == UILayoutDirection_leftToRight ||
+        spacing->direction == UILayoutDirection_rightToLeft)
     {
-        for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-            UIElement *child = element->children.data[i];
-            switch (element->layout.alignY) {
+        for (uint32_t i = 0; i < links.childCount; i++) {
+            uint32_t child = links.firstChild + i;
+            UIPadding margin = tree->spacing[child].margin;
+            float childH = tree->boxes[child].h;
+            switch (spacing->alignY) {
             case UIAlignY_top:
-                UI__ElementSetY(child, baseY + UI_fmax2(padding.top, child->layout.margin.top));
+                tree->boxes[child].y = baseY + UI_fmax2(padding.top, margin.top);
                 break;
             case UIAlignY_bottom:
-                UI__ElementSetY(
-                    child,
-                    baseY + elementH - child->box.h - UI_fmax2(padding.bottom, child->layout.margin.bottom));
+                tree->boxes[child].y = baseY + elementH - childH - UI_fmax2(padding.bottom, margin.bottom);
                 break;
             case UIAlignY_center: {
-                float offset = (elementH - child->box.h) / 2.0f;
-                float topSpace = UI_fmax2(padding.top, child->layout.margin.top);
-                float bottomSpace = UI_fmax2(padding.bottom, child->layout.margin.bottom);
+                float offset = (elementH - childH) / 2.0f;
+                float topSpace = UI_fmax2(padding.top, margin.top);
+                float bottomSpace = UI_fmax2(padding.bottom, margin.bottom);
                 if (offset < topSpace)
                     offset = topSpace;
-                else if (elementH - offset - child->box.h < bottomSpace)
-                    offset = elementH - child->box.h - bottomSpace;
-                UI__ElementSetY(child, baseY + offset);
+                else if (elementH - offset - childH < bottomSpace)
+                    offset = elementH - childH - bottomSpace;
+                tree->boxes[child].y = baseY + offset;
                 break;
             }
             }
         }
         return;
     }
-    if (element->children.len == 0)
+    if (links.childCount == 0)
         return;
 
-    float childHeight = UI__ElementChildHeight(element);
+    float childHeight = tree->childExtent[handle];
     float childOffset = 0;
-    bool reverseChildren = element->layout.direction == UILayoutDirection_bottomToTop;
-    switch (element->layout.alignY) {
+    bool reverseChildren = spacing->direction == UILayoutDirection_bottomToTop;
+    uint32_t lastChild = links.firstChild + links.childCount - 1;
+    switch (spacing->alignY) {
     case UIAlignY_top:
         childOffset = 0;
         break;
@@ -833,195 +2490,3138 @@ void UI__ElementPositionY(UIElement *element) {
         childOffset = elementH - childHeight;
         break;
     case UIAlignY_center: {
-        UIElement *firstChild = element->children.data[reverseChildren ? element->children.len - 1 : 0];
-        UIElement *lastChild = element->children.data[reverseChildren ? 0 : element->children.len - 1];
-        float topSpace = UI_fmax2(padding.top, firstChild->layout.margin.top);
-        float bottomSpace = UI_fmax2(padding.bottom, lastChild->layout.margin.bottom);
+        uint32_t first = reverseChildren ? lastChild : links.firstChild;
+        uint32_t last = reverseChildren ? links.firstChild : lastChild;
+        float topSpace = UI_fmax2(padding.top, tree->spacing[first].margin.top);
+        float bottomSpace = UI_fmax2(padding.bottom, tree->spacing[last].margin.bottom);
         childHeight -= topSpace + bottomSpace;
-        childOffset = (elementH - childHeight) / 2;
-        if (childOffset < topSpace)
-            childOffset = topSpace;
-        else if (elementH - childOffset - childHeight < bottomSpace)
-            childOffset = elementH - childHeight - bottomSpace;
+        float offset = (elementH - childHeight) / 2;
+        if (offset < topSpace)
+            offset = topSpace;
+        else if (elementH - offset - childHeight < bottomSpace)
+            offset = elementH - childHeight - bottomSpace;
+        // The loop below already puts the first child after `topSpace`
+        childOffset = offset - topSpace;
+        break;
     }
     }
 
     float yOffset = 0;
     float prevMargin = padding.top;
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        UIElement *child = element->children.data[reverseChildren ? n - i - 1 : i];
-        float gap = i == 0 ? 0 : element->layout.childGap;
-        yOffset += UI_fmax3(prevMargin, child->layout.margin.top, gap);
-        UI__ElementSetY(child, baseY + yOffset + childOffset);
-        yOffset += child->box.h;
-        prevMargin = child->layout.margin.bottom;
+    for (uint32_t i = 0, n = links.childCount; i < n; i++) {
+        uint32_t child = reverseChildren ? lastChild - i : links.firstChild + i;
+        UIPadding margin = tree->spacing[child].margin;
+        float gap = i == 0 ? 0 : spacing->childGap;
+        yOffset += UI_fmax3(prevMargin, margin.top, gap);
+        tree->boxes[child].y = baseY + yOffset + childOffset;
+        yOffset += tree->boxes[child].h;
+        prevMargin = margin.bottom;
     }
 }
 
-void UI__ElementSetW(UIElement *element, float w) {
-    if (w < element->layout.w_min)
-        w = element->layout.w_min;
-    else if (w > element->layout.w_max && element->layout.w_max != 0)
-        w = element->layout.w_max;
+void UI__TreeSetW(UI__Tree *tree, uint32_t handle, float w) {
+    UI__Sizing *sizing = &tree->sizing[handle];
+    if (w < sizing->w_min)
+        w = sizing->w_min;
+    else if (w > sizing->w_max && sizing->w_max != 0)
+        w = sizing->w_max;
     if (w < 0)
         w = 0;
-    element->box.w = w;
+    tree->boxes[handle].w = w;
 }
 
-void UI__ElementSetH(UIElement *element, float h) {
-    if (h < element->layout.h_min)
-        h = element->layout.h_min;
-    else if (h > element->layout.h_max && element->layout.h_max != 0)
-        h = element->layout.h_max;
+void UI__TreeSetH(UI__Tree *tree, uint32_t handle, float h) {
+    UI__Sizing *sizing = &tree->sizing[handle];
+    if (h < sizing->h_min)
+        h = sizing->h_min;
+    else if (h > sizing->h_max && sizing->h_max != 0)
+        h = sizing->h_max;
     if (h < 0)
         h = 0;
-    element->box.h = h;
+    tree->boxes[handle].h = h;
 }
 
-void UI__ElementSetX(UIElement *element, float x) {
-    element->box.x = x;
+UI__AxisColumns UI__TreeColumnsX(UI__Tree *tree, uint32_t handle) {
+    uint32_t first = tree->links[handle].firstChild;
+    return (UI__AxisColumns) {
+        .size = &tree->boxes[first].w,
+        .minSize = &tree->sizing[first].w_min,
+        .sizing = &tree->sizing[first].w_sizing,
+        .marginBefore = &tree->spacing[first].margin.left,
+        .marginAfter = &tree->spacing[first].margin.right,
+        .count = tree->links[handle].childCount
+    };
 }
 
-void UI__ElementSetY(UIElement *element, float y) {
-    element->box.y = y;
+UI__AxisColumns UI__TreeColumnsY(UI__Tree *tree, uint32_t handle) {
+    uint32_t first = tree->links[handle].firstChild;
+    return (UI__AxisColumns) {
+        .size = &tree->boxes[first].h,
+        .minSize = &tree->sizing[first].h_min,
+        .sizing = &tree->sizing[first].h_sizing,
+        .marginBefore = &tree->spacing[first].margin.top,
+        .marginAfter = &tree->spacing[first].margin.bottom,
+        .count = tree->links[handle].childCount
+    };
 }
 
-bool UI__ElementDraw(UIElement *element) {
-    if (!UI_DrawRect(element->context, element->box, element->backgroundColor))
-        return false;
-    for (uint32_t i = 0, n = element->children.len; i < n; i++) {
-        if (!UI__ElementDraw(element->children.data[i]))
-            return false;
+float UI__ColumnsSum(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap) {
+#ifdef UI__SSE2
+    if (columns->count >= UI__SIMD_MIN_CHILDREN)
+        return UI__ColumnsSumSSE2(columns, paddingBefore, paddingAfter, gap);
+#endif
+    return UI__ColumnsSumScalar(columns, paddingBefore, paddingAfter, gap);
+}
+
+float UI__ColumnsMax(UI__AxisColumns *columns, float paddingBefore, float paddingAfter) {
+#ifdef UI__SSE2
+    if (columns->count >= UI__SIMD_MIN_CHILDREN)
+        return UI__ColumnsMaxSSE2(columns, paddingBefore, paddingAfter);
+#endif
+    return UI__ColumnsMaxScalar(columns, paddingBefore, paddingAfter);
+}
+
+void UI__FillExpand(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight)
+{
+#ifdef UI__SSE2
+    if (count >= UI__SIMD_MIN_CHILDREN) {
+        UI__FillExpandSSE2(size, weight, min, max, handles, count, space, totalWeight);
+        return;
     }
-    return true;
+#endif
+    UI__FillExpandScalar(size, weight, min, max, handles, count, space, totalWeight);
 }
 
-UIElement *UIElement_New(UIElement *parent) {
-    UIElement *element = UI__Context_AllocElement(parent->context);
-    if (element == NULL)
-        return NULL;
-    if (!UI__Element_AddChild(parent, element))
-        return NULL;
-    return element;
+bool UI__FillRounds(
+    float *size, const float *weight, const float *min, const float *max,
+    uint32_t *handles, uint32_t *count, float *space, float *totalWeight, uint32_t *iterations)
+{
+    // The sizes written could alias the pointers, the loop keeps its own copies
+    uint32_t n = *count;
+    float spaceLeft = *space;
+    float weightLeft = *totalWeight;
+    float prevSpace;
+    uint32_t rounds = 0;
+    bool done = true;
+    do {
+        if (rounds++ == UI__FILL_MAX_ROUNDS) {
+            done = false;
+            break;
+        }
+        prevSpace = spaceLeft;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t handle = handles[i];
+            float minValue = UI__SIZING_COLUMN(min, float, handle);
+            float maxValue = UI__SIZING_COLUMN(max, float, handle);
+            float weightValue = UI__SIZING_COLUMN(weight, float, handle);
+            float value = spaceLeft * weightValue / weightLeft;
+            if (value >= minValue && (value <= maxValue || maxValue == 0))
+                continue;
+            if (value < minValue)
+                value = minValue;
+            else if (value > maxValue)
+                value = maxValue;
+            weightLeft -= weightValue;
+            spaceLeft -= value;
+            // Like `UI__TreeSetW`, a maximum below the minimum is ignored
+            float clamped = value < minValue ? minValue : value;
+            *(float *)((uint8_t *)size + sizeof(UIRect) * handle) = clamped < 0 ? 0 : clamped;
+
+            // Remove the child from the fill children
+            handles[i--] = handles[--n];
+        }
+    } while (prevSpace != spaceLeft && spaceLeft >= 0);
+    *count = n;
+    *space = spaceLeft;
+    *totalWeight = weightLeft;
+    *iterations += rounds - !done;
+    return done;
 }
 
-bool UI__Element_AddChild(UIElement *parent, UIElement *child) {
-    if (parent == NULL || child == NULL)
-        return false;
-    if (child->parent != NULL)
-        return false;
+float UI__FillSolve(
+    const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint64_t *events, uint32_t count, float space, uint32_t *iterations)
+{
+    // The sum of the children is `fixed + slope * share` between two keys, the
+    // children that left their minimum and did not reach their maximum grow.
+    // The minimums go to the first `count` events and the maximums after them,
+    // the children without a minimum grow from the start and a maximum below
+    // the minimum is ignored.
+    uint64_t *maxEvents = events + count;
+    double fixed = 0;
+    double slope = 0;
+    double totalWeight = 0;
+    uint32_t growing = 0;
+    float lastMin = 0;
+    float firstMax = FLT_MAX;
+    uint32_t minCount = 0, maxCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t handle = handles[i];
+        float minValue = UI__SIZING_COLUMN(min, float, handle);
+        float maxValue = UI__SIZING_COLUMN(max, float, handle);
+        float weightValue = UI__SIZING_COLUMN(weight, float, handle);
+        float minKey = UI__FillKey(min, weight, handle);
+        totalWeight += weightValue;
+        if (minKey > 0) {
+            fixed += minValue;
+            lastMin = UI_fmax2(lastMin, minKey);
+            events[minCount++] = UI__FillEvent(minKey, handle);
+        } else {
+            slope += weightValue;
+            growing++;
+        }
+        if (maxValue != 0 && maxValue >= minValue) {
+            float maxKey = UI__FillKey(max, weight, handle);
+            firstMax = UI_fmin2(firstMax, maxKey);
+            maxEvents[maxCount++] = UI__FillEvent(maxKey, handle);
+        }
+    }
+    if (fixed >= space)
+        return 0;
+    // No child is clamped when the whole space is shared by weight
+    float share = (float)(space / totalWeight);
+    if (share >= lastMin && share <= firstMax)
+        return share;
+
+    UI__FillSort(events, minCount);
+    UI__FillSort(maxEvents, maxCount);
+
+    share = 0;
+    uint32_t i = 0, j = 0;
+    while (i < minCount || j < maxCount) {
+        // A child leaves its minimum before it reaches a maximum of the same share
+        bool leavesMin = i < minCount && (j == maxCount || events[i] >> 32 <= maxEvents[j] >> 32);
+        uint64_t event = leavesMin ? events[i++] : maxEvents[j++];
+        float next = UI__FillEventKey(event);
+        if (growing != 0 && fixed + slope * next >= space)
+            return UI_fmax2((float)((space - fixed) / slope), share);
+
+        (*iterations)++;
+        uint32_t handle = (uint32_t)event;
+        if (leavesMin) {
+            fixed -= UI__SIZING_COLUMN(min, float, handle);
+            slope += UI__SIZING_COLUMN(weight, float, handle);
+            growing++;
+        } else {
+            fixed += UI__SIZING_COLUMN(max, float, handle);
+            slope -= UI__SIZING_COLUMN(weight, float, handle);
+            // Do not keep the rounding of the sums once no child grows
+            if (--growing == 0)
+                slope = 0;
+        }
+        share = next;
+        if (growing == 0 && fixed >= space)
+            return share;
+    }
+    // Every child reached its maximum, or the remaining ones have none
+    if (growing == 0)
+        return share;
+    return UI_fmax2((float)((space - fixed) / slope), share);
+}
 
-    child->parent = parent;
+// Sort the events by key with a quick sort that leaves small ranges to an
+// insertion sort and falls back to a heap sort when the ranges are unbalanced
+void UI__FillSort(uint64_t *events, uint32_t count) {
+    uint32_t depth = 0;
+    for (uint32_t n = count; n > 1; n /= 2)
+        depth += 2;
+    UI__FillQuickSort(events, count, depth);
+
+    for (uint32_t i = 1; i < count; i++) {
+        uint64_t event = events[i];
+        uint32_t j = i;
+        for (; j > 0 && events[j - 1] > event; j--)
+            events[j] = events[j - 1];
+        events[j] = event;
+    }
+}
 
-    return UI__ChildrenAppend(&parent->children, child);
+void UI__FillQuickSort(uint64_t *events, uint32_t count, uint32_t depth) {
+    while (count > UI__FILL_SORT_MIN) {
+        if (depth-- == 0) {
+            UI__FillHeapSort(events, count);
+            return;
+        }
+        uint64_t a = events[0], b = events[count / 2], c = events[count - 1];
+        uint64_t pivot = a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+
+        // The pivot is in the range, so the scans stop before its ends
+        uint32_t i = 0, j = count - 1;
+        for (;;) {
+            while (events[i] < pivot)
+                i++;
+            while (events[j] > pivot)
+                j--;
+            if (i >= j)
+                break;
+            uint64_t event = events[i];
+            events[i] = events[j];
+            events[j] = event;
+            i++;
+            j--;
+        }
+        // When the scans meet on an event it is the pivot and stays in place
+        uint32_t leftCount = j;
+        uint32_t rightStart = j + 1;
+        if (i > j)
+            leftCount = j + 1;
+        else
+            rightStart = j + 1;
+
+        // Recurse into the smaller range so that the stack stays small
+        if (leftCount < count - rightStart) {
+            UI__FillQuickSort(events, leftCount, depth);
+            events += rightStart;
+            count -= rightStart;
+        } else {
+            UI__FillQuickSort(events + rightStart, count - rightStart, depth);
+            count = leftCount;
+        }
+    }
 }
 
-void UI__Element_RemoveChild(UIElement *child) {
-    UIElement *parent = child->parent;
-    if (parent == NULL)
-        return;
-    child->parent = NULL;
-    for (uint32_t i = 0, n = parent->children.len; i < n; i++) {
-        UIElement *ith_child = parent->children.data[i];
-        if (ith_child == child) {
-            UI__ChildrenRemoveShift(&parent->children, i);
+void UI__FillHeapSort(uint64_t *events, uint32_t count) {
+    for (uint32_t start = count / 2; start-- > 0;)
+        UI__FillSiftDown(events, start, count);
+    for (uint32_t end = count - 1; end > 0; end--) {
+        uint64_t top = events[0];
+        events[0] = events[end];
+        events[end] = top;
+        UI__FillSiftDown(events, 0, end);
+    }
+}
+
+void UI__FillSiftDown(uint64_t *events, uint32_t i, uint32_t count) {
+    uint64_t event = events[i];
+    for (uint32_t child = 2 * i + 1; child < count; child = 2 * i + 1) {
+        if (child + 1 < count && events[child + 1] > events[child])
+            child++;
+        if (events[child] <= event)
             break;
-        }
+        events[i] = events[child];
+        i = child;
     }
+    events[i] = event;
 }
 
-void UI_BackgroundColor(UIElement *element, UIColor color) {
-    element->backgroundColor = color;
+// Share of one unit of weight where the child reaches `bound`
+float UI__FillKey(const float *bound, const float *weight, uint32_t handle) {
+    float key = UI__SIZING_COLUMN(bound, float, handle) / UI__SIZING_COLUMN(weight, float, handle);
+    return key > 0 ? key : 0;
 }
 
-void UI_FitWidth(UIElement *element) {
-    element->layout.w_sizing = UISizing_fit;
-    element->layout.w_weight = 1.0f;
+// The bits of a float that is not negative are ordered like its value, so the
+// events are sorted by key with integer comparisons
+uint64_t UI__FillEvent(float key, uint32_t handle) {
+    union { float f; uint32_t bits; } value = { .f = key };
+    return (uint64_t)value.bits << 32 | handle;
 }
 
-void UI_FitHeight(UIElement *element) {
-    element->layout.h_sizing = UISizing_fit;
-    element->layout.w_weight = 1.0f;
+float UI__FillEventKey(uint64_t event) {
+    union { uint32_t bits; float f; } value = { .bits = (uint32_t)(event >> 32) };
+    return value.f;
 }
 
-void UI_FixedWidth(UIElement *element, float width) {
-    element->layout.w_sizing = UISizing_fixed;
-    element->layout.w_weight = 1.0f;
-    element->layout.w_min = width;
-    element->layout.w_max = width;
+float UI__ColumnsSumScalar(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap) {
+    float prevMargin = paddingBefore;
+    float total = 0;
+    for (uint32_t i = 0, n = columns->count; i < n; i++) {
+        if (UI__SIZING_COLUMN(columns->sizing, uint8_t, i) == UISizing_fill)
+            total += UI__SIZING_COLUMN(columns->minSize, float, i);
+        else
+            total += UI__BOX_COLUMN(columns->size, i);
+        total += UI_fmax3(prevMargin, UI__SPACING_COLUMN(columns->marginBefore, i), i == 0 ? 0 : gap);
+        prevMargin = UI__SPACING_COLUMN(columns->marginAfter, i);
+    }
+    total += UI_fmax2(paddingAfter, prevMargin);
+    return total;
 }
 
-void UI_FixedHeight(UIElement *element, float height) {
-    element->layout.h_sizing = UISizing_fixed;
-    element->layout.h_weight = 0.0f;
-    element->layout.h_min = height;
-    element->layout.h_max = height;
+float UI__ColumnsMaxScalar(UI__AxisColumns *columns, float paddingBefore, float paddingAfter) {
+    float maxTotal = 0;
+    for (uint32_t i = 0, n = columns->count; i < n; i++) {
+        float spaceBefore = UI_fmax2(paddingBefore, UI__SPACING_COLUMN(columns->marginBefore, i));
+        float spaceAfter = UI_fmax2(paddingAfter, UI__SPACING_COLUMN(columns->marginAfter, i));
+        float total = 0;
+        if (UI__SIZING_COLUMN(columns->sizing, uint8_t, i) == UISizing_fill)
+            total = UI__SIZING_COLUMN(columns->minSize, float, i) + spaceBefore + spaceAfter;
+        else
+            total = UI__BOX_COLUMN(columns->size, i) + spaceBefore + spaceAfter;
+        if (maxTotal < total)
+            maxTotal = total;
+    }
+    return maxTotal;
 }
 
-void UI_FillWidth(UIElement *element, float weight) {
-    element->layout.w_sizing = UISizing_fill;
-    element->layout.w_weight = weight;
+void UI__FillExpandScalar(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t handle = handles[i];
+        float value = space * UI__SIZING_COLUMN(weight, float, handle) / totalWeight;
+        float minValue = UI__SIZING_COLUMN(min, float, handle);
+        float maxValue = UI__SIZING_COLUMN(max, float, handle);
+        if (value < minValue)
+            value = minValue;
+        else if (value > maxValue && maxValue != 0)
+            value = maxValue;
+        if (value < 0)
+            value = 0;
+        *(float *)((uint8_t *)size + sizeof(UIRect) * handle) = value;
+    }
 }
 
-void UI_FillHeight(UIElement *element, float weight) {
-    element->layout.h_sizing = UISizing_fill;
-    element->layout.h_weight = weight;
+#ifdef UI__SSE2
+
+// The size of four children, the minimum one for fill children
+__m128 UI__ColumnsSizeSSE2(UI__AxisColumns *columns, uint32_t i) {
+    __m128i sizing = _mm_setr_epi32(
+        UI__SIZING_COLUMN(columns->sizing, uint8_t, i),
+        UI__SIZING_COLUMN(columns->sizing, uint8_t, i + 1),
+        UI__SIZING_COLUMN(columns->sizing, uint8_t, i + 2),
+        UI__SIZING_COLUMN(columns->sizing, uint8_t, i + 3));
+    __m128 fill = _mm_castsi128_ps(_mm_cmpeq_epi32(sizing, _mm_set1_epi32(UISizing_fill)));
+    __m128 size = _mm_setr_ps(
+        UI__BOX_COLUMN(columns->size, i),
+        UI__BOX_COLUMN(columns->size, i + 1),
+        UI__BOX_COLUMN(columns->size, i + 2),
+        UI__BOX_COLUMN(columns->size, i + 3));
+    __m128 minSize = _mm_setr_ps(
+        UI__SIZING_COLUMN(columns->minSize, float, i),
+        UI__SIZING_COLUMN(columns->minSize, float, i + 1),
+        UI__SIZING_COLUMN(columns->minSize, float, i + 2),
+        UI__SIZING_COLUMN(columns->minSize, float, i + 3));
+    return _mm_or_ps(_mm_and_ps(fill, minSize), _mm_andnot_ps(fill, size));
 }
 
-void UI_MinWidth(UIElement *element, float width) {
-    element->layout.w_min = width;
+__m128 UI__SpacingColumnSSE2(const float *column, uint32_t i) {
+    return _mm_setr_ps(
+        UI__SPACING_COLUMN(column, i),
+        UI__SPACING_COLUMN(column, i + 1),
+        UI__SPACING_COLUMN(column, i + 2),
+        UI__SPACING_COLUMN(column, i + 3));
 }
 
-void UI_MinHeight(UIElement *element, float height) {
-    element->layout.h_min = height;
+// The children are added in four interleaved sums, the result may differ from
+// the scalar one by the rounding of the additions
+float UI__ColumnsSumSSE2(UI__AxisColumns *columns, float paddingBefore, float paddingAfter, float gap) {
+    uint32_t n = columns->count;
+    float total = 0;
+    if (UI__SIZING_COLUMN(columns->sizing, uint8_t, 0) == UISizing_fill)
+        total += UI__SIZING_COLUMN(columns->minSize, float, 0);
+    else
+        total += UI__BOX_COLUMN(columns->size, 0);
+    total += UI_fmax3(paddingBefore, UI__SPACING_COLUMN(columns->marginBefore, 0), 0);
+
+    // The margin after a child collapses with the margin before the next one and the gap
+    __m128 gaps = _mm_set1_ps(gap);
+    __m128 sums = _mm_setzero_ps();
+    uint32_t i = 1;
+    for (; i + 4 <= n; i += 4) {
+        __m128 prevMargins = UI__SpacingColumnSSE2(columns->marginAfter, i - 1);
+        __m128 margins = UI__SpacingColumnSSE2(columns->marginBefore, i);
+        __m128 space = _mm_max_ps(prevMargins, _mm_max_ps(margins, gaps));
+        sums = _mm_add_ps(sums, _mm_add_ps(UI__ColumnsSizeSSE2(columns, i), space));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sums);
+    total += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for (; i < n; i++) {
+        if (UI__SIZING_COLUMN(columns->sizing, uint8_t, i) == UISizing_fill)
+            total += UI__SIZING_COLUMN(columns->minSize, float, i);
+        else
+            total += UI__BOX_COLUMN(columns->size, i);
+        total += UI_fmax3(
+            UI__SPACING_COLUMN(columns->marginAfter, i - 1),
+            UI__SPACING_COLUMN(columns->marginBefore, i),
+            gap);
+    }
+    total += UI_fmax2(paddingAfter, UI__SPACING_COLUMN(columns->marginAfter, n - 1));
+    return total;
 }
 
-void UI_MaxWidth(UIElement *element, float width) {
-    element->layout.w_max = width;
+float UI__ColumnsMaxSSE2(UI__AxisColumns *columns, float paddingBefore, float paddingAfter) {
+    uint32_t n = columns->count;
+    __m128 before = _mm_set1_ps(paddingBefore);
+    __m128 after = _mm_set1_ps(paddingAfter);
+    __m128 maxTotals = _mm_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 spaceBefore = _mm_max_ps(before, UI__SpacingColumnSSE2(columns->marginBefore, i));
+        __m128 spaceAfter = _mm_max_ps(after, UI__SpacingColumnSSE2(columns->marginAfter, i));
+        __m128 totals = _mm_add_ps(_mm_add_ps(UI__ColumnsSizeSSE2(columns, i), spaceBefore), spaceAfter);
+        maxTotals = _mm_max_ps(totals, maxTotals);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, maxTotals);
+    float maxTotal = UI_fmax2(UI_fmax2(lanes[0], lanes[1]), UI_fmax2(lanes[2], lanes[3]));
+
+    for (; i < n; i++) {
+        float spaceBefore = UI_fmax2(paddingBefore, UI__SPACING_COLUMN(columns->marginBefore, i));
+        float spaceAfter = UI_fmax2(paddingAfter, UI__SPACING_COLUMN(columns->marginAfter, i));
+        float total = 0;
+        if (UI__SIZING_COLUMN(columns->sizing, uint8_t, i) == UISizing_fill)
+            total = UI__SIZING_COLUMN(columns->minSize, float, i) + spaceBefore + spaceAfter;
+        else
+            total = UI__BOX_COLUMN(columns->size, i) + spaceBefore + spaceAfter;
+        if (maxTotal < total)
+            maxTotal = total;
+    }
+    return maxTotal;
 }
 
-void UI_MaxHeight(UIElement *element, float height) {
-    element->layout.h_max = height;
+// Gives the same sizes as the scalar version
+void UI__FillExpandSSE2(
+    float *size, const float *weight, const float *min, const float *max,
+    const uint32_t *handles, uint32_t count, float space, float totalWeight)
+{
+    __m128 spaces = _mm_set1_ps(space);
+    __m128 totalWeights = _mm_set1_ps(totalWeight);
+    __m128 zeros = _mm_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32_t *h = handles + i;
+        __m128 mn = _mm_setr_ps(
+            UI__SIZING_COLUMN(min, float, h[0]),
+            UI__SIZING_COLUMN(min, float, h[1]),
+            UI__SIZING_COLUMN(min, float, h[2]),
+            UI__SIZING_COLUMN(min, float, h[3]));
+        __m128 mx = _mm_setr_ps(
+            UI__SIZING_COLUMN(max, float, h[0]),
+            UI__SIZING_COLUMN(max, float, h[1]),
+            UI__SIZING_COLUMN(max, float, h[2]),
+            UI__SIZING_COLUMN(max, float, h[3]));
+        __m128 weights = _mm_setr_ps(
+            UI__SIZING_COLUMN(weight, float, h[0]),
+            UI__SIZING_COLUMN(weight, float, h[1]),
+            UI__SIZING_COLUMN(weight, float, h[2]),
+            UI__SIZING_COLUMN(weight, float, h[3]));
+        __m128 value = _mm_div_ps(_mm_mul_ps(spaces, weights), totalWeights);
+
+        // Clamp with selects, the comparisons match the ones of `UI__TreeSetW`
+        __m128 belowMin = _mm_cmplt_ps(value, mn);
+        __m128 aboveMax = _mm_andnot_ps(
+            belowMin,
+            _mm_and_ps(_mm_cmpgt_ps(value, mx), _mm_cmpneq_ps(mx, zeros)));
+        value = _mm_or_ps(_mm_and_ps(belowMin, mn), _mm_andnot_ps(belowMin, value));
+        value = _mm_or_ps(_mm_and_ps(aboveMax, mx), _mm_andnot_ps(aboveMax, value));
+        value = _mm_andnot_ps(_mm_cmplt_ps(value, zeros), value);
+
+        float values[4];
+        _mm_storeu_ps(values, value);
+        for (uint32_t j = 0; j < 4; j++)
+            *(float *)((uint8_t *)size + sizeof(UIRect) * h[j]) = values[j];
+    }
+    UI__FillExpandScalar(size, weight, min, max, handles + i, count - i, space, totalWeight);
 }
 
-void UI_Padding(UIElement *element, float padding) {
-    element->layout.padding = (UIPadding) { padding, padding, padding, padding };
+#endif // !UI__SSE2
+
+#ifdef UI_THREADS
+
+void UIContext_SetParallelLayout(UIContext *ctx, uint32_t minTaskSize) {
+    if (ctx->_taskMinSize == minTaskSize)
+        return;
+    ctx->_taskMinSize = minTaskSize;
+    ctx->_layoutPlan.dirty = true;
 }
 
-void UI_PaddingEx(UIElement *element, float top, float bottom, float left, float right) {
-    element->layout.padding = (UIPadding) { top, bottom, left, right };
+// Split the tree in tasks of whole sibling subtrees, the elements with larger
+// subtrees are laid out serially around the tasks
+bool UI__ContextPlanLayout(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    UI__LayoutPlan *plan = &ctx->_layoutPlan;
+    uint32_t minSize = ctx->_taskMinSize;
+
+    if (plan->rowCap < tree->len) {
+        uint32_t *rows = (uint32_t *)UI__MemAlloc(sizeof(uint32_t) * 3 * tree->cap);
+        if (rows == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        if (plan->serialRows != NULL)
+            UI_MemFree(plan->serialRows);
+        plan->serialRows = rows;
+        plan->rowCap = tree->cap;
+    }
+    uint32_t *subtreeSize = plan->serialRows + plan->rowCap;
+    uint32_t *drawIndex = subtreeSize + plan->rowCap;
+
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        subtreeSize[i] = 1;
+        drawIndex[tree->drawOrder[i]] = i;
+    }
+    for (uint32_t i = tree->len - 1; i > 0; i--)
+        subtreeSize[tree->links[i].parent] += subtreeSize[i];
+
+    plan->taskCount = 0;
+    plan->serialRows[0] = 0;
+    plan->serialCount = 1;
+    // Serial rows are added in breadth-first order, like the rows of the tree
+    for (uint32_t s = 0; s < plan->serialCount; s++) {
+        UI__Links links = tree->links[plan->serialRows[s]];
+        UI__LayoutTask task = { .begin = 0, .end = 0, .moved = false, .laidOut = 0, .fillIterations = 0 };
+        for (uint32_t j = 0; j <= links.childCount; j++) {
+            uint32_t child = links.firstChild + j;
+            bool split = j == links.childCount || subtreeSize[child] > minSize;
+            if (!split) {
+                if (task.begin == task.end)
+                    task.begin = drawIndex[child];
+                task.end = drawIndex[child] + subtreeSize[child];
+            }
+            if (task.begin != task.end && (split || task.end - task.begin >= minSize)) {
+                if (!UI__LayoutPlanPush(ctx, task))
+                    return false;
+                task.begin = task.end;
+            }
+            if (split && j != links.childCount)
+                plan->serialRows[plan->serialCount++] = child;
+        }
+    }
+    plan->dirty = false;
+    return true;
 }
 
-void UI_Margin(UIElement *element, float margin) {
-    element->layout.margin = (UIPadding) { margin, margin, margin, margin };
+bool UI__LayoutPlanPush(UIContext *ctx, UI__LayoutTask task) {
+    UI__LayoutPlan *plan = &ctx->_layoutPlan;
+    if (plan->taskCount == plan->taskCap) {
+        uint32_t newCap = plan->taskCap == 0 ? 16 : plan->taskCap * 2;
+        UI__LayoutTask *newTasks;
+        if (plan->tasks == NULL)
+            newTasks = (UI__LayoutTask *)UI__MemAlloc(sizeof(UI__LayoutTask) * newCap);
+        else
+            newTasks = (UI__LayoutTask *)UI__MemExpand(plan->tasks, sizeof(UI__LayoutTask) * newCap);
+        if (newTasks == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        plan->tasks = newTasks;
+        plan->taskCap = newCap;
+    }
+    plan->tasks[plan->taskCount++] = task;
+    return true;
 }
 
-void UI_MarginEx(UIElement *element, float top, float bottom, float left, float right) {
-    element->layout.margin = (UIPadding) { top, bottom, left, right };
+// Every element is laid out exactly like in the serial passes, each task only
+// writes the rows of its subtrees
+bool UI__ContextLayoutTasks(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    UI__LayoutPlan *plan = &ctx->_layoutPlan;
+    UI__STATS_START(lap);
+
+    UI__LayoutJob job = { .tree = tree, .plan = plan, .pass = UI__LayoutPass_fitWidth };
+    UI_RunTasks(ctx, UI__LayoutTaskRun, &job, plan->taskCount);
+    uint32_t laidOut = 0;
+    for (uint32_t s = plan->serialCount; s-- > 0;) {
+        laidOut += tree->dirty[plan->serialRows[s]] != 0;
+        UI__TreeFitElementWidth(tree, plan->serialRows[s]);
+    }
+    UI__STATS_LAP(ctx, UIStatsTime_fit, lap);
+
+    uint32_t fillIterations = 0;
+    for (uint32_t s = 0, n = plan->serialCount; s < n; s++)
+        fillIterations += UI__TreeFillElementWidth(tree, plan->serialRows[s]);
+    job.pass = UI__LayoutPass_fillWidth;
+    UI_RunTasks(ctx, UI__LayoutTaskRun, &job, plan->taskCount);
+    UI__STATS_LAP(ctx, UIStatsTime_fill, lap);
+
+    // Text is measured with the hooks of the backend on the calling thread
+    if (ctx->_hasWrappedText && !UI__ContextWrapText(ctx))
+        return false;
+    job.pass = UI__LayoutPass_fitHeight;
+    UI_RunTasks(ctx, UI__LayoutTaskRun, &job, plan->taskCount);
+    for (uint32_t s = plan->serialCount; s-- > 0;)
+        UI__TreeFitElementHeight(tree, plan->serialRows[s]);
+    UI__STATS_LAP(ctx, UIStatsTime_fit, lap);
+
+    for (uint32_t s = 0, n = plan->serialCount; s < n; s++)
+        fillIterations += UI__TreeFillElementHeight(tree, plan->serialRows[s]);
+    job.pass = UI__LayoutPass_fillHeight;
+    UI_RunTasks(ctx, UI__LayoutTaskRun, &job, plan->taskCount);
+    UI__STATS_LAP(ctx, UIStatsTime_fill, lap);
+
+    bool changed = false;
+    for (uint32_t s = 0, n = plan->serialCount; s < n; s++)
+        changed |= UI__TreePositionElement(tree, plan->serialRows[s]);
+    job.pass = UI__LayoutPass_position;
+    UI_RunTasks(ctx, UI__LayoutTaskRun, &job, plan->taskCount);
+    for (uint32_t i = 0, n = plan->taskCount; i < n; i++) {
+        UI__LayoutTask *task = &plan->tasks[i];
+        changed |= task->moved;
+        laidOut += task->laidOut;
+        fillIterations += task->fillIterations;
+    }
+    if (changed) {
+        ctx->_redraw = true;
+        ctx->_clipsDirty = true;
+    }
+    UI__STATS_LAP(ctx, UIStatsTime_position, lap);
+    UI__STATS_ADD(ctx, elementsLaidOut, laidOut);
+    UI__STATS_ADD(ctx, fillIterations, fillIterations);
+    return true;
 }
 
-void UI_ChildGap(UIElement *element, float childGap) {
-    element->layout.childGap = childGap;
+void UI__LayoutTaskRun(void *data, uint32_t index) {
+    UI__LayoutJob *job = (UI__LayoutJob *)data;
+    UI__Tree *tree = job->tree;
+    UI__LayoutTask *task = &job->plan->tasks[index];
+    const uint32_t *order = tree->drawOrder;
+
+    switch (job->pass) {
+    case UI__LayoutPass_fitWidth: {
+        uint32_t laidOut = 0;
+        // Depth-first order puts parents before their children
+        for (uint32_t i = task->end; i-- > task->begin;) {
+            laidOut += tree->dirty[order[i]] != 0;
+            UI__TreeFitElementWidth(tree, order[i]);
+        }
+        task->laidOut = laidOut;
+        break;
+    }
+    case UI__LayoutPass_fillWidth: {
+        uint32_t iterations = 0;
+        for (uint32_t i = task->begin; i < task->end; i++)
+            iterations += UI__TreeFillElementWidth(tree, order[i]);
+        task->fillIterations = iterations;
+        break;
+    }
+    case UI__LayoutPass_fitHeight:
+        for (uint32_t i = task->end; i-- > task->begin;)
+            UI__TreeFitElementHeight(tree, order[i]);
+        break;
+    case UI__LayoutPass_fillHeight: {
+        uint32_t iterations = 0;
+        for (uint32_t i = task->begin; i < task->end; i++)
+            iterations += UI__TreeFillElementHeight(tree, order[i]);
+        task->fillIterations += iterations;
+        break;
+    }
+    case UI__LayoutPass_position: {
+        bool moved = false;
+        for (uint32_t i = task->begin; i < task->end; i++)
+            moved |= UI__TreePositionElement(tree, order[i]);
+        task->moved = moved;
+        break;
+    }
+    }
 }
 
-void UI_AlignX(UIElement *element, UIAlignX align) {
-    element->layout.alignX = align;
+#endif // !UI_THREADS
+
+// Compute the bounds of the subtrees from the leaves up, then the clips from the root down
+void UI__TreeClip(UI__Tree *tree, UIRect window) {
+    for (uint32_t i = 0, n = tree->len; i < n; i++)
+        tree->bounds[i] = tree->boxes[i];
+    for (uint32_t i = tree->len; i-- > 1;) {
+        // The children of the element were already merged
+        if (tree->clipChildren[i])
+            tree->bounds[i] = UI__RectIntersect(tree->bounds[i], tree->boxes[i]);
+        uint32_t parent = tree->links[i].parent;
+        tree->bounds[parent] = UI__RectUnion(tree->bounds[parent], tree->bounds[i]);
+    }
+
+    tree->clips[0] = window;
+    for (uint32_t i = 1, n = tree->len; i < n; i++) {
+        uint32_t parent = tree->links[i].parent;
+        tree->clips[i] = tree->clipChildren[parent]
+            ? UI__RectIntersect(tree->clips[parent], tree->boxes[parent])
+            : tree->clips[parent];
+    }
 }
 
-void UI_AlignY(UIElement *element, UIAlignY align) {
-    element->layout.alignY = align;
+// Push the commands of the elements that overlap the damage of the draw list,
+// an element is drawn once for each damaged rectangle it overlaps
+bool UI__TreeDraw(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    const UIDrawList *list = &ctx->drawList;
+    if (list->damageCount == 0)
+        return true;
+    UIRect area = list->damage[0];
+    for (uint32_t k = 1; k < list->damageCount; k++)
+        area = UI__RectUnion(area, list->damage[k]);
+
+    for (uint32_t i = 0, n = tree->len; i < n;) {
+        uint32_t handle = tree->drawOrder[i];
+        UIRect clip = tree->clips[handle];
+        UIRect bounds = tree->bounds[handle];
+        // Nothing in the subtree can be visible or damaged
+        if (!UI__RectOverlaps(bounds, clip) || !UI__RectOverlaps(bounds, area)) {
+            i = tree->drawEnd[handle];
+            continue;
+        }
+        UIColor color = tree->colors[handle];
+        UIRect box = tree->boxes[handle];
+        bool hasText = tree->sizing[handle].contentW > 0;
+        for (uint32_t k = 0; k < list->damageCount && (color.a != 0 || hasText); k++) {
+            UIRect damageClip = UI__RectIntersect(clip, list->damage[k]);
+            if (!UI__RectOverlaps(box, damageClip))
+                continue;
+            if (color.a != 0 && !UI__DrawListPush(ctx, box, color, damageClip, (UIRect) { 0, 0, 0, 0 }))
+                return false;
+            if (hasText && !UI__DrawText(ctx, handle, damageClip))
+                return false;
+        }
+        i++;
+    }
+    return true;
 }
 
-void UI_LayoutDirection(UIElement *element, UILayoutDirection direction) {
-    element->layout.direction = direction;
+// Check if the element pushes any command when it is visible
+bool UI__TreeDrawsElement(UI__Tree *tree, uint32_t handle) {
+    return tree->colors[handle].a != 0 || tree->sizing[handle].contentW > 0;
 }
 
-float UI_fmax2(float a, float b) {
-    return a > b ? a : b;
+// Damage the old and the new visible part of the elements whose box or clip
+// changed and move them in the hit grid, called after the clips are computed
+void UI__ContextDamageVisible(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    UI__HitGrid *grid = &ctx->_hitGrid;
+    // The levels of the grid cover the window
+    if (grid->windowW != ctx->window.w || grid->windowH != ctx->window.h)
+        grid->dirty = true;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UIRect visible = UI__RectIntersect(tree->boxes[i], tree->clips[i]);
+        if (visible.w == 0 || visible.h == 0)
+            visible = (UIRect) { 0, 0, 0, 0 };
+        UIRect last = tree->visible[i];
+        if (visible.x == last.x && visible.y == last.y && visible.w == last.w && visible.h == last.h)
+            continue;
+        tree->visible[i] = visible;
+        if (!grid->dirty) {
+            UI__HitGridMove(grid, i, visible);
+            // Moved elements are slower to find, the next query builds the grid again
+            grid->dirty = grid->movedCount > n / 4;
+        }
+        if (ctx->_partialRedraw && UI__TreeDrawsElement(tree, i)) {
+            UI__ContextDamage(ctx, last);
+            UI__ContextDamage(ctx, visible);
+        }
+    }
 }
 
-float UI_fmax3(float a, float b, float c) {
-    return a > b && a > c ? a : b > c ? b : c;
+// Add `rect` rounded out to whole pixels to the damage of the next frame.
+// Overlapping rectangles are merged, when there are too many the pair whose
+// union adds the least area is merged.
+void UI__ContextDamage(UIContext *ctx, UIRect rect) {
+    if (!ctx->_partialRedraw)
+        return;
+    rect = UI__RectIntersect(rect, (UIRect) { 0, 0, (float)ctx->window.w, (float)ctx->window.h });
+    if (rect.w == 0 || rect.h == 0)
+        return;
+    // The coordinates are not negative after the intersection
+    uint32_t x0 = (uint32_t)rect.x;
+    uint32_t y0 = (uint32_t)rect.y;
+    uint32_t x1 = (uint32_t)(rect.x + rect.w);
+    uint32_t y1 = (uint32_t)(rect.y + rect.h);
+    x1 += (float)x1 < rect.x + rect.w;
+    y1 += (float)y1 < rect.y + rect.h;
+    rect = (UIRect) { (float)x0, (float)y0, (float)(x1 - x0), (float)(y1 - y0) };
+
+    UIRect *damage = ctx->_damage;
+    uint32_t k = 0;
+    while (k < ctx->_damageCount || ctx->_damageCount == UI_DAMAGE_RECTS) {
+        if (k == ctx->_damageCount) {
+            // Every rectangle is used and none overlaps `rect`
+            float bestCost = FLT_MAX;
+            for (uint32_t j = 0; j < ctx->_damageCount; j++) {
+                float cost = UI__RectArea(UI__RectUnion(damage[j], rect)) - UI__RectArea(damage[j]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    k = j;
+                }
+            }
+        } else if (!UI__RectOverlaps(damage[k], rect)) {
+            k++;
+            continue;
+        }
+        // The union may overlap the rectangles already checked
+        rect = UI__RectUnion(damage[k], rect);
+        damage[k] = damage[--ctx->_damageCount];
+        k = 0;
+    }
+    damage[ctx->_damageCount++] = rect;
+}
+
+// Move the damage to the draw list of the frame being drawn
+void UI__ContextTakeDamage(UIContext *ctx) {
+    UIDrawList *list = &ctx->drawList;
+    list->partial = ctx->_partialRedraw;
+    if (!ctx->_partialRedraw) {
+        list->damage[0] = (UIRect) { 0, 0, (float)ctx->window.w, (float)ctx->window.h };
+        list->damageCount = 1;
+        return;
+    }
+    for (uint32_t k = 0; k < ctx->_damageCount; k++)
+        list->damage[k] = ctx->_damage[k];
+    list->damageCount = ctx->_damageCount;
+    ctx->_damageCount = 0;
+}
+
+// Damage the part of `element` drawn by the last frame
+void UI__ElementDamage(UIElement *element) {
+    uint32_t handle = UI__ElementHandle(element);
+    // New elements are damaged when the clips are computed
+    if (handle != UI__NO_HANDLE)
+        UI__ContextDamage(element->context, element->context->_tree.visible[handle]);
+}
+
+// Push the glyphs of the text of an element, placing the missing ones in the atlas
+bool UI__DrawText(UIContext *ctx, uint32_t handle, UIRect clip) {
+    UI__Tree *tree = &ctx->_tree;
+    UIText *text = &tree->elements[handle]->text;
+    UIFontMetrics font;
+    if (text->str == NULL || !UI_FontMetrics(ctx, text->font, &font))
+        return true;
+
+    UIRect box = tree->boxes[handle];
+    UI__Spacing *spacing = &tree->spacing[handle];
+    UIPadding padding = spacing->padding;
+    float innerW = box.w - padding.left - padding.right;
+    // Text that does not wrap is a single line
+    UI__TextLine line = { 0, text->len, tree->sizing[handle].contentW };
+    const UI__TextLine *lines = &line;
+    uint32_t lineCount = 1;
+    if (text->wrap) {
+        UI__TextLayout *layout = UI__ContextTextLayout(ctx, text, UI_fmax2(innerW, 0));
+        if (layout == NULL)
+            return false;
+        lines = layout->lines;
+        lineCount = layout->lineCount;
+    }
+
+    float freeH = box.h - padding.top - padding.bottom - font.lineHeight * lineCount;
+    float y = box.y + padding.top + font.ascent;
+    if (spacing->alignY == UIAlignY_bottom)
+        y += freeH;
+    else if (spacing->alignY == UIAlignY_center)
+        y += freeH / 2.0f;
+
+    // Text does not overflow the box of its element
+    clip = UI__RectIntersect(clip, box);
+    for (uint32_t l = 0; l < lineCount; l++, y += font.lineHeight) {
+        float freeW = innerW - lines[l].width;
+        float x = box.x + padding.left;
+        if (spacing->alignX == UIAlignX_right)
+            x += freeW;
+        else if (spacing->alignX == UIAlignX_center)
+            x += freeW / 2.0f;
+
+        for (uint32_t i = lines[l].begin; i < lines[l].end;) {
+            uint32_t codepoint = UI__Utf8Next(text->str, lines[l].end, &i);
+            uint32_t index = UI__AtlasGlyph(ctx, text->font, codepoint);
+            if (index == UI__NO_HANDLE)
+                return false;
+            UIGlyphMetrics metrics = ctx->atlas._glyphs[index].metrics;
+            UIRect rect = { x + metrics.x, y + metrics.y, (float)metrics.w, (float)metrics.h };
+            x += metrics.advance;
+            if (metrics.w == 0 || metrics.h == 0 || !UI__RectOverlaps(rect, clip))
+                continue;
+            if (!UI__AtlasPlace(ctx, index))
+                return false;
+            // The atlas may be full of glyphs of this frame
+            uint32_t slot = ctx->atlas._glyphs[index].slot;
+            if (slot == UI__NO_HANDLE)
+                continue;
+            UIRect src = { ctx->atlas._slots[slot].x, ctx->atlas._slots[slot].y, rect.w, rect.h };
+            if (!UI__DrawListPush(ctx, rect, text->color, clip, src))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Get the size of a line of `text`
+bool UI__TextMeasure(UIContext *ctx, UIText *text, float *w, float *h) {
+    UIFontMetrics font;
+    if (!UI_FontMetrics(ctx, text->font, &font))
+        return true;
+    float width = 0;
+    for (uint32_t i = 0; i < text->len;) {
+        uint32_t index = UI__AtlasGlyph(ctx, text->font, UI__Utf8Next(text->str, text->len, &i));
+        if (index == UI__NO_HANDLE)
+            return false;
+        width += ctx->atlas._glyphs[index].metrics.advance;
+    }
+    *w = width;
+    *h = font.lineHeight;
+    return true;
+}
+
+// Set the size of the content of `element` to the size of its text, wrapped
+// text takes the size of its lines broken only at '\n'
+void UI__ElementMeasureText(UIElement *element) {
+    UIText *text = &element->text;
+    float w = 0;
+    float h = 0;
+    if (text->str != NULL && text->wrap) {
+        UI__TextLayout *layout = UI__ContextTextLayout(element->context, text, UI__NO_WRAP);
+        if (layout == NULL)
+            return;
+        w = layout->maxWidth;
+        h = layout->height;
+    } else if (text->str != NULL && !UI__TextMeasure(element->context, text, &w, &h))
+        return;
+    if (element->contentW == w && element->contentH == h)
+        return;
+    element->contentW = w;
+    element->contentH = h;
+    UI__ElementMarkDirty(element);
+}
+
+// Get the lines of `text` broken to fit `width`, NULL when out of memory
+UI__TextLayout *UI__ContextTextLayout(UIContext *ctx, UIText *text, float width) {
+    UI__TextCache *cache = &ctx->_textCache;
+    if (cache->layouts == NULL && !UI__TextCacheInit(ctx))
+        return NULL;
+
+    uint32_t hash = UI__HashF32(UI__HashU32(text->hash, text->font), width);
+    uint32_t *bucket = &cache->buckets[hash & (UI_TEXT_CACHE_SIZE * 2 - 1)];
+    for (uint32_t i = *bucket; i != UI__NO_HANDLE; i = cache->layouts[i].chain) {
+        UI__TextLayout *layout = &cache->layouts[i];
+        if (layout->str == text->str && layout->len == text->len && layout->hash == hash
+            && layout->font == text->font && layout->width == width)
+        {
+            UI__TextCacheTouch(cache, i);
+            return layout;
+        }
+    }
+
+    // The layout used longest ago leaves its bucket
+    uint32_t index = cache->last;
+    UI__TextLayout *layout = &cache->layouts[index];
+    if (layout->str != NULL) {
+        uint32_t *link = &cache->buckets[layout->hash & (UI_TEXT_CACHE_SIZE * 2 - 1)];
+        while (*link != index)
+            link = &cache->layouts[*link].chain;
+        *link = layout->chain;
+        layout->str = NULL;
+    }
+    if (!UI__TextBreakLines(ctx, text, width, layout))
+        return NULL;
+    layout->str = text->str;
+    layout->len = text->len;
+    layout->hash = hash;
+    layout->font = text->font;
+    layout->width = width;
+    layout->chain = *bucket;
+    *bucket = index;
+    UI__TextCacheTouch(cache, index);
+    UI__STATS_ADD(ctx, textLayouts, 1);
+    return layout;
+}
+
+// Allocate the layouts and the buckets of the cache in one block, with the
+// layouts listed in order
+bool UI__TextCacheInit(UIContext *ctx) {
+    UI__TextCache *cache = &ctx->_textCache;
+    cache->layouts = (UI__TextLayout *)UI__MemAlloc(
+        (sizeof(UI__TextLayout) + sizeof(uint32_t) * 2) * UI_TEXT_CACHE_SIZE);
+    if (cache->layouts == NULL) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    cache->buckets = (uint32_t *)(cache->layouts + UI_TEXT_CACHE_SIZE);
+    for (uint32_t i = 0; i < UI_TEXT_CACHE_SIZE; i++) {
+        cache->layouts[i] = (UI__TextLayout) {
+            .str = NULL,
+            .lines = NULL,
+            .lineCount = 0,
+            .lineCap = 0,
+            .chain = UI__NO_HANDLE,
+            .prev = i == 0 ? UI__NO_HANDLE : i - 1,
+            .next = i == UI_TEXT_CACHE_SIZE - 1 ? UI__NO_HANDLE : i + 1
+        };
+    }
+    for (uint32_t i = 0; i < UI_TEXT_CACHE_SIZE * 2; i++)
+        cache->buckets[i] = UI__NO_HANDLE;
+    cache->first = 0;
+    cache->last = UI_TEXT_CACHE_SIZE - 1;
+    return true;
+}
+
+// Move the layout at `index` to the front of the list
+void UI__TextCacheTouch(UI__TextCache *cache, uint32_t index) {
+    if (cache->first == index)
+        return;
+    UI__TextLayout *layout = &cache->layouts[index];
+    cache->layouts[layout->prev].next = layout->next;
+    if (layout->next == UI__NO_HANDLE)
+        cache->last = layout->prev;
+    else
+        cache->layouts[layout->next].prev = layout->prev;
+    layout->prev = UI__NO_HANDLE;
+    layout->next = cache->first;
+    cache->layouts[cache->first].prev = index;
+    cache->first = index;
+}
+
+// Break `text` into lines no wider than `width` at spaces, words wider than a
+// line are broken between two characters. '\n' always ends a line.
+bool UI__TextBreakLines(UIContext *ctx, UIText *text, float width, UI__TextLayout *layout) {
+    layout->lineCount = 0;
+    layout->maxWidth = 0;
+    layout->height = 0;
+    UIFontMetrics font;
+    if (!UI_FontMetrics(ctx, text->font, &font))
+        return true;
+
+    uint32_t lineBegin = 0;
+    uint32_t contentEnd = 0; // After the last character of the line that is not a space
+    float contentW = 0;
+    float x = 0;
+    // After a word there is a place to break the line: the line ends at
+    // `breakEnd` and the next one begins after the spaces at `breakNext`
+    bool canBreak = false;
+    uint32_t breakEnd = 0;
+    uint32_t breakNext = 0;
+    float breakW = 0;
+    float breakNextX = 0;
+    for (uint32_t i = 0; i < text->len;) {
+        uint32_t start = i;
+        uint32_t codepoint = UI__Utf8Next(text->str, text->len, &i);
+        if (codepoint == '\n') {
+            if (!UI__TextLayoutPush(ctx, layout, lineBegin, contentEnd, contentW))
+                return false;
+            lineBegin = contentEnd = i;
+            x = contentW = 0;
+            canBreak = false;
+            continue;
+        }
+        uint32_t index = UI__AtlasGlyph(ctx, text->font, codepoint);
+        if (index == UI__NO_HANDLE)
+            return false;
+        float advance = ctx->atlas._glyphs[index].metrics.advance;
+
+        // Spaces at the end of a line can overflow it
+        if (codepoint == ' ') {
+            if (contentEnd == start && contentEnd != lineBegin) {
+                canBreak = true;
+                breakEnd = contentEnd;
+                breakW = contentW;
+            }
+            x += advance;
+            breakNext = i;
+            breakNextX = x;
+            continue;
+        }
+
+        // Every line has at least one character
+        while (x + advance > width && contentEnd != lineBegin) {
+            if (canBreak) {
+                if (!UI__TextLayoutPush(ctx, layout, lineBegin, breakEnd, breakW))
+                    return false;
+                lineBegin = breakNext;
+                x -= breakNextX;
+                if (contentEnd > breakNext)
+                    contentW -= breakNextX;
+                else {
+                    contentEnd = breakNext;
+                    contentW = 0;
+                }
+                canBreak = false;
+            } else {
+                if (!UI__TextLayoutPush(ctx, layout, lineBegin, contentEnd, contentW))
+                    return false;
+                lineBegin = contentEnd = start;
+                x = contentW = 0;
+            }
+        }
+        x += advance;
+        contentEnd = i;
+        contentW = x;
+    }
+    if (!UI__TextLayoutPush(ctx, layout, lineBegin, contentEnd, contentW))
+        return false;
+    layout->height = font.lineHeight * layout->lineCount;
+    return true;
+}
+
+bool UI__TextLayoutPush(UIContext *ctx, UI__TextLayout *layout, uint32_t begin, uint32_t end, float width) {
+    if (layout->lineCount == layout->lineCap) {
+        uint32_t newCap = layout->lineCap == 0 ? 4 : layout->lineCap * 2;
+        UI__TextLine *newLines;
+        if (layout->lines == NULL)
+            newLines = (UI__TextLine *)UI__MemAlloc(sizeof(UI__TextLine) * newCap);
+        else
+            newLines = (UI__TextLine *)UI__MemExpand(layout->lines, sizeof(UI__TextLine) * newCap);
+        if (newLines == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        layout->lines = newLines;
+        layout->lineCap = newCap;
+    }
+    layout->lines[layout->lineCount++] = (UI__TextLine) { begin, end, width };
+    layout->maxWidth = UI_fmax2(layout->maxWidth, width);
+    return true;
+}
+
+void UI__ContextFreeTextLayouts(UIContext *ctx) {
+    UI__TextCache *cache = &ctx->_textCache;
+    if (cache->layouts == NULL)
+        return;
+    for (uint32_t i = 0; i < UI_TEXT_CACHE_SIZE; i++) {
+        if (cache->layouts[i].lines != NULL)
+            UI_MemFree(cache->layouts[i].lines);
+    }
+    UI_MemFree(cache->layouts);
+    *cache = (UI__TextCache) { .layouts = NULL, .buckets = NULL };
+}
+
+// Decode the codepoint at `*i` and move `*i` past it, invalid bytes are U+FFFD
+uint32_t UI__Utf8Next(const char *str, uint32_t len, uint32_t *i) {
+    const uint8_t *bytes = (const uint8_t *)str;
+    uint32_t c = bytes[(*i)++];
+    if (c < 0x80)
+        return c;
+    uint32_t extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+    if (extra == 0 || c >= 0xf8)
+        return 0xfffd;
+    uint32_t codepoint = c & (0x3f >> extra);
+    for (uint32_t k = 0; k < extra; k++) {
+        if (*i >= len || (bytes[*i] & 0xc0) != 0x80)
+            return 0xfffd;
+        codepoint = codepoint << 6 | (bytes[(*i)++] & 0x3f);
+    }
+    return codepoint;
+}
+
+void UI__AtlasDestroy(UIGlyphAtlas *atlas) {
+    if (atlas->pixels != NULL)
+        UI_MemFree(atlas->pixels);
+    if (atlas->_slots != NULL)
+        UI_MemFree(atlas->_slots);
+    if (atlas->_glyphs != NULL)
+        UI_MemFree(atlas->_glyphs);
+    *atlas = (UIGlyphAtlas) { .pixels = NULL, ._slots = NULL, ._glyphs = NULL };
+}
+
+// Get the index of a glyph in the table, measuring it if it is new.
+// Return `UI__NO_HANDLE` when out of memory.
+uint32_t UI__AtlasGlyph(UIContext *ctx, uint32_t font, uint32_t codepoint) {
+    UIGlyphAtlas *atlas = &ctx->atlas;
+    // Keep the load factor at most 1/2
+    if ((atlas->_glyphLen + 1) * 2 > atlas->_glyphCap
+        && !UI__AtlasGlyphsResize(ctx, atlas->_glyphCap == 0 ? 256 : atlas->_glyphCap * 2))
+    {
+        return UI__NO_HANDLE;
+    }
+    uint32_t mask = atlas->_glyphCap - 1;
+    uint32_t i = UI__HashU32(UI__HashU32(0, font), codepoint) & mask;
+    for (;; i = (i + 1) & mask) {
+        UI__Glyph *glyph = &atlas->_glyphs[i];
+        if (glyph->font == font && glyph->codepoint == codepoint)
+            return i;
+        if (glyph->codepoint == UINT32_MAX)
+            break;
+    }
+
+    // Glyphs missing from the font take no space
+    UI__Glyph *glyph = &atlas->_glyphs[i];
+    *glyph = (UI__Glyph) { .font = font, .codepoint = codepoint, .slot = UI__NO_HANDLE };
+    if (!UI_GlyphMetrics(ctx, font, codepoint, &glyph->metrics))
+        glyph->metrics = (UIGlyphMetrics) { .advance = 0, .x = 0, .y = 0, .w = 0, .h = 0 };
+    atlas->_glyphLen++;
+    return i;
+}
+
+bool UI__AtlasGlyphsResize(UIContext *ctx, uint32_t cap) {
+    UIGlyphAtlas *atlas = &ctx->atlas;
+    UI__Glyph *glyphs = (UI__Glyph *)UI__MemAlloc(sizeof(UI__Glyph) * cap);
+    if (glyphs == NULL) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    for (uint32_t i = 0; i < cap; i++)
+        glyphs[i].codepoint = UINT32_MAX;
+
+    for (uint32_t i = 0; i < atlas->_glyphCap; i++) {
+        UI__Glyph glyph = atlas->_glyphs[i];
+        if (glyph.codepoint == UINT32_MAX)
+            continue;
+        uint32_t j = UI__HashU32(UI__HashU32(0, glyph.font), glyph.codepoint) & (cap - 1);
+        while (glyphs[j].codepoint != UINT32_MAX)
+            j = (j + 1) & (cap - 1);
+        glyphs[j] = glyph;
+        // The slots point back to the glyphs
+        if (glyph.slot != UI__NO_HANDLE)
+            atlas->_slots[glyph.slot].glyph = j;
+    }
+    if (atlas->_glyphs != NULL)
+        UI_MemFree(atlas->_glyphs);
+    atlas->_glyphs = glyphs;
+    atlas->_glyphCap = cap;
+    return true;
+}
+
+// Allocate the pixels, the first slot is kept fully covered for `atlas->white`
+bool UI__AtlasInit(UIContext *ctx) {
+    UIGlyphAtlas *atlas = &ctx->atlas;
+    atlas->pixels = (uint8_t *)UI__MemAlloc(UI_ATLAS_SIZE * UI_ATLAS_SIZE);
+    if (atlas->pixels == NULL) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    atlas->_shelfEnd = 0;
+    atlas->_slotCount = 0;
+    for (uint32_t c = 0; c < UI__ATLAS_CLASSES; c++) {
+        atlas->_first[c] = UI__NO_HANDLE;
+        atlas->_last[c] = UI__NO_HANDLE;
+    }
+    if (!UI__AtlasAddShelf(ctx, 0))
+        return false;
+
+    uint32_t slot = atlas->_first[0];
+    UI__AtlasUnlink(atlas, 0, slot);
+    for (uint32_t y = 0; y < UI__ATLAS_MIN_SLOT; y++) {
+        for (uint32_t x = 0; x < UI__ATLAS_MIN_SLOT; x++)
+            atlas->pixels[y * UI_ATLAS_SIZE + x] = 255;
+    }
+    atlas->white = (UIRect) { 0, 0, UI__ATLAS_MIN_SLOT, UI__ATLAS_MIN_SLOT };
+    atlas->dirty = atlas->white;
+    return true;
+}
+
+// Add a shelf of free slots at the end of the list of `sizeClass`
+bool UI__AtlasAddShelf(UIContext *ctx, uint32_t sizeClass) {
+    UIGlyphAtlas *atlas = &ctx->atlas;
+    uint32_t size = UI__ATLAS_MIN_SLOT << sizeClass;
+    uint32_t count = UI_ATLAS_SIZE / size;
+    if (atlas->_slotCount + count > atlas->_slotCap) {
+        uint32_t cap = atlas->_slotCap == 0 ? 256 : atlas->_slotCap;
+        while (cap < atlas->_slotCount + count)
+            cap *= 2;
+        UI__AtlasSlot *slots;
+        if (atlas->_slots == NULL)
+            slots = (UI__AtlasSlot *)UI__MemAlloc(sizeof(UI__AtlasSlot) * cap);
+        else
+            slots = (UI__AtlasSlot *)UI__MemExpand(atlas->_slots, sizeof(UI__AtlasSlot) * cap);
+        if (slots == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        atlas->_slots = slots;
+        atlas->_slotCap = cap;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = atlas->_slotCount++;
+        atlas->_slots[slot] = (UI__AtlasSlot) {
+            .x = (uint16_t)(i * size),
+            .y = (uint16_t)atlas->_shelfEnd,
+            .glyph = UI__NO_HANDLE,
+            .frame = 0,
+            .sizeClass = sizeClass
+        };
+        UI__AtlasPushBack(atlas, sizeClass, slot);
+    }
+    atlas->_shelfEnd += size;
+    return true;
+}
+
+// Make sure a glyph is in the atlas and mark it as used by this frame. The
+// glyph is left without a slot if every slot of its size is used by this frame.
+bool UI__AtlasPlace(UIContext *ctx, uint32_t glyph) {
+    UIGlyphAtlas *atlas = &ctx->atlas;
+    if (atlas->pixels == NULL && !UI__AtlasInit(ctx))
+        return false;
+    UI__Glyph *entry = &atlas->_glyphs[glyph];
+    uint32_t slot = entry->slot;
+    if (slot != UI__NO_HANDLE) {
+        if (atlas->_slots[slot].frame != atlas->_frame) {
+            UI__AtlasUnlink(atlas, atlas->_slots[slot].sizeClass, slot);
+            UI__AtlasPushFront(atlas, atlas->_slots[slot].sizeClass, slot);
+            atlas->_slots[slot].frame = atlas->_frame;
+        }
+        return true;
+    }
+
+    uint32_t size = entry->metrics.w > entry->metrics.h ? entry->metrics.w : entry->metrics.h;
+    uint32_t sizeClass = 0;
+    while (sizeClass < UI__ATLAS_CLASSES && (UI__ATLAS_MIN_SLOT << sizeClass) < size)
+        sizeClass++;
+    // Glyphs larger than the largest slots are not drawn
+    if (sizeClass == UI__ATLAS_CLASSES)
+        return true;
+
+    // Free slots are at the end of the list, after the least recently used one
+    slot = atlas->_last[sizeClass];
+    if ((slot == UI__NO_HANDLE || atlas->_slots[slot].glyph != UI__NO_HANDLE)
+        && atlas->_shelfEnd + (UI__ATLAS_MIN_SLOT << sizeClass) <= UI_ATLAS_SIZE)
+    {
+        if (!UI__AtlasAddShelf(ctx, sizeClass))
+            return false;
+        slot = atlas->_last[sizeClass];
+    }
+    if (slot == UI__NO_HANDLE || atlas->_slots[slot].frame == atlas->_frame)
+        return true;
+    if (atlas->_slots[slot].glyph != UI__NO_HANDLE)
+        atlas->_glyphs[atlas->_slots[slot].glyph].slot = UI__NO_HANDLE;
+
+    UI__AtlasSlot *placed = &atlas->_slots[slot];
+    uint8_t *pixels = atlas->pixels + placed->y * UI_ATLAS_SIZE + placed->x;
+    if (!UI_GlyphRasterize(ctx, entry->font, entry->codepoint, pixels, UI_ATLAS_SIZE)) {
+        placed->glyph = UI__NO_HANDLE;
+        return true;
+    }
+    placed->glyph = glyph;
+    placed->frame = atlas->_frame;
+    entry->slot = slot;
+    UI__AtlasUnlink(atlas, sizeClass, slot);
+    UI__AtlasPushFront(atlas, sizeClass, slot);
+
+    UIRect rect = { placed->x, placed->y, (float)entry->metrics.w, (float)entry->metrics.h };
+    atlas->dirty = atlas->dirty.w == 0 ? rect : UI__RectUnion(atlas->dirty, rect);
+    return true;
+}
+
+void UI__AtlasUnlink(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot) {
+    UI__AtlasSlot *entry = &atlas->_slots[slot];
+    if (entry->prev == UI__NO_HANDLE)
+        atlas->_first[sizeClass] = entry->next;
+    else
+        atlas->_slots[entry->prev].next = entry->next;
+    if (entry->next == UI__NO_HANDLE)
+        atlas->_last[sizeClass] = entry->prev;
+    else
+        atlas->_slots[entry->next].prev = entry->prev;
+}
+
+void UI__AtlasPushFront(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot) {
+    UI__AtlasSlot *entry = &atlas->_slots[slot];
+    entry->prev = UI__NO_HANDLE;
+    entry->next = atlas->_first[sizeClass];
+    if (entry->next == UI__NO_HANDLE)
+        atlas->_last[sizeClass] = slot;
+    else
+        atlas->_slots[entry->next].prev = slot;
+    atlas->_first[sizeClass] = slot;
+}
+
+void UI__AtlasPushBack(UIGlyphAtlas *atlas, uint32_t sizeClass, uint32_t slot) {
+    UI__AtlasSlot *entry = &atlas->_slots[slot];
+    entry->next = UI__NO_HANDLE;
+    entry->prev = atlas->_last[sizeClass];
+    if (entry->prev == UI__NO_HANDLE)
+        atlas->_first[sizeClass] = slot;
+    else
+        atlas->_slots[entry->prev].next = slot;
+    atlas->_last[sizeClass] = slot;
+}
+
+UIElement *UI_HitTest(UIContext *ctx, float x, float y) {
+    if (ctx->_hitGrid.dirty && !UI__ContextBuildHitGrid(ctx))
+        return NULL;
+    UI__HitGrid *grid = &ctx->_hitGrid;
+    UI__Tree *tree = &ctx->_tree;
+    if (tree->len == 0)
+        return NULL;
+
+    // The topmost element is the last one drawn
+    uint32_t best = UI__NO_HANDLE;
+    for (uint32_t l = 0; l < grid->levelCount; l++) {
+        UI__HitLevel level = grid->levels[l];
+        uint32_t col = UI__HitGridCell(x, level.cellSize, level.cols);
+        uint32_t row = UI__HitGridCell(y, level.cellSize, level.rows);
+        // Elements in the cells above and on the left may reach the point
+        for (uint32_t r = row == 0 ? 0 : row - 1; r <= row; r++) {
+            for (uint32_t c = col == 0 ? 0 : col - 1; c <= col; c++) {
+                uint32_t cell = level.firstCell + r * level.cols + c;
+                for (uint32_t i = grid->cellStart[cell + 1]; i-- > grid->cellStart[cell];) {
+                    UI__HitEntry *entry = &grid->entries[i];
+                    if (best != UI__NO_HANDLE && entry->drawIndex <= best)
+                        break;
+                    UIRect rect = entry->rect;
+                    if (x < rect.x || x >= rect.x + rect.w || y < rect.y || y >= rect.y + rect.h)
+                        continue;
+                    // Elements destroyed since the last frame let the hit through
+                    if (tree->elements[tree->drawOrder[entry->drawIndex]] != NULL) {
+                        best = entry->drawIndex;
+                        break;
+                    }
+                }
+                for (uint32_t h = grid->cellMoved[cell]; h != UI__NO_HANDLE; h = grid->moved[h].next) {
+                    UI__HitMoved *entry = &grid->moved[h];
+                    if (best != UI__NO_HANDLE && entry->drawIndex <= best)
+                        break;
+                    UIRect rect = entry->rect;
+                    if (x < rect.x || x >= rect.x + rect.w || y < rect.y || y >= rect.y + rect.h)
+                        continue;
+                    if (tree->elements[h] != NULL) {
+                        best = entry->drawIndex;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return best == UI__NO_HANDLE ? NULL : tree->elements[tree->drawOrder[best]];
+}
+
+uint32_t UI_QueryRect(UIContext *ctx, UIRect rect, UIElement **elements, uint32_t cap) {
+    if (ctx->_hitGrid.dirty && !UI__ContextBuildHitGrid(ctx))
+        return 0;
+    UI__HitGrid *grid = &ctx->_hitGrid;
+    UI__Tree *tree = &ctx->_tree;
+    if (tree->len == 0)
+        return 0;
+
+    uint32_t count = 0;
+    for (uint32_t l = 0; l < grid->levelCount; l++) {
+        UI__HitLevel level = grid->levels[l];
+        uint32_t col0 = UI__HitGridCell(rect.x, level.cellSize, level.cols);
+        uint32_t row0 = UI__HitGridCell(rect.y, level.cellSize, level.rows);
+        uint32_t col1 = UI__HitGridCell(rect.x + rect.w, level.cellSize, level.cols);
+        uint32_t row1 = UI__HitGridCell(rect.y + rect.h, level.cellSize, level.rows);
+        col0 -= col0 != 0;
+        row0 -= row0 != 0;
+        for (uint32_t r = row0; r <= row1; r++) {
+            for (uint32_t c = col0; c <= col1; c++) {
+                uint32_t cell = level.firstCell + r * level.cols + c;
+                for (uint32_t i = grid->cellStart[cell], n = grid->cellStart[cell + 1]; i < n; i++) {
+                    UI__HitEntry *entry = &grid->entries[i];
+                    UIElement *element = tree->elements[tree->drawOrder[entry->drawIndex]];
+                    // The entries of moved elements are empty
+                    if (element == NULL || entry->rect.w == 0 || !UI__RectOverlaps(entry->rect, rect))
+                        continue;
+                    if (count < cap)
+                        elements[count] = element;
+                    count++;
+                }
+                for (uint32_t h = grid->cellMoved[cell]; h != UI__NO_HANDLE; h = grid->moved[h].next) {
+                    if (tree->elements[h] == NULL || !UI__RectOverlaps(grid->moved[h].rect, rect))
+                        continue;
+                    if (count < cap)
+                        elements[count] = tree->elements[h];
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Put the visible elements of the tree in the hit grid with a counting sort
+// by cell, elements of a cell stay in draw order
+bool UI__ContextBuildHitGrid(UIContext *ctx) {
+    UI__HitGrid *grid = &ctx->_hitGrid;
+    UI__Tree *tree = &ctx->_tree;
+    float windowW = (float)ctx->window.w;
+    float windowH = (float)ctx->window.h;
+    // A tree rebuilt since the last frame, by a snapshot, has no clips yet. The
+    // next frame computes them again to damage what changed.
+    if (ctx->_clipsDirty)
+        UI__TreeClip(tree, (UIRect) { 0, 0, windowW, windowH });
+
+    uint32_t cellCount = 0;
+    grid->levelCount = 0;
+    for (float cellSize = UI__HIT_CELL_SIZE; grid->levelCount < UI__HIT_MAX_LEVELS; cellSize *= 2.0f) {
+        uint32_t cols = (uint32_t)(windowW / cellSize) + 1;
+        uint32_t rows = (uint32_t)(windowH / cellSize) + 1;
+        grid->levels[grid->levelCount++] = (UI__HitLevel) {
+            .cellSize = cellSize,
+            .cols = cols,
+            .rows = rows,
+            .firstCell = cellCount
+        };
+        cellCount += cols * rows;
+        if (cellSize >= windowW && cellSize >= windowH)
+            break;
+    }
+    grid->windowW = ctx->window.w;
+    grid->windowH = ctx->window.h;
+
+    // One more cell start counts the elements that cannot be hit
+    if (cellCount + 2 > grid->cellCap) {
+        uint32_t *cellStart = (uint32_t *)UI__MemAlloc(sizeof(uint32_t) * (cellCount + 2) * 2);
+        if (cellStart == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        if (grid->cellStart != NULL)
+            UI_MemFree(grid->cellStart);
+        grid->cellStart = cellStart;
+        grid->cellMoved = cellStart + cellCount + 2;
+        grid->cellCap = cellCount + 2;
+    }
+    if (tree->len > grid->entryCap) {
+        UI__HitEntry *entries = (UI__HitEntry *)UI__MemAlloc(sizeof(UI__HitEntry) * tree->cap);
+        UI__HitMoved *moved = (UI__HitMoved *)UI__MemAlloc(
+            (sizeof(UI__HitMoved) + sizeof(uint32_t) * 2) * tree->cap);
+        if (entries == NULL || moved == NULL) {
+            if (entries != NULL)
+                UI_MemFree(entries);
+            if (moved != NULL)
+                UI_MemFree(moved);
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        if (grid->entries != NULL)
+            UI_MemFree(grid->entries);
+        if (grid->moved != NULL)
+            UI_MemFree(grid->moved);
+        grid->entries = entries;
+        grid->moved = moved;
+        grid->entryOf = (uint32_t *)(moved + tree->cap);
+        grid->cellOf = grid->entryOf + tree->cap;
+        grid->entryCap = tree->cap;
+    }
+
+    for (uint32_t c = 0; c <= cellCount + 1; c++)
+        grid->cellStart[c] = 0;
+    for (uint32_t c = 0; c < cellCount; c++)
+        grid->cellMoved[c] = UI__NO_HANDLE;
+    for (uint32_t handle = 0, n = tree->len; handle < n; handle++) {
+        UIRect rect = UI__RectIntersect(tree->boxes[handle], tree->clips[handle]);
+        grid->cellOf[handle] = UI__HitGridCellOf(grid, rect);
+        grid->cellStart[grid->cellOf[handle] == UI__NO_HANDLE ? cellCount : grid->cellOf[handle]]++;
+    }
+
+    uint32_t total = 0;
+    for (uint32_t c = 0; c <= cellCount; c++) {
+        uint32_t count = grid->cellStart[c];
+        grid->cellStart[c] = total;
+        total += count;
+    }
+    // Each cell start is moved to the end of the cell while its entries are written
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        uint32_t handle = tree->drawOrder[i];
+        uint32_t cell = grid->cellOf[handle] == UI__NO_HANDLE ? cellCount : grid->cellOf[handle];
+        grid->entryOf[handle] = grid->cellStart[cell]++;
+        grid->entries[grid->entryOf[handle]] = (UI__HitEntry) {
+            .drawIndex = i,
+            .rect = UI__RectIntersect(tree->boxes[handle], tree->clips[handle])
+        };
+    }
+    for (uint32_t c = cellCount + 1; c > 0; c--)
+        grid->cellStart[c] = grid->cellStart[c - 1];
+    grid->cellStart[0] = 0;
+    grid->movedCount = 0;
+    grid->dirty = false;
+    return true;
+}
+
+// Get the cell of the first level with cells at least as large as `rect`,
+// `UI__NO_HANDLE` for an empty rectangle
+uint32_t UI__HitGridCellOf(UI__HitGrid *grid, UIRect rect) {
+    if (rect.w <= 0 || rect.h <= 0)
+        return UI__NO_HANDLE;
+    float size = UI_fmax2(rect.w, rect.h);
+    uint32_t l = 0;
+    while (l + 1 < grid->levelCount && grid->levels[l].cellSize < size)
+        l++;
+    UI__HitLevel level = grid->levels[l];
+    uint32_t col = UI__HitGridCell(rect.x, level.cellSize, level.cols);
+    uint32_t row = UI__HitGridCell(rect.y, level.cellSize, level.rows);
+    return level.firstCell + row * level.cols + col;
+}
+
+// Give the element of `handle` its new visible box, in the list of moved
+// entries of its new cell when it changes cell
+void UI__HitGridMove(UI__HitGrid *grid, uint32_t handle, UIRect rect) {
+    uint32_t cell = UI__HitGridCellOf(grid, rect);
+    uint32_t entry = grid->entryOf[handle];
+    UI__HitMoved *moved = &grid->moved[handle];
+    if (cell == grid->cellOf[handle]) {
+        if (entry != UI__NO_HANDLE)
+            grid->entries[entry].rect = rect;
+        else
+            moved->rect = rect;
+        return;
+    }
+    if (entry != UI__NO_HANDLE) {
+        moved->drawIndex = grid->entries[entry].drawIndex;
+        grid->entries[entry].rect = (UIRect) { 0, 0, 0, 0 };
+        grid->entryOf[handle] = UI__NO_HANDLE;
+        grid->movedCount++;
+    } else if (grid->cellOf[handle] != UI__NO_HANDLE) {
+        uint32_t *link = &grid->cellMoved[grid->cellOf[handle]];
+        while (*link != handle)
+            link = &grid->moved[*link].next;
+        *link = moved->next;
+    }
+    grid->cellOf[handle] = cell;
+    moved->rect = rect;
+    if (cell == UI__NO_HANDLE)
+        return;
+    uint32_t *link = &grid->cellMoved[cell];
+    while (*link != UI__NO_HANDLE && grid->moved[*link].drawIndex > moved->drawIndex)
+        link = &grid->moved[*link].next;
+    moved->next = *link;
+    *link = handle;
+}
+
+// Get the cell of `coord` along an axis of `count` cells
+uint32_t UI__HitGridCell(float coord, float cellSize, uint32_t count) {
+    if (!(coord > 0))
+        return 0;
+    float cell = coord / cellSize;
+    return cell >= (float)(count - 1) ? count - 1 : (uint32_t)cell;
+}
+
+UIRect UI__RectUnion(UIRect a, UIRect b) {
+    float x0 = a.x < b.x ? a.x : b.x;
+    float y0 = a.y < b.y ? a.y : b.y;
+    float x1 = UI_fmax2(a.x + a.w, b.x + b.w);
+    float y1 = UI_fmax2(a.y + a.h, b.y + b.h);
+    return (UIRect) { x0, y0, x1 - x0, y1 - y0 };
+}
+
+UIRect UI__RectIntersect(UIRect a, UIRect b) {
+    float x0 = UI_fmax2(a.x, b.x);
+    float y0 = UI_fmax2(a.y, b.y);
+    float x1 = a.x + a.w < b.x + b.w ? a.x + a.w : b.x + b.w;
+    float y1 = a.y + a.h < b.y + b.h ? a.y + a.h : b.y + b.h;
+    return (UIRect) { x0, y0, UI_fmax2(x1 - x0, 0), UI_fmax2(y1 - y0, 0) };
+}
+
+bool UI__RectOverlaps(UIRect a, UIRect b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+float UI__RectArea(UIRect rect) {
+    return rect.w * rect.h;
+}
+
+UIElement *UIElement_New(UIElement *parent) {
+    UIElement *element = UI__Context_AllocElement(parent->context);
+    if (element == NULL)
+        return NULL;
+    if (!UI__Element_AddChild(parent, element))
+        return NULL;
+    return element;
+}
+
+bool UIElement_ReserveChildren(UIElement *element, uint32_t count) {
+    if (element->children.holes != 0)
+        UI__ChildrenCompact(&element->children);
+    if (count <= element->children.cap)
+        return true;
+    return UI__ChildrenGrow(element->context, &element->children, count);
+}
+
+uint32_t UIElement_ChildCount(UIElement *element) {
+    return element->children.len - element->children.holes;
+}
+
+UIElement *UIElement_Child(UIElement *element, uint32_t index) {
+    UI__Children *children = &element->children;
+    if (children->holes != children->start)
+        UI__ChildrenCompact(children);
+    if (index >= children->len - children->start)
+        return NULL;
+    return children->data[children->start + index];
+}
+
+const UILayout *UIElement_Layout(UIElement *element) {
+    return &element->context->_styles.styles[element->_style].layout;
+}
+
+UIRect UIElement_Box(UIElement *element) {
+    uint32_t handle = UI__ElementHandle(element);
+    if (handle != UI__NO_HANDLE)
+        return element->context->_tree.boxes[handle];
+    // Elements created by `UI_Begin` have the box of the last frame until the next layout
+    UI__IdEntry *entry = NULL;
+    if (element->_id != 0)
+        entry = UI__IdTableFind(&element->context->_idTable, element->_id);
+    if (entry == NULL)
+        return (UIRect) { 0, 0, 0, 0 };
+    return entry->box;
+}
+
+// Get the handle of `element`, elements added after the last layout do not have one
+uint32_t UI__ElementHandle(UIElement *element) {
+    UI__Tree *tree = &element->context->_tree;
+    uint32_t handle = element->_handle;
+    if (handle < tree->len && tree->elements[handle] == element)
+        return handle;
+    return UI__NO_HANDLE;
+}
+
+bool UI__Element_AddChild(UIElement *parent, UIElement *child) {
+    if (parent == NULL || child == NULL)
+        return false;
+    if (child->parent != NULL)
+        return false;
+
+    child->parent = parent;
+    UI__ElementMarkDirty(child);
+    parent->context->_structureDirty = true;
+    parent->context->_redraw = true;
+
+    return UI__ChildrenAppend(&parent->children, child);
+}
+
+// The siblings keep their slots, so removing any child takes the same time
+void UI__Element_RemoveChild(UIElement *child) {
+    UIElement *parent = child->parent;
+    if (parent == NULL)
+        return;
+    UI__ElementMarkDirty(parent);
+    parent->context->_structureDirty = true;
+    parent->context->_redraw = true;
+    child->parent = NULL;
+    UI__ChildrenRemove(&parent->children, child->_index);
+}
+
+void UIElement_Destroy(UIElement *element) {
+    UIContext *ctx = element->context;
+    if (element == ctx->root || element->_virtualRow)
+        return;
+    UI__Element_RemoveChild(element);
+
+    // The rows a list detached are not in the subtree
+    for (UI__VirtualList **link = &ctx->_virtualLists; *link != NULL;) {
+        UI__VirtualList *list = *link;
+        if (!UI__ElementIsInside(list->element, element)) {
+            link = &list->next;
+            continue;
+        }
+        for (uint32_t i = 0; i < list->rowsLen; i++) {
+            if (list->rows[i]->parent == NULL)
+                UI__ElementFreeSubtree(list->rows[i]);
+        }
+        if (list->rows != NULL)
+            UI_MemFree(list->rows);
+        *link = list->next;
+        UI_MemFree(list);
+    }
+    UI__ElementFreeSubtree(element);
+}
+
+bool UIElement_SetParent(UIElement *element, UIElement *parent) {
+    UIElement *oldParent = element->parent;
+    if (oldParent == NULL || parent->context != element->context || UI__ElementIsInside(parent, element))
+        return false;
+    if (element->_virtualRow || UI__ContextFindVirtualList(element->context, parent) != NULL)
+        return false;
+    if (oldParent == parent) {
+        UIElement_SetIndex(element, UINT32_MAX);
+        return true;
+    }
+
+    // Nothing changes when the children of `parent` cannot grow
+    uint32_t oldIndex = element->_index;
+    if (!UI__ChildrenAppend(&parent->children, element))
+        return false;
+    UI__ChildrenRemove(&oldParent->children, oldIndex);
+    element->parent = parent;
+    // The rows of the old position are marked, the new parent is marked when
+    // the tree is rebuilt
+    UI__ElementMarkDirty(oldParent);
+    UI__ElementMarkDirty(element);
+    element->context->_structureDirty = true;
+    element->context->_redraw = true;
+    return true;
+}
+
+void UIElement_SetIndex(UIElement *element, uint32_t index) {
+    UIElement *parent = element->parent;
+    if (parent == NULL || element->_virtualRow)
+        return;
+    UI__Children *children = &parent->children;
+    if (children->holes != 0)
+        UI__ChildrenCompact(children);
+    if (index >= children->len)
+        index = children->len - 1;
+    uint32_t oldIndex = element->_index;
+    if (index == oldIndex)
+        return;
+
+    UIElement **data = children->data;
+    for (uint32_t i = oldIndex; i < index; i++) {
+        data[i] = data[i + 1];
+        data[i]->_index = i;
+    }
+    for (uint32_t i = oldIndex; i > index; i--) {
+        data[i] = data[i - 1];
+        data[i]->_index = i;
+    }
+    data[index] = element;
+    element->_index = index;
+    UI__ElementMarkDirty(parent);
+    parent->context->_structureDirty = true;
+    parent->context->_redraw = true;
+}
+
+bool UI__ElementIsInside(UIElement *element, UIElement *ancestor) {
+    for (; element != NULL; element = element->parent) {
+        if (element == ancestor)
+            return true;
+    }
+    return false;
+}
+
+// Free the children arrays of the subtree of `element` depth-first, emptying
+// them along the way
+void UI__ElementFreeChildren(UIElement *element) {
+    UIElement *root = element;
+    while (element != NULL) {
+        if (element->children.len != 0) {
+            UIElement *child = element->children.data[--element->children.len];
+            element = child == NULL ? element : child;
+            continue;
+        }
+        element->children.start = 0;
+        element->children.holes = 0;
+        UI__ContextFreeChildren(element->context, &element->children);
+        element = element == root ? NULL : element->parent;
+    }
+}
+
+// Free the subtree of `element` depth-first, the children arrays and the
+// elements go back to the pools of the context
+void UI__ElementFreeSubtree(UIElement *element) {
+    UIContext *ctx = element->context;
+    UI__Tree *tree = &ctx->_tree;
+    UIElement *root = element;
+    while (element != NULL) {
+        if (element->children.len != 0) {
+            UIElement *child = element->children.data[--element->children.len];
+            element = child == NULL ? element : child;
+            continue;
+        }
+        UIElement *next = element == root ? NULL : element->parent;
+        UI__ContextFreeChildren(ctx, &element->children);
+        // The row of the element stays in the tree until it is rebuilt, hit
+        // tests skip it
+        uint32_t handle = UI__ElementHandle(element);
+        if (handle != UI__NO_HANDLE)
+            tree->elements[handle] = NULL;
+        UI__Context_FreeElement(ctx, element);
+        element = next;
+    }
+}
+
+// Update the row of `element` in the layout tree and mark it and all its
+// ancestors as out of date
+void UI__ElementMarkDirty(UIElement *element) {
+    UI__Tree *tree = &element->context->_tree;
+    uint32_t handle = UI__ElementHandle(element);
+    // New elements are written when the tree is rebuilt
+    if (handle == UI__NO_HANDLE)
+        return;
+
+    UI__TreeWriteElement(tree, handle, element);
+    while (handle != UI__NO_HANDLE && !tree->dirty[handle]) {
+        tree->dirty[handle] = true;
+        handle = tree->links[handle].parent;
+    }
+}
+
+void UI_BackgroundColor(UIElement *element, UIColor color) {
+    UIColor prev = element->backgroundColor;
+    if (prev.r == color.r && prev.g == color.g && prev.b == color.b && prev.a == color.a)
+        return;
+    element->backgroundColor = color;
+    element->context->_redraw = true;
+    UI__ElementDamage(element);
+
+    uint32_t handle = UI__ElementHandle(element);
+    if (handle != UI__NO_HANDLE)
+        element->context->_tree.colors[handle] = color;
+}
+
+void UI_ClipChildren(UIElement *element, bool clip) {
+    if (element->clipChildren == clip)
+        return;
+    element->clipChildren = clip;
+    element->context->_redraw = true;
+    element->context->_clipsDirty = true;
+
+    uint32_t handle = UI__ElementHandle(element);
+    if (handle != UI__NO_HANDLE)
+        element->context->_tree.clipChildren[handle] = clip;
+}
+
+void UI_Scroll(UIElement *element, float x, float y) {
+    // Lists scroll by showing other rows, only their horizontal offset is set here
+    if (UI__ContextFindVirtualList(element->context, element) != NULL)
+        y = element->scrollY;
+    UI__ElementSetScroll(element, x, y);
+}
+
+void UI__ElementSetScroll(UIElement *element, float x, float y) {
+    if (element->scrollX == x && element->scrollY == y)
+        return;
+    element->scrollX = x;
+    element->scrollY = y;
+    UI__ElementMarkDirty(element);
+}
+
+void UI_FitWidth(UIElement *element) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.w_sizing == UISizing_fit && layout.w_weight == 1.0f)
+        return;
+    layout.w_sizing = UISizing_fit;
+    layout.w_weight = 1.0f;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_FitHeight(UIElement *element) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.h_sizing == UISizing_fit && layout.h_weight == 1.0f)
+        return;
+    layout.h_sizing = UISizing_fit;
+    layout.h_weight = 1.0f;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_FixedWidth(UIElement *element, float width) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.w_sizing == UISizing_fixed
+        && layout.w_weight == 1.0f
+        && layout.w_min == width
+        && layout.w_max == width)
+    {
+        return;
+    }
+    layout.w_sizing = UISizing_fixed;
+    layout.w_weight = 1.0f;
+    layout.w_min = width;
+    layout.w_max = width;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_FixedHeight(UIElement *element, float height) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.h_sizing == UISizing_fixed
+        && layout.h_weight == 0.0f
+        && layout.h_min == height
+        && layout.h_max == height)
+    {
+        return;
+    }
+    layout.h_sizing = UISizing_fixed;
+    layout.h_weight = 0.0f;
+    layout.h_min = height;
+    layout.h_max = height;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_FillWidth(UIElement *element, float weight) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.w_sizing == UISizing_fill && layout.w_weight == weight)
+        return;
+    layout.w_sizing = UISizing_fill;
+    layout.w_weight = weight;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_FillHeight(UIElement *element, float weight) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.h_sizing == UISizing_fill && layout.h_weight == weight)
+        return;
+    layout.h_sizing = UISizing_fill;
+    layout.h_weight = weight;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_MinWidth(UIElement *element, float width) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.w_min == width)
+        return;
+    layout.w_min = width;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_MinHeight(UIElement *element, float height) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.h_min == height)
+        return;
+    layout.h_min = height;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_MaxWidth(UIElement *element, float width) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.w_max == width)
+        return;
+    layout.w_max = width;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_MaxHeight(UIElement *element, float height) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.h_max == height)
+        return;
+    layout.h_max = height;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_Padding(UIElement *element, float padding) {
+    UI_PaddingEx(element, padding, padding, padding, padding);
+}
+
+void UI_PaddingEx(UIElement *element, float top, float bottom, float left, float right) {
+    UILayout layout = *UIElement_Layout(element);
+    UIPadding padding = { top, bottom, left, right };
+    if (UI__PaddingEq(layout.padding, padding))
+        return;
+    layout.padding = padding;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_Margin(UIElement *element, float margin) {
+    UI_MarginEx(element, margin, margin, margin, margin);
+}
+
+void UI_MarginEx(UIElement *element, float top, float bottom, float left, float right) {
+    UILayout layout = *UIElement_Layout(element);
+    UIPadding margin = { top, bottom, left, right };
+    if (UI__PaddingEq(layout.margin, margin))
+        return;
+    layout.margin = margin;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_ChildGap(UIElement *element, float childGap) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.childGap == childGap)
+        return;
+    layout.childGap = childGap;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_AlignX(UIElement *element, UIAlignX align) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.alignX == align)
+        return;
+    layout.alignX = align;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_AlignY(UIElement *element, UIAlignY align) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.alignY == align)
+        return;
+    layout.alignY = align;
+    UI__ElementSetLayout(element, &layout);
+}
+
+void UI_LayoutDirection(UIElement *element, UILayoutDirection direction) {
+    UILayout layout = *UIElement_Layout(element);
+    if (layout.direction == direction)
+        return;
+    layout.direction = direction;
+    UI__ElementSetLayout(element, &layout);
+}
+
+UIStyle UIContext_AddStyle(UIContext *ctx, const UILayout *layout) {
+    uint32_t style = UI__StyleTableIntern(ctx, layout);
+    if (style == UI__NO_STYLE)
+        return UI_DEFAULT_STYLE;
+    ctx->_styles.styles[style].refs |= UI__STYLE_PINNED;
+    return style;
+}
+
+void UI_Style(UIElement *element, UIStyle style) {
+    UI__ElementSetStyle(element, style);
+}
+
+// Make `element` use `style` in place of its current one
+void UI__ElementSetStyle(UIElement *element, uint32_t style) {
+    UI__StyleTable *table = &element->context->_styles;
+    if (element->_style == style)
+        return;
+    table->styles[style].refs++;
+    UI__StyleTableRelease(table, element->_style);
+    element->_style = style;
+    UI__ElementMarkDirty(element);
+}
+
+// Give `element` the style of `layout`, the other elements of its current
+// style keep it
+void UI__ElementSetLayout(UIElement *element, const UILayout *layout) {
+    uint32_t style = UI__StyleTableIntern(element->context, layout);
+    if (style != UI__NO_STYLE)
+        UI__ElementSetStyle(element, style);
+}
+
+bool UI_VirtualList(UIElement *element, uint32_t rowCount, float rowHeight, UIVirtualRowFn rowFn, void *userData) {
+    UIContext *ctx = element->context;
+    if (ctx->_useFrameArena)
+        return false;
+    UI__VirtualList *list = UI__ContextFindVirtualList(ctx, element);
+    if (list == NULL) {
+        list = (UI__VirtualList *)UI__MemAlloc(sizeof(UI__VirtualList));
+        if (list == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        *list = (UI__VirtualList) {
+            .next = ctx->_virtualLists,
+            .element = element,
+            .rowHeight = rowHeight,
+            .scrollY = 0.0,
+            .rows = NULL,
+            .rowsLen = 0,
+            .rowsCap = 0
+        };
+        ctx->_virtualLists = list;
+        UI_LayoutDirection(element, UILayoutDirection_topToBottom);
+        UI_AlignY(element, UIAlignY_top);
+        UI_ChildGap(element, 0.0f);
+        UI_ClipChildren(element, true);
+    }
+    if (list->rowHeight != rowHeight) {
+        for (uint32_t i = 0; i < list->rowsLen; i++)
+            UI_FixedHeight(list->rows[i], rowHeight);
+    }
+    list->rowFn = rowFn;
+    list->userData = userData;
+    list->rowCount = rowCount;
+    list->rowHeight = rowHeight;
+    list->refill = true;
+    ctx->_redraw = true;
+    return true;
+}
+
+void UI_VirtualListScroll(UIElement *element, double y) {
+    UI__VirtualList *list = UI__ContextFindVirtualList(element->context, element);
+    if (list == NULL || list->scrollY == y)
+        return;
+    list->scrollY = y;
+    element->context->_redraw = true;
+}
+
+double UI_VirtualListScrollY(UIElement *element) {
+    UI__VirtualList *list = UI__ContextFindVirtualList(element->context, element);
+    return list == NULL ? 0.0 : list->scrollY;
+}
+
+// Contexts have few lists, they are searched linearly
+UI__VirtualList *UI__ContextFindVirtualList(UIContext *ctx, UIElement *element) {
+    for (UI__VirtualList *list = ctx->_virtualLists; list != NULL; list = list->next) {
+        if (list->element == element)
+            return list;
+    }
+    return NULL;
+}
+
+// Show the rows inside the box of every list, `changed` is set if the tree
+// must be laid out again
+bool UI__ContextShowVirtualRows(UIContext *ctx, bool *changed) {
+    for (UI__VirtualList *list = ctx->_virtualLists; list != NULL; list = list->next) {
+        if (!UI__VirtualListShowRows(list, changed))
+            return false;
+    }
+    return true;
+}
+
+bool UI__VirtualListShowRows(UI__VirtualList *list, bool *changed) {
+    UIElement *element = list->element;
+    uint32_t handle = UI__ElementHandle(element);
+    // Lists outside of the tree keep their rows until they are laid out
+    if (handle == UI__NO_HANDLE)
+        return true;
+
+    UIRect box = element->context->_tree.boxes[handle];
+    UIPadding padding = UIElement_Layout(element)->padding;
+    double viewH = UI_fmax2(box.h - padding.top - padding.bottom, 0.0f);
+    double rowHeight = list->rowHeight;
+    double maxScroll = (double)list->rowCount * rowHeight - viewH;
+    if (list->scrollY > maxScroll)
+        list->scrollY = maxScroll;
+    if (list->scrollY < 0.0)
+        list->scrollY = 0.0;
+
+    uint32_t first = 0;
+    uint32_t shown = 0;
+    if (rowHeight > 0.0 && list->rowCount != 0) {
+        // One past the last row that is at least partly inside the box
+        double end = (list->scrollY + viewH) / rowHeight;
+        uint32_t last = list->rowCount;
+        if (end < last) {
+            last = (uint32_t)end;
+            if ((double)last < end)
+                last++;
+        }
+        first = (uint32_t)(list->scrollY / rowHeight);
+        if (first > last)
+            first = last;
+        shown = last - first;
+    }
+
+    // Rows are only created when the box grows, scrolling reuses them
+    if (shown > list->rowsLen && !UI__VirtualListAddRows(list, shown - list->rowsLen))
+        return false;
+
+    bool refill = list->refill || first != list->firstRow;
+    uint32_t attached = UIElement_ChildCount(element);
+    while (attached > shown) {
+        UI__Element_RemoveChild(list->rows[--attached]);
+        *changed = true;
+    }
+    for (; attached < shown; attached++) {
+        if (!UI__Element_AddChild(element, list->rows[attached]))
+            return false;
+        if (!refill)
+            list->rowFn(list->rows[attached], first + attached, list->userData);
+        *changed = true;
+    }
+    if (refill) {
+        for (uint32_t i = 0; i < shown; i++)
+            list->rowFn(list->rows[i], first + i, list->userData);
+        *changed = true;
+    }
+    list->firstRow = first;
+    list->refill = false;
+
+    float scrollY = (float)(list->scrollY - (double)first * rowHeight);
+    if (element->scrollY != scrollY) {
+        UI__ElementSetScroll(element, element->scrollX, scrollY);
+        *changed = true;
+    }
+    return true;
+}
+
+bool UI__VirtualListAddRows(UI__VirtualList *list, uint32_t count) {
+    UIContext *ctx = list->element->context;
+    uint32_t len = list->rowsLen + count;
+    if (len > list->rowsCap) {
+        uint32_t cap = list->rowsCap == 0 ? 16 : list->rowsCap;
+        while (cap < len)
+            cap *= 2;
+        UIElement **rows;
+        if (list->rows == NULL)
+            rows = (UIElement **)UI__MemAlloc(sizeof(UIElement *) * cap);
+        else
+            rows = (UIElement **)UI__MemExpand(list->rows, sizeof(UIElement *) * cap);
+        if (rows == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        list->rows = rows;
+        list->rowsCap = cap;
+    }
+    while (list->rowsLen < len) {
+        UIElement *row = UI__Context_AllocElement(ctx);
+        if (row == NULL)
+            return false;
+        UI_FillWidth(row, 1.0f);
+        UI_FixedHeight(row, list->rowHeight);
+        row->_virtualRow = true;
+        list->rows[list->rowsLen++] = row;
+    }
+    return true;
+}
+
+void UI_Text(UIElement *element, const char *text, uint32_t font, UIColor color) {
+    uint32_t len = 0;
+    while (text != NULL && text[len] != '\0')
+        len++;
+    element->text = (UIText) {
+        .str = text,
+        .len = len,
+        .font = font,
+        .color = color,
+        .wrap = element->text.wrap,
+        .hash = element->text.wrap ? UI__HashBytes(text, len) : 0
+    };
+    element->context->_redraw = true;
+    UI__ElementDamage(element);
+    UI__ElementMeasureText(element);
+    // The lines of wrapped text may change without changing its size
+    if (element->text.wrap)
+        UI__ElementMarkDirty(element);
+}
+
+void UI_TextWrap(UIElement *element, bool wrap) {
+    if (element->text.wrap == wrap)
+        return;
+    element->text.wrap = wrap;
+    element->text.hash = wrap ? UI__HashBytes(element->text.str, element->text.len) : 0;
+    element->context->_hasWrappedText |= wrap;
+    element->context->_redraw = true;
+    UI__ElementDamage(element);
+    UI__ElementMeasureText(element);
+    UI__ElementMarkDirty(element);
+}
+
+bool UI__PaddingEq(UIPadding a, UIPadding b) {
+    return a.top == b.top && a.bottom == b.bottom && a.left == b.left && a.right == b.right;
+}
+
+uint32_t UI_Id(const char *str) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *str != '\0'; str++) {
+        hash ^= (uint8_t)*str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t UI_IdIndex(uint32_t id, uint32_t index) {
+    return UI__HashU32(id, index);
+}
+
+UIElement *UI_Begin(UIContext *ctx, uint32_t id) {
+    // The children of an element that could not be created are skipped too
+    if (ctx->_failedDepth != 0) {
+        ctx->_failedDepth++;
+        return NULL;
+    }
+    UIElement *parent = ctx->_current;
+    UIElement *element = UIElement_New(parent);
+    if (element == NULL) {
+        ctx->_failedDepth++;
+        return NULL;
+    }
+    // Ids of elements with different parents do not collide
+    uint32_t key = UI__HashU32(parent->_id, id);
+    element->_id = key == 0 ? 1 : key;
+    element->_signature = element->_id;
+    ctx->_current = element;
+    return element;
+}
+
+void UI_End(UIContext *ctx) {
+    if (ctx->_failedDepth != 0) {
+        ctx->_failedDepth--;
+        return;
+    }
+    UIElement *element = ctx->_current;
+    if (element == ctx->root)
+        return;
+    // Children are closed before their parent, their signature is already complete
+    element->_signature = UI__HashU32(element->_signature, element->context->_styles.styles[element->_style].hash);
+    element->_signature = UI__HashF32(element->_signature, element->scrollX);
+    element->_signature = UI__HashF32(element->_signature, element->scrollY);
+    element->_signature = UI__HashF32(element->_signature, element->contentW);
+    element->_signature = UI__HashF32(element->_signature, element->contentH);
+    // Wrapped text of the same size may be broken in other places
+    if (element->text.wrap && element->text.str != NULL) {
+        element->_signature = UI__HashU32(UI__HashU32(element->_signature, element->text.hash), element->text.font);
+    }
+    UIElement *parent = element->parent;
+    parent->_signature = UI__HashU32(parent->_signature, element->_signature);
+    ctx->_current = parent;
+}
+
+uint32_t UI__HashU32(uint32_t hash, uint32_t value) {
+    hash ^= value + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+uint32_t UI__HashF32(uint32_t hash, float value) {
+    union { float f; uint32_t u; } bits = { .f = value };
+    return UI__HashU32(hash, bits.u);
+}
+
+// FNV-1a
+uint32_t UI__HashBytes(const char *bytes, uint32_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)bytes[i]) * 16777619u;
+    return hash;
+}
+
+// Write the fields of `layout` as 16 words, equal layouts give equal words
+void UI__LayoutWords(const UILayout *layout, uint32_t *words) {
+    union { float f[15]; uint32_t u[15]; } bits = { .f = {
+        layout->padding.top, layout->padding.bottom, layout->padding.left, layout->padding.right,
+        layout->margin.top, layout->margin.bottom, layout->margin.left, layout->margin.right,
+        layout->childGap, layout->w_weight, layout->w_min, layout->w_max,
+        layout->h_weight, layout->h_min, layout->h_max
+    } };
+    for (uint32_t i = 0; i < 15; i++)
+        words[i] = bits.u[i];
+    words[15] = (uint32_t)layout->direction
+        | (uint32_t)layout->alignX << 3
+        | (uint32_t)layout->alignY << 6
+        | (uint32_t)layout->w_sizing << 9
+        | (uint32_t)layout->h_sizing << 17;
+}
+
+// Hash the words of a layout in four independent lanes mixed at the end, the
+// setters hash a layout every time they change one
+uint32_t UI__HashLayout(const uint32_t *words) {
+    uint32_t lanes[4] = { 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u };
+    for (uint32_t i = 0; i < 16; i++)
+        lanes[i & 3] = (lanes[i & 3] ^ words[i]) * 0x9e3779b1u;
+    return UI__HashU32(UI__HashU32(UI__HashU32(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+}
+
+// Add the layout of new elements as the first style
+bool UI__StyleTableInit(UIContext *ctx) {
+    ctx->_styles = (UI__StyleTable) {
+        .styles = NULL,
+        .buckets = NULL,
+        .len = 0,
+        .cap = 0,
+        .bucketCap = 0,
+        .count = 0,
+        .firstFree = UI__NO_STYLE
+    };
+    const UILayout layout = {
+        .padding = { 0, 0, 0, 0 },
+        .margin = { 0, 0, 0, 0 },
+        .childGap = 0,
+        .alignX = UIAlignX_left,
+        .alignY = UIAlignY_top,
+        .direction = UILayoutDirection_topToBottom,
+        .w_sizing = UISizing_fit,
+        .w_min = 0.0f,
+        .w_max = 0.0f,
+        .w_weight = 1.0f,
+        .h_sizing = UISizing_fit,
+        .h_min = 0.0f,
+        .h_max = 0.0f,
+        .h_weight = 1.0f
+    };
+    UIContext_AddStyle(ctx, &layout);
+    return ctx->_styles.count == 1;
+}
+
+void UI__StyleTableDestroy(UI__StyleTable *table) {
+    if (table->styles != NULL)
+        UI_MemFree(table->styles);
+    if (table->buckets != NULL)
+        UI_MemFree(table->buckets);
+    *table = (UI__StyleTable) { .styles = NULL, .buckets = NULL, .firstFree = UI__NO_STYLE };
+}
+
+// Find the style of `layout` or add one that no element uses yet,
+// UI__NO_STYLE when out of memory
+uint32_t UI__StyleTableIntern(UIContext *ctx, const UILayout *layout) {
+    UI__StyleTable *table = &ctx->_styles;
+    uint32_t words[16];
+    UI__LayoutWords(layout, words);
+    uint32_t hash = UI__HashLayout(words);
+    if (table->bucketCap != 0) {
+        uint32_t style = table->buckets[hash & (table->bucketCap - 1)];
+        for (; style != UI__NO_STYLE; style = table->styles[style].next) {
+            if (table->styles[style].hash != hash)
+                continue;
+            uint32_t other[16];
+            UI__LayoutWords(&table->styles[style].layout, other);
+            uint32_t i = 0;
+            while (i < 16 && words[i] == other[i])
+                i++;
+            if (i == 16)
+                return style;
+        }
+    }
+
+    // Keep at most one style per bucket on average
+    bool full = table->firstFree == UI__NO_STYLE && table->len == table->cap;
+    if ((full || table->count == table->bucketCap) && !UI__StyleTableGrow(ctx))
+        return UI__NO_STYLE;
+    uint32_t style = table->firstFree;
+    if (style != UI__NO_STYLE)
+        table->firstFree = table->styles[style].next;
+    else
+        style = table->len++;
+    uint32_t *bucket = &table->buckets[hash & (table->bucketCap - 1)];
+    table->styles[style] = (UI__Style) { .layout = *layout, .hash = hash, .refs = 0, .next = *bucket };
+    *bucket = style;
+    table->count++;
+    return style;
+}
+
+// Double the styles when none is free and the buckets when they are full,
+// the styles keep their index
+bool UI__StyleTableGrow(UIContext *ctx) {
+    UI__StyleTable *table = &ctx->_styles;
+    if (table->firstFree == UI__NO_STYLE && table->len == table->cap) {
+        uint32_t cap = table->cap == 0 ? 64 : table->cap * 2;
+        UI__Style *styles = table->styles == NULL
+            ? (UI__Style *)UI__MemAlloc(sizeof(UI__Style) * cap)
+            : (UI__Style *)UI__MemExpand(table->styles, sizeof(UI__Style) * cap);
+        if (styles == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        table->styles = styles;
+        table->cap = cap;
+    }
+    if (table->count == table->bucketCap) {
+        uint32_t bucketCap = table->bucketCap == 0 ? 64 : table->bucketCap * 2;
+        uint32_t *buckets = (uint32_t *)UI__MemAlloc(sizeof(uint32_t) * bucketCap);
+        if (buckets == NULL) {
+            UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+            return false;
+        }
+        for (uint32_t i = 0; i < bucketCap; i++)
+            buckets[i] = UI__NO_STYLE;
+        for (uint32_t i = 0; i < table->bucketCap; i++) {
+            uint32_t style = table->buckets[i];
+            while (style != UI__NO_STYLE) {
+                uint32_t next = table->styles[style].next;
+                uint32_t *bucket = &buckets[table->styles[style].hash & (bucketCap - 1)];
+                table->styles[style].next = *bucket;
+                *bucket = style;
+                style = next;
+            }
+        }
+        if (table->buckets != NULL)
+            UI_MemFree(table->buckets);
+        table->buckets = buckets;
+        table->bucketCap = bucketCap;
+    }
+    return true;
+}
+
+// Drop a reference to `style`, it is freed when no element uses it and it was
+// not added by `UIContext_AddStyle`
+void UI__StyleTableRelease(UI__StyleTable *table, uint32_t style) {
+    UI__Style *entry = &table->styles[style];
+    if (--entry->refs != 0)
+        return;
+    uint32_t *link = &table->buckets[entry->hash & (table->bucketCap - 1)];
+    while (*link != style)
+        link = &table->styles[*link].next;
+    *link = entry->next;
+    entry->next = table->firstFree;
+    table->firstFree = style;
+    table->count--;
+}
+
+// Count the references again when the frame arena is reset, the elements of
+// the arena are dropped without releasing their style and only the root is left
+void UI__StyleTableCollect(UIContext *ctx) {
+    UI__StyleTable *table = &ctx->_styles;
+    for (uint32_t i = 0; i < table->bucketCap; i++) {
+        for (uint32_t style = table->buckets[i]; style != UI__NO_STYLE; style = table->styles[style].next)
+            table->styles[style].refs &= UI__STYLE_PINNED;
+    }
+    table->styles[ctx->root->_style].refs++;
+    for (uint32_t i = 0; i < table->bucketCap; i++) {
+        uint32_t style = table->buckets[i];
+        while (style != UI__NO_STYLE) {
+            uint32_t next = table->styles[style].next;
+            // Releasing the last reference frees the style
+            if (table->styles[style].refs == 0) {
+                table->styles[style].refs = 1;
+                UI__StyleTableRelease(table, style);
+            }
+            style = next;
+        }
+    }
+}
+
+// Read the fields of a layout written by `UI__LayoutWords`
+void UI__LayoutFromWords(const uint32_t *words, UILayout *layout) {
+    union { float f[15]; uint32_t u[15]; } bits;
+    for (uint32_t i = 0; i < 15; i++)
+        bits.u[i] = words[i];
+    *layout = (UILayout) {
+        .padding = { bits.f[0], bits.f[1], bits.f[2], bits.f[3] },
+        .margin = { bits.f[4], bits.f[5], bits.f[6], bits.f[7] },
+        .direction = (UILayoutDirection)(words[15] & 7),
+        .alignX = (UIAlignX)(words[15] >> 3 & 7),
+        .alignY = (UIAlignY)(words[15] >> 6 & 7),
+        .w_sizing = (UISizing)(words[15] >> 9 & 0xff),
+        .h_sizing = (UISizing)(words[15] >> 17 & 0xff),
+        .childGap = bits.f[8],
+        .w_weight = bits.f[9],
+        .w_min = bits.f[10],
+        .w_max = bits.f[11],
+        .h_weight = bits.f[12],
+        .h_min = bits.f[13],
+        .h_max = bits.f[14]
+    };
+}
+
+uint32_t UIContext_SnapshotSize(UIContext *ctx, bool boxes) {
+    UI__SnapshotHeader header;
+    uint32_t *styleMap = UI__ContextSnapshotHeader(ctx, boxes, &header);
+    if (styleMap == NULL)
+        return 0;
+    UI_MemFree(styleMap);
+    return UI__SnapshotSize(&header);
+}
+
+bool UIContext_WriteSnapshot(UIContext *ctx, void *buffer, uint32_t size, bool boxes) {
+    UI__SnapshotHeader header;
+    uint32_t *styleMap = UI__ContextSnapshotHeader(ctx, boxes, &header);
+    if (styleMap == NULL)
+        return false;
+    if (UI__SnapshotSize(&header) > size) {
+        UI_MemFree(styleMap);
+        return false;
+    }
+
+    uint8_t *data = (uint8_t *)buffer;
+    UI__MemCopy(data, &header, sizeof(header));
+    uint32_t *styles = (uint32_t *)(data + sizeof(header));
+    UI__SnapshotElement *elements = (UI__SnapshotElement *)(styles + 16 * header.styleCount);
+    UI__SnapshotBox *snapshotBoxes = (UI__SnapshotBox *)(elements + header.elementCount);
+    char *text = (char *)(boxes ? (void *)(snapshotBoxes + header.elementCount) : (void *)snapshotBoxes);
+
+    for (uint32_t i = 0; i < ctx->_styles.len; i++) {
+        if (styleMap[i] != UI__NO_STYLE)
+            UI__LayoutWords(&ctx->_styles.styles[i].layout, styles + 16 * styleMap[i]);
+    }
+    UI__Tree *tree = &ctx->_tree;
+    uint32_t textEnd = 0;
+    for (uint32_t i = 0; i < header.elementCount; i++) {
+        UIElement *element = tree->elements[i];
+        UI__Links links = tree->links[i];
+        UIText *elementText = &element->text;
+        elements[i] = (UI__SnapshotElement) {
+            .firstChild = links.firstChild,
+            .childCount = links.childCount,
+            .style = styleMap[element->_style],
+            .backgroundColor = element->backgroundColor,
+            .scrollX = element->scrollX,
+            .scrollY = element->scrollY,
+            .contentW = element->contentW,
+            .contentH = element->contentH,
+            .textOffset = elementText->str == NULL ? UI__NO_TEXT : textEnd,
+            .textLen = elementText->len,
+            .font = elementText->font,
+            .textColor = elementText->color,
+            .flags = (element->clipChildren ? UI__SNAPSHOT_CLIP : 0u) | (elementText->wrap ? UI__SNAPSHOT_WRAP : 0u)
+        };
+        // Each text ends with '\0' like the strings given to `UI_Text`
+        if (elementText->str != NULL) {
+            UI__MemCopy(text + textEnd, elementText->str, elementText->len);
+            text[textEnd + elementText->len] = '\0';
+            textEnd += elementText->len + 1;
+        }
+        if (boxes)
+            snapshotBoxes[i] = (UI__SnapshotBox) { .box = tree->boxes[i], .childExtent = tree->childExtent[i] };
+    }
+    UI_MemFree(styleMap);
+    return true;
+}
+
+// Lay out the tree to number its rows and fill `header`. Return the index in
+// the snapshot of each style of the context, UI__NO_STYLE for the ones no
+// element uses, or NULL on failure.
+uint32_t *UI__ContextSnapshotHeader(UIContext *ctx, bool boxes, UI__SnapshotHeader *header) {
+    if (!UI__ContextUpdateTree(ctx))
+        return NULL;
+    uint32_t *styleMap = (uint32_t *)UI__MemAlloc(sizeof(uint32_t) * ctx->_styles.len);
+    if (styleMap == NULL) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return NULL;
+    }
+    UI__Tree *tree = &ctx->_tree;
+    *header = (UI__SnapshotHeader) {
+        .magic = UI__SNAPSHOT_MAGIC,
+        .version = UI_SNAPSHOT_VERSION,
+        .flags = boxes ? UI__SNAPSHOT_BOXES : 0u,
+        .elementCount = tree->len,
+        .styleCount = 0,
+        .textSize = 0,
+        .windowW = ctx->window.w,
+        .windowH = ctx->window.h
+    };
+    for (uint32_t i = 0; i < ctx->_styles.len; i++)
+        styleMap[i] = UI__NO_STYLE;
+    uint64_t textSize = 0;
+    for (uint32_t i = 0; i < tree->len; i++) {
+        UIElement *element = tree->elements[i];
+        if (element->text.str != NULL)
+            textSize += (uint64_t)element->text.len + 1;
+        if (styleMap[element->_style] == UI__NO_STYLE)
+            styleMap[element->_style] = header->styleCount++;
+    }
+    header->textSize = (uint32_t)textSize;
+    if (textSize > UINT32_MAX || UI__SnapshotSize(header) == 0) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        UI_MemFree(styleMap);
+        return NULL;
+    }
+    return styleMap;
+}
+
+// Size of the snapshot described by `header`, 0 when it does not fit 32 bits
+uint32_t UI__SnapshotSize(const UI__SnapshotHeader *header) {
+    uint64_t size = sizeof(UI__SnapshotHeader)
+        + (uint64_t)header->styleCount * 16 * sizeof(uint32_t)
+        + (uint64_t)header->elementCount * sizeof(UI__SnapshotElement)
+        + header->textSize;
+    if (header->flags & UI__SNAPSHOT_BOXES)
+        size += (uint64_t)header->elementCount * sizeof(UI__SnapshotBox);
+    return size > UINT32_MAX ? 0 : (uint32_t)size;
+}
+
+bool UIContext_LoadSnapshot(UIContext *ctx, const void *data, uint32_t size) {
+    const UI__SnapshotHeader *header = (const UI__SnapshotHeader *)data;
+    if (UIElement_ChildCount(ctx->root) != 0 || !UI__SnapshotCheck(data, size)) {
+        UI__ErrorSet(ctx, UIErrorKind_invalidSnapshot);
+        return false;
+    }
+    const uint32_t *styles = (const uint32_t *)(header + 1);
+    const UI__SnapshotElement *elements = (const UI__SnapshotElement *)(styles + 16 * header->styleCount);
+    const UI__SnapshotBox *boxes = (const UI__SnapshotBox *)(elements + header->elementCount);
+    bool hasBoxes = (header->flags & UI__SNAPSHOT_BOXES) != 0;
+    const char *text = hasBoxes ? (const char *)(boxes + header->elementCount) : (const char *)boxes;
+
+    // The styles and the rows are numbered in the snapshot, the elements
+    // take the style of the context and the row of their parent is kept
+    uint32_t *styleMap = (uint32_t *)UI__MemAlloc(sizeof(uint32_t) * header->styleCount);
+    UIElement **rows = (UIElement **)UI__MemAlloc(sizeof(UIElement *) * header->elementCount);
+    bool loaded = styleMap != NULL && rows != NULL;
+    if (!loaded)
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+    for (uint32_t i = 0; i < header->styleCount && loaded; i++)
+        styleMap[i] = UI__NO_STYLE;
+    for (uint32_t i = 0; i < header->styleCount && loaded; i++) {
+        UILayout layout;
+        UI__LayoutFromWords(styles + 16 * i, &layout);
+        styleMap[i] = UI__StyleTableIntern(ctx, &layout);
+        loaded = styleMap[i] != UI__NO_STYLE;
+        // Held until the elements use them, the ones no element uses are then freed
+        if (loaded)
+            ctx->_styles.styles[styleMap[i]].refs++;
+    }
+
+    if (loaded) {
+        rows[0] = ctx->root;
+        UI__SnapshotApply(rows[0], &elements[0], styleMap, text);
+        // The root keeps the size of the window
+        UI_FixedWidth(rows[0], (float)ctx->window.w);
+        UI_FixedHeight(rows[0], (float)ctx->window.h);
+    }
+    for (uint32_t i = 0; i < header->elementCount && loaded; i++) {
+        const UI__SnapshotElement *row = &elements[i];
+        UIElement *parent = rows[i];
+        loaded = UIElement_ReserveChildren(parent, row->childCount);
+        for (uint32_t j = 0; j < row->childCount && loaded; j++) {
+            UIElement *element = UI__Context_AllocElement(ctx);
+            loaded = element != NULL;
+            if (!loaded)
+                break;
+            element->parent = parent;
+            element->_index = j;
+            parent->children.data[parent->children.len++] = element;
+            rows[row->firstChild + j] = element;
+            UI__SnapshotApply(element, &elements[row->firstChild + j], styleMap, text);
+        }
+    }
+    for (uint32_t i = 0; styleMap != NULL && i < header->styleCount; i++) {
+        if (styleMap[i] != UI__NO_STYLE)
+            UI__StyleTableRelease(&ctx->_styles, styleMap[i]);
+    }
+    if (styleMap != NULL)
+        UI_MemFree(styleMap);
+    if (rows != NULL)
+        UI_MemFree(rows);
+
+    ctx->_structureDirty = true;
+    UIContext_ForceRedraw(ctx);
+    if (!loaded) {
+        while (ctx->root->children.len != 0)
+            UIElement_Destroy(ctx->root->children.data[ctx->root->children.len - 1]);
+        return false;
+    }
+
+    // The boxes are only valid for the same window, the rows of the tree are
+    // then the rows of the snapshot
+    if (!hasBoxes || header->windowW != ctx->window.w || header->windowH != ctx->window.h)
+        return true;
+    if (!UI__TreeReserve(&ctx->_backTree, header->elementCount) || !UI__ContextRebuildTree(ctx)) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    ctx->_structureDirty = false;
+    ctx->_clipsDirty = true;
+    ctx->_hitGrid.dirty = true;
+#ifdef UI_THREADS
+    ctx->_layoutPlan.dirty = true;
+#endif
+    UI__Tree *tree = &ctx->_tree;
+    for (uint32_t i = 0; i < tree->len; i++) {
+        tree->boxes[i] = boxes[i].box;
+        tree->lastBoxes[i] = boxes[i].box;
+        tree->childExtent[i] = boxes[i].childExtent;
+        tree->dirty[i] = false;
+    }
+    return true;
+}
+
+// Give `element` the state of `row`, the text points into the snapshot
+void UI__SnapshotApply(UIElement *element, const UI__SnapshotElement *row, const uint32_t *styleMap, const char *text) {
+    UIContext *ctx = element->context;
+    uint32_t style = styleMap[row->style];
+    ctx->_styles.styles[style].refs++;
+    UI__StyleTableRelease(&ctx->_styles, element->_style);
+    element->_style = style;
+    element->backgroundColor = row->backgroundColor;
+    element->scrollX = row->scrollX;
+    element->scrollY = row->scrollY;
+    element->contentW = row->contentW;
+    element->contentH = row->contentH;
+    element->clipChildren = (row->flags & UI__SNAPSHOT_CLIP) != 0;
+    element->text = (UIText) {
+        .str = row->textOffset == UI__NO_TEXT ? NULL : text + row->textOffset,
+        .len = row->textLen,
+        .font = row->font,
+        .color = row->textColor,
+        .wrap = (row->flags & UI__SNAPSHOT_WRAP) != 0,
+        .hash = 0
+    };
+    if (element->text.wrap)
+        element->text.hash = UI__HashBytes(element->text.str, element->text.len);
+    ctx->_hasWrappedText |= element->text.wrap;
+}
+
+// Check that `data` is a snapshot of this version whose rows form a tree in
+// breadth-first order, and that its styles and texts are inside it
+bool UI__SnapshotCheck(const void *data, uint32_t size) {
+    const UI__SnapshotHeader *header = (const UI__SnapshotHeader *)data;
+    if (data == NULL || ((uintptr_t)data & 3) != 0 || size < sizeof(UI__SnapshotHeader))
+        return false;
+    if (header->magic != UI__SNAPSHOT_MAGIC || header->version != UI_SNAPSHOT_VERSION)
+        return false;
+    if (header->elementCount == 0 || (header->flags & ~UI__SNAPSHOT_BOXES) != 0 || UI__SnapshotSize(header) != size)
+        return false;
+
+    const uint32_t *styles = (const uint32_t *)(header + 1);
+    for (uint32_t i = 0; i < header->styleCount; i++) {
+        if (!UI__SnapshotCheckStyle(styles + 16 * i))
+            return false;
+    }
+    const UI__SnapshotElement *elements = (const UI__SnapshotElement *)(styles + 16 * header->styleCount);
+    const char *text = (const char *)data + size - header->textSize;
+    uint32_t next = 1;
+    for (uint32_t i = 0; i < header->elementCount; i++) {
+        const UI__SnapshotElement *row = &elements[i];
+        // Every row but the root is a child of a row before it
+        if (i > 0 && next <= i)
+            return false;
+        if (row->firstChild != next || row->childCount > header->elementCount - next)
+            return false;
+        next += row->childCount;
+        if (row->style >= header->styleCount || (row->flags & ~(UI__SNAPSHOT_CLIP | UI__SNAPSHOT_WRAP)) != 0)
+            return false;
+        if (row->textOffset != UI__NO_TEXT) {
+            if (row->textOffset >= header->textSize || row->textLen >= header->textSize - row->textOffset)
+                return false;
+            if (text[row->textOffset + row->textLen] != '\0')
+                return false;
+        }
+    }
+    return next == header->elementCount;
+}
+
+// Check that the enums packed by `UI__LayoutWords` have one of their values
+bool UI__SnapshotCheckStyle(const uint32_t *words) {
+    uint32_t packed = words[15];
+    return (packed & 7) <= UILayoutDirection_rightToLeft
+        && (packed >> 3 & 7) <= UIAlignX_center
+        && (packed >> 6 & 7) <= UIAlignY_center
+        && (packed >> 9 & 0xff) <= UISizing_fit
+        && (packed >> 17 & 0xff) <= UISizing_fit
+        && packed >> 25 == 0;
+}
+
+UI__IdEntry *UI__IdTableFind(UI__IdTable *table, uint32_t key) {
+    if (table->cap == 0)
+        return NULL;
+    uint32_t mask = table->cap - 1;
+    for (uint32_t i = UI__HashU32(0, key) & mask;; i = (i + 1) & mask) {
+        UI__IdEntry *entry = &table->entries[i];
+        if (entry->key == key)
+            return entry;
+        if (entry->key == 0)
+            return NULL;
+    }
+}
+
+// Find the entry of `key` or add an empty one
+UI__IdEntry *UI__IdTableInsert(UIContext *ctx, uint32_t key) {
+    UI__IdTable *table = &ctx->_idTable;
+    UI__IdEntry *entry = UI__IdTableFind(table, key);
+    if (entry != NULL)
+        return entry;
+
+    // Keep the load factor at most 1/2
+    if ((table->len + 1) * 2 > table->cap) {
+        uint32_t cap = table->cap == 0 ? 256 : table->cap * 2;
+        if (!UI__IdTableResize(ctx, cap))
+            return NULL;
+    }
+
+    uint32_t mask = table->cap - 1;
+    uint32_t i = UI__HashU32(0, key) & mask;
+    while (table->entries[i].key != 0)
+        i = (i + 1) & mask;
+    entry = &table->entries[i];
+    *entry = (UI__IdEntry) { .key = key, .signature = 0, .frame = 0, .box = { 0, 0, 0, 0 }, .childExtent = 0 };
+    table->len++;
+    return entry;
+}
+
+// Move the entries to a new array of `cap` entries, dropping the ones that
+// were not used in the last frame
+bool UI__IdTableResize(UIContext *ctx, uint32_t cap) {
+    UI__IdTable *table = &ctx->_idTable;
+    UI__IdTable newTable = { .cap = cap, .len = 0 };
+    newTable.entries = (UI__IdEntry *)UI__MemAlloc(sizeof(UI__IdEntry) * cap);
+    if (newTable.entries == NULL) {
+        UI__ErrorSet(ctx, UIErrorKind_outOfMemory);
+        return false;
+    }
+    for (uint32_t i = 0; i < cap; i++)
+        newTable.entries[i].key = 0;
+
+    for (uint32_t i = 0; i < table->cap; i++) {
+        UI__IdEntry entry = table->entries[i];
+        if (entry.key == 0 || entry.frame + 1 < ctx->_frame)
+            continue;
+        uint32_t j = UI__HashU32(0, entry.key) & (cap - 1);
+        while (newTable.entries[j].key != 0)
+            j = (j + 1) & (cap - 1);
+        newTable.entries[j] = entry;
+        newTable.len++;
+    }
+    if (table->entries != NULL)
+        UI_MemFree(table->entries);
+    *table = newTable;
+    return true;
+}
+
+// Check if the subtree of `element` is the same as in the last frame and get
+// its last box, called when the tree is rebuilt
+bool UI__ElementReuseLayout(UIElement *element, UIRect *box, float *childExtent) {
+    UIContext *ctx = element->context;
+    if (element->_id == 0)
+        return false;
+    UI__IdEntry *entry = UI__IdTableInsert(ctx, element->_id);
+    if (entry == NULL) {
+        element->_id = 0;
+        return false;
+    }
+    // Duplicate ids cannot be told apart, they are always laid out again
+    if (entry->frame == ctx->_frame) {
+        element->_id = 0;
+        return false;
+    }
+    bool reuse = entry->frame + 1 == ctx->_frame && entry->signature == element->_signature;
+    entry->frame = ctx->_frame;
+    if (reuse) {
+        *box = entry->box;
+        *childExtent = entry->childExtent;
+    }
+    return reuse;
+}
+
+// Save the boxes of the elements with an id for the next frame
+void UI__ContextSaveIdBoxes(UIContext *ctx) {
+    UI__Tree *tree = &ctx->_tree;
+    for (uint32_t i = 0, n = tree->len; i < n; i++) {
+        UIElement *element = tree->elements[i];
+        if (element->_id == 0)
+            continue;
+        UI__IdEntry *entry = UI__IdTableFind(&ctx->_idTable, element->_id);
+        entry->box = tree->boxes[i];
+        entry->childExtent = tree->childExtent[i];
+        entry->signature = element->_signature;
+    }
+}
+
+void *UI__MemAlloc(uint32_t size) {
+#ifdef UI_STATS
+    UI__memCounters.allocs++;
+    UI__memCounters.bytes += size;
+#endif
+    return UI_MemAlloc(size);
+}
+
+void *UI__MemExpand(void *block, uint32_t size) {
+#ifdef UI_STATS
+    UI__memCounters.allocs++;
+    UI__memCounters.bytes += size;
+#endif
+    return UI_MemExpand(block, size);
+}
+
+void UI__MemCopy(void *dst, const void *src, uint32_t size) {
+    uint8_t *dstBytes = (uint8_t *)dst;
+    const uint8_t *srcBytes = (const uint8_t *)src;
+    for (uint32_t i = 0; i < size; i++)
+        dstBytes[i] = srcBytes[i];
+}
+
+#ifdef UI_STATS
+
+void UIContext_StatsReset(UIContext *ctx) {
+    UIStats *stats = &ctx->stats;
+    stats->frame = (UIFrameStats) { .allocs = 0 };
+    stats->_historyLen = 0;
+    stats->_historyNext = 0;
+    stats->_allocs = UI__memCounters.allocs;
+    stats->_allocBytes = UI__memCounters.bytes;
+}
+
+void UIContext_StatsAddDrawCalls(UIContext *ctx, uint32_t drawCalls) {
+    ctx->stats.frame.drawCalls += drawCalls;
+}
+
+UIStatsSummary UIContext_StatsSummary(UIContext *ctx, UIStatsTime time) {
+    UIStats *stats = &ctx->stats;
+    uint32_t len = stats->_historyLen;
+    UIStatsSummary summary = { 0, 0, 0, 0 };
+    if (len == 0)
+        return summary;
+
+    // Insertion sort, the history is short
+    uint64_t sorted[UI_STATS_HISTORY];
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        uint64_t value = stats->_history[i].timeNs[time];
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+        total += value;
+    }
+    summary.minNs = sorted[0];
+    summary.maxNs = sorted[len - 1];
+    summary.avgNs = total / len;
+    // The smallest value that is not below 99% of the frames
+    summary.p99Ns = sorted[(len * 99 + 99) / 100 - 1];
+    return summary;
+}
+
+// Add the time since `lap` to the current frame and start a new lap
+void UI__StatsLap(UIContext *ctx, UIStatsTime time, uint64_t *lap) {
+    uint64_t now = UI_TimeNs();
+    ctx->stats.frame.timeNs[time] += now - *lap;
+    *lap = now;
+}
+
+void UI__StatsEndFrame(UIContext *ctx) {
+    UIStats *stats = &ctx->stats;
+    UIFrameStats *frame = &stats->frame;
+    frame->allocs = (uint32_t)(UI__memCounters.allocs - stats->_allocs);
+    frame->allocBytes = UI__memCounters.bytes - stats->_allocBytes;
+    frame->liveElements = ctx->_elementAllocator.bucketCount + ctx->_frameElementCount;
+    stats->_allocs = UI__memCounters.allocs;
+    stats->_allocBytes = UI__memCounters.bytes;
+
+    stats->_history[stats->_historyNext] = *frame;
+    stats->_historyNext = (stats->_historyNext + 1) % UI_STATS_HISTORY;
+    if (stats->_historyLen < UI_STATS_HISTORY)
+        stats->_historyLen++;
+}
+
+#endif // !UI_STATS
+
+float UI_fmax2(float a, float b) {
+    return a > b ? a : b;
+}
+
+float UI_fmax3(float a, float b, float c) {
+    return a > b && a > c ? a : b > c ? b : c;
+}
+
+float UI_fmin2(float a, float b) {
+    return a < b ? a : b;
 }
 
 #endif // !UI_IMPLEMENTATION